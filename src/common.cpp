@@ -17,6 +17,7 @@ limitations under the License.
 */
 
 #include "common.hpp"
+#include <type_traits>
 
 // These are the names of the transformations done before encoding / after decoding
 const std::vector<std::string> transforms = {"Channel_Compact", "YCoCg", "?? YCbCr ??", "PermutePlanes", "Bounds",  // color space / ranges
@@ -26,14 +27,6 @@ const std::vector<std::string> transforms = {"Channel_Compact", "YCoCg", "?? YCb
                                              "?? Other ??" };
 // Plenty of room for future extensions: transform "Other" can be used to encode identifiers of arbitrary many other transforms
 
-// Some global variables used to show progress and to know when to stop a partial/progressive decode
-// (TODO: avoid global variables)
-int64_t pixels_todo = 0;
-int64_t pixels_done = 0;
-int progressive_qual_target = 0;
-int progressive_qual_shown = -1;
-
-
 // The order in which the planes are encoded.
 // Lookback (animations-only, value refers to a previous frame) has to be first, because all other planes are not encoded if lookback != 0
 // Alpha has to be next, because for fully transparent A=0 pixels, the other planes are not encoded
@@ -107,57 +100,57 @@ void initPropRanges(Ranges &propRanges, const ColorRanges &ranges, int p) {
     }
 }
 
+template <int p, typename view_t, typename view_tY>
+ColorVal predict_and_calcProps_view(Properties &properties, const ColorRanges *ranges, const Image &image, const view_t &plane, const view_tY &planeY, const int z, const uint32_t r, const uint32_t c, ColorVal &min, ColorVal &max, const int predictor) {
+    if (z%2==0) return predict_and_calcProps_plane<view_t,view_tY,true,false,p,ColorRanges>(properties,ranges,image,plane,planeY,z,r,c,min,max,predictor);
+    else return predict_and_calcProps_plane<view_t,view_tY,false,false,p,ColorRanges>(properties,ranges,image,plane,planeY,z,r,c,min,max,predictor);
+}
+
+template <typename plane_t, typename plane_tY, typename source_t, int p>
+ColorVal predict_and_calcProps_zoomed(Properties &properties, const ColorRanges *ranges, const Image &image, const int z, const uint32_t r, const uint32_t c, ColorVal &min, ColorVal &max, const int predictor) {
+    // zoomed views instead of prepare_zoomlevel(), because the encoder can learn several planes at the same time
+    const GeneralPlane *values = image.getPlane(p).own_values(), *valuesY = image.getPlane(0).own_values();
+    if (values && valuesY)
+        return predict_and_calcProps_view<p>(properties,ranges,image,static_cast<const plane_t&>(*values).zoomed(z),static_cast<const plane_tY&>(*valuesY).zoomed(z),z,r,c,min,max,predictor);
+    // planes of an imported image that nothing has written to still read the memory of the library user (see ViewPlane)
+    const SourceView<source_t> *view = static_cast<const SourceView<source_t>*>(values ? nullptr : &image.getPlane(p));
+    const SourceView<source_t> *viewY = static_cast<const SourceView<source_t>*>(valuesY ? nullptr : &image.getPlane(0));
+    if (!values && !valuesY)
+        return predict_and_calcProps_view<p>(properties,ranges,image,view->zoomed(z),viewY->zoomed(z),z,r,c,min,max,predictor);
+    if (!values)
+        return predict_and_calcProps_view<p>(properties,ranges,image,view->zoomed(z),static_cast<const plane_tY&>(*valuesY).zoomed(z),z,r,c,min,max,predictor);
+    return predict_and_calcProps_view<p>(properties,ranges,image,static_cast<const plane_t&>(*values).zoomed(z),viewY->zoomed(z),z,r,c,min,max,predictor);
+}
+
 // Actual prediction. Also sets properties. Property vector should already have the right size before calling this.
 // This is a fall-back function which should be replaced by direct calls to the specific predict_and_calcProps_plane function
 ColorVal predict_and_calcProps(Properties &properties, const ColorRanges *ranges, const Image &image, const int z, const int p, const uint32_t r, const uint32_t c, ColorVal &min, ColorVal &max, const int predictor) ATTRIBUTE_HOT;
 ColorVal predict_and_calcProps(Properties &properties, const ColorRanges *ranges, const Image &image, const int z, const int p, const uint32_t r, const uint32_t c, ColorVal &min, ColorVal &max, const int predictor) {
-    image.getPlane(0).prepare_zoomlevel(z);
-    image.getPlane(p).prepare_zoomlevel(z);
-
 #ifdef SUPPORT_HDR
     if (image.getDepth() > 8) {
      switch(p) {
-      case 0:
-        if (z%2==0) return predict_and_calcProps_plane<Plane<ColorVal_intern_16u>,Plane<ColorVal_intern_16u>,true,false,0,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-        else return predict_and_calcProps_plane<Plane<ColorVal_intern_16u>,Plane<ColorVal_intern_16u>,false,false,0,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-      case 1:
-        if (z%2==0) return predict_and_calcProps_plane<Plane<ColorVal_intern_32>,Plane<ColorVal_intern_16u>,true,false,1,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_32>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-        else return predict_and_calcProps_plane<Plane<ColorVal_intern_32>,Plane<ColorVal_intern_16u>,false,false,1,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_32>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-      case 2:
-        if (z%2==0) return predict_and_calcProps_plane<Plane<ColorVal_intern_32>,Plane<ColorVal_intern_16u>,true,false,2,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_32>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-        else return predict_and_calcProps_plane<Plane<ColorVal_intern_32>,Plane<ColorVal_intern_16u>,false,false,2,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_32>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-      case 3:
-        if (z%2==0) return predict_and_calcProps_plane<Plane<ColorVal_intern_16u>,Plane<ColorVal_intern_16u>,true,false,3,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-        else return predict_and_calcProps_plane<Plane<ColorVal_intern_16u>,Plane<ColorVal_intern_16u>,false,false,3,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(0)),z,r,c,min,max,predictor);
+      case 0: return predict_and_calcProps_zoomed<Plane<ColorVal_intern_16u>,Plane<ColorVal_intern_16u>,uint16_t,0>(properties,ranges,image,z,r,c,min,max,predictor);
+      case 1: return predict_and_calcProps_zoomed<Plane<ColorVal_intern_32>,Plane<ColorVal_intern_16u>,uint16_t,1>(properties,ranges,image,z,r,c,min,max,predictor);
+      case 2: return predict_and_calcProps_zoomed<Plane<ColorVal_intern_32>,Plane<ColorVal_intern_16u>,uint16_t,2>(properties,ranges,image,z,r,c,min,max,predictor);
+      case 3: return predict_and_calcProps_zoomed<Plane<ColorVal_intern_16u>,Plane<ColorVal_intern_16u>,uint16_t,3>(properties,ranges,image,z,r,c,min,max,predictor);
       default:
         assert(p==4);
-        if (z%2==0) return predict_and_calcProps_plane<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_16u>,true,false,4,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-        else return predict_and_calcProps_plane<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_16u>,false,false,4,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_16u>&>(image.getPlane(0)),z,r,c,min,max,predictor);
+        return predict_and_calcProps_zoomed<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_16u>,uint16_t,4>(properties,ranges,image,z,r,c,min,max,predictor);
      }
     } else
 #endif
      switch(p) {
-      case 0:
-        if (z%2==0) return predict_and_calcProps_plane<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_8>,true,false,0,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-        else return predict_and_calcProps_plane<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_8>,false,false,0,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(0)),z,r,c,min,max,predictor);
+      case 0: return predict_and_calcProps_zoomed<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_8>,uint8_t,0>(properties,ranges,image,z,r,c,min,max,predictor);
       case 1:
-        if (image.getPlane(0).is_constant()) {
-          if (z%2==0) return predict_and_calcProps_plane<Plane<ColorVal_intern_8>,ConstantPlane,true,false,1,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(p)),static_cast<const ConstantPlane&>(image.getPlane(0)),z,r,c,min,max,predictor);
-          else return predict_and_calcProps_plane<Plane<ColorVal_intern_8>,ConstantPlane,false,false,1,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(p)),static_cast<const ConstantPlane&>(image.getPlane(0)),z,r,c,min,max,predictor);
-        } else {
-          if (z%2==0) return predict_and_calcProps_plane<Plane<ColorVal_intern_16>,Plane<ColorVal_intern_8>,true,false,1,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_16>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-          else return predict_and_calcProps_plane<Plane<ColorVal_intern_16>,Plane<ColorVal_intern_8>,false,false,1,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_16>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-        }
-      case 2:
-        if (z%2==0) return predict_and_calcProps_plane<Plane<ColorVal_intern_16>,Plane<ColorVal_intern_8>,true,false,2,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_16>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-        else return predict_and_calcProps_plane<Plane<ColorVal_intern_16>,Plane<ColorVal_intern_8>,false,false,2,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_16>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-      case 3:
-        if (z%2==0) return predict_and_calcProps_plane<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_8>,true,false,3,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-        else return predict_and_calcProps_plane<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_8>,false,false,3,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(0)),z,r,c,min,max,predictor);
+        if (image.getPlane(0).is_constant())
+          return predict_and_calcProps_zoomed<Plane<ColorVal_intern_8>,ConstantPlane,uint8_t,1>(properties,ranges,image,z,r,c,min,max,predictor);
+        else
+          return predict_and_calcProps_zoomed<Plane<ColorVal_intern_16>,Plane<ColorVal_intern_8>,uint8_t,1>(properties,ranges,image,z,r,c,min,max,predictor);
+      case 2: return predict_and_calcProps_zoomed<Plane<ColorVal_intern_16>,Plane<ColorVal_intern_8>,uint8_t,2>(properties,ranges,image,z,r,c,min,max,predictor);
+      case 3: return predict_and_calcProps_zoomed<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_8>,uint8_t,3>(properties,ranges,image,z,r,c,min,max,predictor);
       default:
         assert(p==4);
-        if (z%2==0) return predict_and_calcProps_plane<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_8>,true,false,4,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(0)),z,r,c,min,max,predictor);
-        else return predict_and_calcProps_plane<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_8>,false,false,4,ColorRanges>(properties,ranges,image,static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(p)),static_cast<const Plane<ColorVal_intern_8>&>(image.getPlane(0)),z,r,c,min,max,predictor);
+        return predict_and_calcProps_zoomed<Plane<ColorVal_intern_8>,Plane<ColorVal_intern_8>,uint8_t,4>(properties,ranges,image,z,r,c,min,max,predictor);
      }
 }
 
@@ -33,10 +33,38 @@ limitations under the License.
 #include "io.hpp"
 
 
-extern int64_t pixels_todo;
-extern int64_t pixels_done;
-extern int progressive_qual_target;
-extern int progressive_qual_shown;
+// The optional "zIdx" chunk of an interlaced image: for every plane/zoomlevel step, the number of bytes of image data
+// (counted from the end of the header) a decoder needs to decode everything up to and including that step.
+struct ZoomlevelOffset {
+    int plane;
+    int zoomlevel;
+    uint64_t end;
+};
+
+struct ZoomlevelIndex {
+    long data_start;        // where the range coder starts in the encoded file (-1: no index was made)
+    std::vector<ZoomlevelOffset> steps;
+    ZoomlevelIndex() : data_start(-1) {}
+    // a step is only complete once the next one has started (its header bits are read before a decoder stops)
+    void step_started(const uint64_t bytes, const int p, const int z) {
+        if (!steps.empty()) steps.back().end = bytes;
+        steps.push_back({p, z, 0});
+    }
+    void finish(const uint64_t bytes) {
+        if (!steps.empty()) steps.back().end = bytes;
+    }
+};
+
+// Progress of one encode or decode call: used to show progress and to know when to stop a partial/progressive decode.
+// Every flif_encode / flif_decode call has its own, so several images can be coded concurrently.
+struct flif_progress {
+    int64_t pixels_todo;
+    int64_t pixels_done;
+    int progressive_qual_target;
+    int progressive_qual_shown;
+    ZoomlevelIndex *zoomlevel_index;    // encoder: where the steps of the interlaced pixel data end, if requested
+    flif_progress() : pixels_todo(0), pixels_done(0), progressive_qual_target(0), progressive_qual_shown(-1), zoomlevel_index(nullptr) {}
+};
 
 
 #define MAX_TRANSFORM 13
@@ -86,8 +114,9 @@ template<typename I> I inline median3(I a, I b, I c) {
     }
 }
 
+// Properties that are not in the used bitmask (see FinalTree::used_properties) are not computed.
 template <typename plane_t, bool nobordercases>
-ColorVal predict_and_calcProps_scanlines_plane(Properties &properties, const ColorRanges *ranges, const Image &image, const plane_t &plane, const int p, const uint32_t r, const uint32_t c, ColorVal &min, ColorVal &max, const ColorVal fallback) {
+ColorVal predict_and_calcProps_scanlines_plane(Properties &properties, const ColorRanges *ranges, const Image &image, const plane_t &plane, const int p, const uint32_t r, const uint32_t c, ColorVal &min, ColorVal &max, const ColorVal fallback, const uint32_t used = ~0u) {
     ColorVal guess;
     int which = 0;
     int index=0;
@@ -117,12 +146,20 @@ ColorVal predict_and_calcProps_scanlines_plane(Properties &properties, const Col
     if (nobordercases || (c > 0 && r > 0)) { properties[index++] = left - topleft; properties[index++] = topleft - top; }
     else   { properties[index++] = 0; properties[index++] = 0;  }
 
-    if (nobordercases || (c+1 < image.cols() && r > 0)) properties[index++] = top - plane.get(r-1,c+1); // top - topright
-    else   properties[index++] = 0;
-    if (nobordercases || r > 1) properties[index++] = plane.get(r-2,c)-top;    // toptop - top
-    else properties[index++] = 0;
-    if (nobordercases || c > 1) properties[index++] = plane.get(r,c-2)-left;    // leftleft - left
-    else properties[index++] = 0;
+    if (used & (1u << index)) {
+        if (nobordercases || (c+1 < image.cols() && r > 0)) properties[index] = top - plane.get(r-1,c+1); // top - topright
+        else   properties[index] = 0;
+    }
+    index++;
+    if (used & (1u << index)) {
+        if (nobordercases || r > 1) properties[index] = plane.get(r-2,c)-top;    // toptop - top
+        else properties[index] = 0;
+    }
+    index++;
+    if (used & (1u << index)) {
+        if (nobordercases || c > 1) properties[index] = plane.get(r,c-2)-left;    // leftleft - left
+        else properties[index] = 0;
+    }
     return guess;
 }
 
@@ -212,10 +249,11 @@ inline ColorVal predict(const Image &image, int z, int p, uint32_t r, uint32_t c
 
 
 // Actual prediction. Also sets properties. Property vector should already have the right size before calling this.
+// Properties that are not in the used bitmask (see FinalTree::used_properties) are not computed.
 template <typename plane_t, typename plane_tY, bool horizontal, bool nobordercases, int p, typename ranges_t>
-ColorVal predict_and_calcProps_plane(Properties &properties, const ranges_t *ranges, const Image &image, const plane_t &plane, const plane_tY &planeY, const int z, const uint32_t r, const uint32_t c, ColorVal &min, ColorVal &max, const int predictor) ATTRIBUTE_HOT;
+ColorVal predict_and_calcProps_plane(Properties &properties, const ranges_t *ranges, const Image &image, const plane_t &plane, const plane_tY &planeY, const int z, const uint32_t r, const uint32_t c, ColorVal &min, ColorVal &max, const int predictor, const uint32_t used = ~0u) ATTRIBUTE_HOT;
 template <typename plane_t, typename plane_tY, bool horizontal, bool nobordercases, int p, typename ranges_t>
-ColorVal predict_and_calcProps_plane(Properties &properties, const ranges_t *ranges, const Image &image, const plane_t &plane, const plane_tY &planeY, const int z, const uint32_t r, const uint32_t c, ColorVal &min, ColorVal &max, const int predictor) {
+ColorVal predict_and_calcProps_plane(Properties &properties, const ranges_t *ranges, const Image &image, const plane_t &plane, const plane_tY &planeY, const int z, const uint32_t r, const uint32_t c, ColorVal &min, ColorVal &max, const int predictor, const uint32_t used) {
     ColorVal guess;
     //int which = 0;
     int index = 0;
@@ -238,7 +276,6 @@ ColorVal predict_and_calcProps_plane(Properties &properties, const ranges_t *ran
         top = PIXEL(z,r-1,c);
         left = (nobordercases || c>0 ? PIXEL(z,r,c-1) : top);
         topleft = (nobordercases || c>0 ? PIXEL(z,r-1,c-1) : top);
-        topright = (nobordercases || (rightPresent) ? PIXEL(z,r-1,c+1) : top);
         bottomleft = (nobordercases || (bottomPresent && c>0) ? PIXEL(z,r+1,c-1) : left);
         const ColorVal bottom = (nobordercases || bottomPresent ? PIXEL(z,r+1,c) : left);
         const ColorVal avg = (top + bottom)>>1;
@@ -249,7 +286,9 @@ ColorVal predict_and_calcProps_plane(Properties &properties, const ranges_t *ran
         else if (median == topleftgradient) which = 1;
         properties[index++]=which;
         if (p == 1 || p == 2) {
-          properties[index++] = PIXELY(z,r,c) - ((PIXELY(z,r-1,c)+PIXELY(z,(nobordercases || bottomPresent ? r+1 : r-1),c))>>1);
+          if (used & (1u << index))
+            properties[index] = PIXELY(z,r,c) - ((PIXELY(z,r-1,c)+PIXELY(z,(nobordercases || bottomPresent ? r+1 : r-1),c))>>1);
+          index++;
         }
         if (predictor == 0) guess = avg;
         else if (predictor == 1)
@@ -258,16 +297,22 @@ ColorVal predict_and_calcProps_plane(Properties &properties, const ranges_t *ran
             guess = median3(top,bottom,left);
         ranges->snap(p,properties,min,max,guess);
         properties[index++] = top-bottom;
-        properties[index++]=top-((topleft+topright)>>1);
+        if (used & (1u << index)) {
+            topright = (nobordercases || (rightPresent) ? PIXEL(z,r-1,c+1) : top);
+            properties[index]=top-((topleft+topright)>>1);
+        }
+        index++;
         properties[index++]=left-((bottomleft+topleft)>>1);
-        const ColorVal bottomright = (nobordercases || (rightPresent && bottomPresent) ? PIXEL(z,r+1,c+1) : bottom);
-        properties[index++]=bottom-((bottomleft+bottomright)>>1);
+        if (used & (1u << index)) {
+            const ColorVal bottomright = (nobordercases || (rightPresent && bottomPresent) ? PIXEL(z,r+1,c+1) : bottom);
+            properties[index]=bottom-((bottomleft+bottomright)>>1);
+        }
+        index++;
     } else { // filling vertical lines
         left = PIXEL(z,r,c-1);
         top = (nobordercases || r>0 ? PIXEL(z,r-1,c) : left);
         topleft = (nobordercases || r>0 ? PIXEL(z,r-1,c-1) : left);
         topright = (nobordercases || (r>0 && rightPresent) ? PIXEL(z,r-1,c+1) : top);
-        bottomleft = (nobordercases || (bottomPresent) ? PIXEL(z,r+1,c-1) : left);
         const ColorVal right = (nobordercases || rightPresent ? PIXEL(z,r,c+1) : top);
         const ColorVal avg = (left + right)>>1;
         const ColorVal topleftgradient = left+top-topleft;
@@ -277,7 +322,9 @@ ColorVal predict_and_calcProps_plane(Properties &properties, const ranges_t *ran
         else if (median == topleftgradient) which = 1;
         properties[index++]=which;
         if (p == 1 || p == 2) {
-          properties[index++] = PIXELY(z,r,c) - ((PIXELY(z,r,c-1)+PIXELY(z,r,(nobordercases || rightPresent ? c+1 : c-1)))>>1);
+          if (used & (1u << index))
+            properties[index] = PIXELY(z,r,c) - ((PIXELY(z,r,c-1)+PIXELY(z,r,(nobordercases || rightPresent ? c+1 : c-1)))>>1);
+          index++;
         }
         if (predictor == 0) guess = avg;
         else if (predictor == 1)
@@ -286,10 +333,17 @@ ColorVal predict_and_calcProps_plane(Properties &properties, const ranges_t *ran
             guess = median3(top,left,right);
         ranges->snap(p,properties,min,max,guess);
         properties[index++] = left-right;
-        properties[index++]=left-((bottomleft+topleft)>>1);
+        if (used & (1u << index)) {
+            bottomleft = (nobordercases || (bottomPresent) ? PIXEL(z,r+1,c-1) : left);
+            properties[index]=left-((bottomleft+topleft)>>1);
+        }
+        index++;
         properties[index++]=top-((topleft+topright)>>1);
-        const ColorVal bottomright = (nobordercases || (rightPresent && bottomPresent) ? PIXEL(z,r+1,c+1) : right);
-        properties[index++]=right-((bottomright+topright)>>1);
+        if (used & (1u << index)) {
+            const ColorVal bottomright = (nobordercases || (rightPresent && bottomPresent) ? PIXEL(z,r+1,c+1) : right);
+            properties[index]=right-((bottomright+topright)>>1);
+        }
+        index++;
     }
     properties[index++]=guess;
 //    if (p < 1 || p > 2) properties[index++]=which;
@@ -303,10 +357,15 @@ ColorVal predict_and_calcProps_plane(Properties &properties, const ranges_t *ran
 //        else properties[index++]=0;
 //    }
     if (p != 2) {
-        if (nobordercases || r > 1) properties[index++]=PIXEL(z,r-2,c)-top;    // toptop - top
-        else properties[index++]=0;
-        if (nobordercases || c > 1) properties[index++]=PIXEL(z,r,c-2)-left;    // leftleft - left
-        else properties[index++]=0;
+        if (used & (1u << index)) {
+            if (nobordercases || r > 1) properties[index]=PIXEL(z,r-2,c)-top;    // toptop - top
+            else properties[index]=0;
+        }
+        index++;
+        if (used & (1u << index)) {
+            if (nobordercases || c > 1) properties[index]=PIXEL(z,r,c-2)-left;    // leftleft - left
+            else properties[index]=0;
+        }
     }
     return guess;
 }
@@ -2,6 +2,8 @@
 
 #ifdef _MSC_VER
 #define ATTRIBUTE_HOT
+#define ATTRIBUTE_COLD
 #else
 #define ATTRIBUTE_HOT __attribute__ ((hot))
-#endif
\ No newline at end of file
+#define ATTRIBUTE_COLD __attribute__ ((cold, noinline))
+#endif
@@ -36,6 +36,9 @@
 /* COMPILATION OPTIONS  */
 /************************/
 
+// number of bytes the range decoder reads from its input at once
+#define RAC_INPUT_BUFFER_SIZE 16384
+
 // speed / binary size trade-off: 0, 1, 2  (higher number -> bigger and faster binary)
 #define LARGE_BINARY 1
 
@@ -43,6 +46,13 @@
 #define USE_SIMD 1
 #endif
 
+// verbosity of encodes and decodes that don't set flif_options::verbosity, and of the command line tool without -v
+#ifdef DEBUG
+#define DEFAULT_VERBOSITY 10
+#else
+#define DEFAULT_VERBOSITY 1
+#endif
+
 /**************************/
 /* FIX COMPILER WARNINGS  */
 /**************************/
@@ -71,6 +81,9 @@
 #define CONTEXT_TREE_COUNT_DIV 30
 #define CONTEXT_TREE_MIN_SUBTREE_SIZE 50
 
+// sampled learning (-l N) learns from every Nth band of this many rows of a zoomlevel
+#define LEARN_SAMPLE_BAND 8
+
 
 
 /**************************************************/
@@ -90,6 +103,12 @@
 #define CONTEXT_TREE_MIN_COUNT 1
 #define CONTEXT_TREE_MAX_COUNT 512
 
+// number of binary decisions per block, for files that use the rANS entropy coder
+#define RANS_BLOCK_SIZE (1 << 18)
+
+// number of pixels per band of rows when the last inverse transforms are done band by band for a row output
+#define ROW_OUTPUT_BAND_VALUES 16384
+
 
 
 // DEFAULT ENCODE/DECODE OPTIONS ARE DEFINED BELOW
@@ -113,6 +132,10 @@ union flifEncodingOptional {
   flifEncodingOptional() : o(Optional::undefined) {}
 };
 
+class ManiacForest;
+class PlanePool;
+class RowOutput;
+
 struct flif_options {
 #ifdef HAS_ENCODER
     int learn_repeats;
@@ -132,6 +155,13 @@ struct flif_options {
     int adaptive;
     int predictor[5];
     int chroma_subsampling;
+    int rans;
+    int learn_sample;
+    int tile_size;
+    int plane_streams;
+    int zoomlevel_index;
+    ManiacForest *forest;
+    int train_forest;
 #endif
     flifEncodingOptional method;
     int invisible_predictor;
@@ -150,6 +180,10 @@ struct flif_options {
     int show_breakpoints;
     int no_full_decode;
     int keep_palette;
+    int threads;
+    int verbosity;
+    PlanePool *plane_pool;
+    RowOutput *row_output;
 };
 
 const struct flif_options FLIF_DEFAULT_OPTIONS = {
@@ -171,6 +205,13 @@ const struct flif_options FLIF_DEFAULT_OPTIONS = {
     0, // adaptive
     {-2,-2,-2,-2,-2}, // predictor, heuristically pick a fixed predictor on all planes
     0, // chroma_subsampling
+    0, // rans
+    1, // learn_sample, learn from all rows
+    0, // tile_size, 0 = the whole image is coded as one stream
+    0, // plane_streams, 0 = all planes in one range coder stream
+    0, // zoomlevel_index, 1 = write a "zIdx" chunk with the byte offset of every plane/zoomlevel step
+    nullptr, // forest, learn new MANIAC trees
+    0, // train_forest, 1 = learn the trees of forest from the images instead of encoding them
 #endif
     flifEncodingOptional(), // method
     2, // invisible_predictor
@@ -189,4 +230,8 @@ const struct flif_options FLIF_DEFAULT_OPTIONS = {
     0, // show_breakpoints
     0, // no_full_decode
     0, // keep_palette
+    1, // threads, for learning the MANIAC trees and for the tiles of tiled images
+    DEFAULT_VERBOSITY, // verbosity, messages of v_printf up to this level are printed
+    nullptr, // plane_pool, allocate new image buffers with the allocator of set_plane_allocator
+    nullptr, // row_output, gets the rows of the first frame as soon as they are final
 };
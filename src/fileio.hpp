@@ -20,6 +20,11 @@ limitations under the License.
 
 #include <stdio.h>
 #include <string.h>
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
 
 class FileIO
 {
@@ -52,6 +57,9 @@ public:
     int get_c() {
       return fgetc(file);
     }
+    size_t read_block(uint8_t *buf, size_t n) {
+      return fread(buf, 1, n, file);
+    }
     char * gets(char *buf, int n) {
       return fgets(buf, n, file);
     }
@@ -61,6 +69,9 @@ public:
     int fputc(int c) {
       return ::fputc(c, file);
     }
+    size_t write_block(const uint8_t *buf, size_t n) {
+      return fwrite(buf, 1, n, file);
+    }
     void fseek(long offset, int where) {
       ::fseek(file, offset,where);
     }
@@ -99,6 +110,15 @@ public:
             return EOS;
         return data[seek_pos++];
     }
+    size_t read_block(uint8_t *buf, size_t n) {
+        if(seek_pos >= data_array_size)
+            return 0;
+        if(n > data_array_size - seek_pos)
+            n = data_array_size - seek_pos;
+        memcpy(buf, data + seek_pos, n);
+        seek_pos += n;
+        return n;
+    }
     char * gets(char *buf, int n) {
         int i = 0;
         const int max_write = n-1;
@@ -133,6 +153,189 @@ public:
     }
 };
 
+/*!
+ * IO interface that continues reading where a range decoder's stream ends: first the bytes the decoder already read
+ * from io but didn't use (see RacInput::read_ahead), then io itself. Seeking io back to the end of the stream instead
+ * would not work when io is a pipe.
+ */
+template <typename IO>
+class ResumeReader
+{
+private:
+    IO& io;
+    std::vector<uint8_t> ahead;
+    size_t pos;
+public:
+    const int EOS = -1;
+
+    ResumeReader(IO& ioin, const uint8_t *data, size_t size) : io(ioin), ahead(data, data + size), pos(0) { }
+
+    bool isEOF() {
+        return pos >= ahead.size() && io.isEOF();
+    }
+    long ftell() {
+        long p = io.ftell();
+        if (p < 0) return p;
+        return p - long(ahead.size() - pos);
+    }
+    int get_c() {
+        if (pos < ahead.size()) return ahead[pos++];
+        int c = io.get_c();
+        return (c < 0 ? EOS : c);
+    }
+    size_t read_block(uint8_t *buf, size_t n) {
+        if (pos < ahead.size()) {
+            if (n > ahead.size() - pos) n = ahead.size() - pos;
+            memcpy(buf, ahead.data() + pos, n);
+            pos += n;
+            return n;
+        }
+        return io.read_block(buf, n);
+    }
+    const char* getName() const {
+        return io.getName();
+    }
+};
+
+/*!
+ * IO interface for data that arrives in pieces (e.g. from the network) while it is being read on another thread:
+ * a read waits until the bytes have been added or the end of the input is known, so the reader is suspended right
+ * where it runs out of input and simply continues when more arrives. The bytes the reader is past are dropped when
+ * more is added, so the reader can only seek forward.
+ */
+class StreamReader
+{
+private:
+    std::vector<uint8_t> data;
+    size_t discarded;       // the number of bytes dropped from the front of data
+    size_t seek_pos;        // counted from the start of the input
+    bool input_ended;       // no more data will be added
+    bool reader_waiting;    // the reader has used up the data and waits for more
+    bool reader_done;
+    std::mutex mutex;
+    std::condition_variable data_added;
+    std::condition_variable reader_idle;
+
+    size_t end() const {
+        return discarded + data.size();
+    }
+    // waits (with the lock held) until n bytes after seek_pos are there or the input has ended; returns how many are there
+    size_t wait_for(std::unique_lock<std::mutex> &lock, size_t n) {
+        while (!input_ended && end() < seek_pos + n) {
+            reader_waiting = true;
+            reader_idle.notify_all();
+            data_added.wait(lock);
+        }
+        reader_waiting = false;
+        return (seek_pos < end() ? end() - seek_pos : 0);
+    }
+public:
+    const int EOS = -1;
+
+    StreamReader()
+    : discarded(0)
+    , seek_pos(0)
+    , input_ended(false)
+    , reader_waiting(false)
+    , reader_done(false)
+    {
+    }
+
+    // called by the writer
+    void add(const uint8_t* buf, size_t n) {
+        std::lock_guard<std::mutex> lock(mutex);
+        // (usually the reader has used up everything before, so this hardly moves anything)
+        const size_t used = std::min(seek_pos - discarded, data.size());
+        data.erase(data.begin(), data.begin() + used);
+        discarded += used;
+        data.insert(data.end(), buf, buf + n);
+        reader_waiting = false;
+        data_added.notify_all();
+    }
+    void end_input() {
+        std::lock_guard<std::mutex> lock(mutex);
+        input_ended = true;
+        reader_waiting = false;
+        data_added.notify_all();
+    }
+    // waits until the reader needs more data than has been added (true) or is done reading (false)
+    bool wait_until_idle() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!reader_waiting && !reader_done) reader_idle.wait(lock);
+        return !reader_done;
+    }
+
+    // called by the reader when it is done
+    void done_reading() {
+        std::lock_guard<std::mutex> lock(mutex);
+        reader_done = true;
+        reader_idle.notify_all();
+    }
+
+    bool isEOF() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return wait_for(lock, 1) == 0;
+    }
+    long ftell() const {
+        return seek_pos;
+    }
+    int get_c() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wait_for(lock, 1) == 0)
+            return EOS;
+        return data[seek_pos++ - discarded];
+    }
+    // returns as soon as there is something to read (which can be less than n bytes)
+    size_t read_block(uint8_t *buf, size_t n) {
+        std::unique_lock<std::mutex> lock(mutex);
+        size_t available = wait_for(lock, 1);
+        if (available == 0)
+            return 0;
+        if (n > available)
+            n = available;
+        memcpy(buf, data.data() + (seek_pos - discarded), n);
+        seek_pos += n;
+        return n;
+    }
+    char * gets(char *buf, int n) {
+        std::unique_lock<std::mutex> lock(mutex);
+        int i = 0;
+        const int max_write = n-1;
+        wait_for(lock, max_write);
+        while(seek_pos < end() && i < max_write)
+            buf[i++] = data[seek_pos++ - discarded];
+        buf[n-1] = '\0';
+
+        if(i < max_write)
+            return 0;
+        else
+            return buf;
+    }
+    int fputc(int FLIF_UNUSED(c)) {
+      return EOS;
+    }
+    // (the bytes before the current position may be gone)
+    void fseek(long offset, int where) {
+        std::unique_lock<std::mutex> lock(mutex);
+        switch(where) {
+        case SEEK_SET:
+            seek_pos = offset;
+            break;
+        case SEEK_CUR:
+            seek_pos += offset;
+            break;
+        case SEEK_END:
+            wait_for(lock, (size_t)-1 - seek_pos);
+            seek_pos = long(end()) + offset;
+            break;
+        }
+        assert(seek_pos >= discarded);
+    }
+    static const char* getName() {
+        return "StreamReader";
+    }
+};
+
 /*!
  * IO interface for a growable memory block
  */
@@ -210,6 +413,15 @@ public:
             return EOS;
         return data[seek_pos++];
     }
+    size_t read_block(uint8_t *buf, size_t n) {
+        if(seek_pos >= bytes_used)
+            return 0;
+        if(n > bytes_used - seek_pos)
+            n = bytes_used - seek_pos;
+        memcpy(buf, data + seek_pos, n);
+        seek_pos += n;
+        return n;
+    }
     char * gets(char *buf, int n) {
         int i = 0;
         const int max_write = n-1;
@@ -230,7 +442,7 @@ public:
             grow(seek_pos + 1);
             data[seek_pos++] = s[i++];
             if(bytes_used < seek_pos)
-                bytes_used = seek_pos+1;
+                bytes_used = seek_pos;
         }
         return 0;
     }
@@ -239,9 +451,17 @@ public:
 
         data[seek_pos++] = static_cast<uint8_t>(c);
         if(bytes_used < seek_pos)
-            bytes_used = seek_pos+1;
+            bytes_used = seek_pos;
         return c;
     }
+    size_t write_block(const uint8_t *buf, size_t n) {
+        grow(seek_pos + n);
+        memcpy(data + seek_pos, buf, n);
+        seek_pos += n;
+        if(bytes_used < seek_pos)
+            bytes_used = seek_pos;
+        return n;
+    }
     void fseek(long offset, int where) {
         switch(where) {
         case SEEK_SET:
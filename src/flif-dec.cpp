@@ -19,8 +19,13 @@ limitations under the License.
 #include <string>
 #include <string.h>
 #include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 #include "maniac/rac.hpp"
+#include "maniac/rans.hpp"
 #include "maniac/compound.hpp"
 #include "maniac/util.hpp"
 
@@ -50,6 +55,7 @@ template<typename Coder, typename plane_t, typename alpha_t>
 void flif_decode_scanline_plane(plane_t &plane, Coder &coder, Images &images, const ColorRanges *ranges, alpha_t &alpha, Properties &properties, 
                                 const int p, const int fr, const uint32_t r, const ColorVal grey, const ColorVal minP, const bool alphazero, const bool FRA) {
     ColorVal min,max;
+    const uint32_t used = coder.used_properties();
     Image& image = images[fr];
     uint32_t begin=0, end=image.cols();
 #ifdef SUPPORT_ANIMATION
@@ -78,19 +84,19 @@ void flif_decode_scanline_plane(plane_t &plane, Coder &coder, Images &images, co
       uint32_t c = begin;
       for (; c < 2; c++) {
         if (alphazero && p<3 && alpha.get(r,c) == 0) {plane.set(r,c,predictScanlines_plane(plane,r,c, grey)); continue;}
-        ColorVal guess = predict_and_calcProps_scanlines_plane<plane_t,false>(properties,ranges,image,plane,p,r,c,min,max, minP);
+        ColorVal guess = predict_and_calcProps_scanlines_plane<plane_t,false>(properties,ranges,image,plane,p,r,c,min,max, minP, used);
         ColorVal curr = coder.read_int(properties, min - guess, max - guess) + guess;
         plane.set(r,c, curr);
       }
       for (; c < end-1; c++) {
         if (alphazero && p<3 && alpha.get(r,c) == 0) {plane.set(r,c,predictScanlines_plane(plane,r,c, grey)); continue;}
-        ColorVal guess = predict_and_calcProps_scanlines_plane<plane_t,true>(properties,ranges,image,plane,p,r,c,min,max, minP);
+        ColorVal guess = predict_and_calcProps_scanlines_plane<plane_t,true>(properties,ranges,image,plane,p,r,c,min,max, minP, used);
         ColorVal curr = coder.read_int(properties, min - guess, max - guess) + guess;
         plane.set(r,c, curr);
       }
       for (; c < end; c++) {
         if (alphazero && p<3 && alpha.get(r,c) == 0) {plane.set(r,c,predictScanlines_plane(plane,r,c, grey)); continue;}
-        ColorVal guess = predict_and_calcProps_scanlines_plane<plane_t,false>(properties,ranges,image,plane,p,r,c,min,max, minP);
+        ColorVal guess = predict_and_calcProps_scanlines_plane<plane_t,false>(properties,ranges,image,plane,p,r,c,min,max, minP, used);
         ColorVal curr = coder.read_int(properties, min - guess, max - guess) + guess;
         plane.set(r,c, curr);
       }
@@ -104,7 +110,7 @@ void flif_decode_scanline_plane(plane_t &plane, Coder &coder, Images &images, co
         if (FRA && p<4 && image.getFRA(r,c) > 0) {assert(fr >= image.getFRA(r,c)); plane.set(r,c,images[fr-image.getFRA(r,c)](p,r,c)); continue;}
 #endif
         //calculate properties and use them to decode the next pixel
-        ColorVal guess = predict_and_calcProps_scanlines_plane<plane_t,false>(properties,ranges,image,plane,p,r,c,min,max, minP);
+        ColorVal guess = predict_and_calcProps_scanlines_plane<plane_t,false>(properties,ranges,image,plane,p,r,c,min,max, minP, used);
 #ifdef SUPPORT_ANIMATION
         if (FRA && p==4 && max > fr) max = fr;
 #endif
@@ -144,11 +150,36 @@ struct scanline_plane_decoder: public PlaneVisitor {
 //    void visit(ConstantPlane              &plane) override {flif_decode_scanline_plane(plane,coder,images,ranges,alpha,properties,p,fr,r,grey,minP,alphazero,FRA);}
 };
 
+// decodes row r of plane p in every frame
+template<typename Coder>
+void flif_decode_scanline_row(Coder &coder, Images &images, const ColorRanges *ranges, Properties &properties, const int p, const uint32_t r,
+                              const ColorVal grey, const ColorVal minP, const bool alphazero, const bool FRA) {
+    const int nump = images[0].numPlanes();
+    for (int fr=0; fr< (int)images.size(); fr++) {
+        Image &image = images[fr];
+        GeneralPlane &plane = image.getPlane(p);
+        ConstantPlane null_alpha(1);
+        GeneralPlane &alpha = nump > 3 ? image.getPlane(3) : null_alpha;
+        if (alpha.is_constant()) {
+            scanline_plane_decoder<Coder,ConstantPlane> decoder(coder,images,ranges,properties,alpha,p,fr,r,grey,minP,alphazero,FRA);
+            plane.accept_visitor(decoder);
+        } else if (image.getDepth() <= 8) {
+            scanline_plane_decoder<Coder,Plane<ColorVal_intern_8>> decoder(coder,images,ranges,properties,alpha,p,fr,r,grey,minP,alphazero,FRA);
+            plane.accept_visitor(decoder);
+#ifdef SUPPORT_HDR
+        } else {
+            scanline_plane_decoder<Coder,Plane<ColorVal_intern_16u>> decoder(coder,images,ranges,properties,alpha,p,fr,r,grey,minP,alphazero,FRA);
+            plane.accept_visitor(decoder);
+#endif
+        }
+    }
+}
+
 uint32_t issue_callback(callback_t callback, void *user_data, uint32_t quality, int64_t bytes_read, bool decode_over, std::function<void ()> func) {
   return callback(quality, bytes_read, decode_over ? 1 : 0, user_data, (void *) &func);
 }
 
-void downsample(const int width, const int height, int target_w, int target_h, Images &images) {
+void downsample(const int width, const int height, int target_w, int target_h, Images &images, PlanePool *pool) {
   // don't upscale
   if (target_w > width) target_w = width;
   if (target_h > height) target_h = height;
@@ -159,32 +190,34 @@ void downsample(const int width, const int height, int target_w, int target_h, I
   if (target_w != (int)images[0].cols() || target_h != (int)images[0].rows()) {
     v_printf(3,"Downscaling to %ix%i\n",target_w,target_h);
     for (unsigned int n=0; n < images.size(); n++) {
-      images[n] = Image(images[n],target_w,target_h);
+      images[n] = Image(images[n],target_w,target_h,pool);
     }
   }
 }
 
 
 
+// initialize planes to grey (for partial decoding)
+void init_planes_grey(Images &images, const ColorRanges *ranges) {
+    for (int p=0; p<images[0].numPlanes(); p++) {
+      if (ranges->min(p) < ranges->max(p))
+      for (int fr=0; fr< (int)images.size(); fr++) {
+        for (uint32_t r=0; r<images[fr].rows(); r++) {
+          for (uint32_t c=0; c<images[fr].cols(); c++) {
+            images[fr].set(p,r,c,(ranges->min(p)+ranges->max(p))/2);
+          }
+        }
+      }
+    }
+}
+
 template<typename IO, typename Rac, typename Coder>
-bool flif_decode_scanlines_inner(IO &io, FLIF_UNUSED(Rac &rac), std::vector<Coder> &coders, Images &images, const ColorRanges *ranges, flif_options &options,
-                                 std::vector<Transform<IO>*> &transforms, callback_t callback, void *user_data, Images &partial_images) {
+bool flif_decode_scanlines_inner(FLIF_UNUSED(IO &io), Rac &rac, std::vector<Coder> &coders, Images &images, const ColorRanges *ranges, flif_options &options,
+                                 std::vector<Transform<IO>*> &transforms, callback_t callback, void *user_data, Images &partial_images, flif_progress &progress) {
     const int nump = images[0].numPlanes();
     const bool alphazero = images[0].alpha_zero_special;
     const bool FRA = (nump == 5);
-    if (callback || options.quality<100) {
-         // initialize planes to grey
-         for (int p=0; p<nump; p++) {
-           if (ranges->min(p) < ranges->max(p))
-           for (int fr=0; fr< (int)images.size(); fr++) {
-            for (uint32_t r=0; r<images[fr].rows(); r++) {
-              for (uint32_t c=0; c<images[fr].cols(); c++) {
-                images[fr].set(p,r,c,(ranges->min(p)+ranges->max(p))/2);
-              }
-            }
-           }
-         }
-    }
+    if (callback || options.quality<100) init_planes_grey(images, ranges);
 
     const std::vector<ColorVal> greys = computeGreys(ranges);
 
@@ -193,48 +226,31 @@ bool flif_decode_scanlines_inner(IO &io, FLIF_UNUSED(Rac &rac), std::vector<Code
         if (p>=nump) continue;
         i++;
         Properties properties((nump>3?NB_PROPERTIES_scanlinesA[p]:NB_PROPERTIES_scanlines[p]));
-        if ((100*pixels_done > options.quality*pixels_todo)) {
-          v_printf(5,"%lu subpixels done, %lu subpixels todo, quality target %i%% reached (%i%%)\n",(long unsigned)pixels_done,(long unsigned)pixels_todo,(int)options.quality,(int)(100*pixels_done/pixels_todo));
+        if ((100*progress.pixels_done > options.quality*progress.pixels_todo)) {
+          v_printf(5,"%lu subpixels done, %lu subpixels todo, quality target %i%% reached (%i%%)\n",(long unsigned)progress.pixels_done,(long unsigned)progress.pixels_todo,(int)options.quality,(int)(100*progress.pixels_done/progress.pixels_todo));
           return false;
         }
         if (ranges->min(p) < ranges->max(p)) {
           const ColorVal minP = ranges->min(p);
-          v_printf_tty(2,"\r%i%% done [%i/%i] DEC[%ux%u]    ",(int)(100*pixels_done/pixels_todo),i,nump,images[0].cols(),images[0].rows());
+          v_printf_tty(2,"\r%i%% done [%i/%i] DEC[%ux%u]    ",(int)(100*progress.pixels_done/progress.pixels_todo),i,nump,images[0].cols(),images[0].rows());
           v_printf_tty(4,"\n");
-          pixels_done += images[0].cols()*images[0].rows();
+          progress.pixels_done += images[0].cols()*images[0].rows();
           for (uint32_t r = 0; r < images[0].rows(); r++) {
             if (images[0].cols() == 0) return false; // decode aborted
-            for (int fr=0; fr< (int)images.size(); fr++) {
-                Image &image = images[fr];
-                GeneralPlane &plane = image.getPlane(p);
-                ConstantPlane null_alpha(1);
-                GeneralPlane &alpha = nump > 3 ? image.getPlane(3) : null_alpha;
-                if (alpha.is_constant()) {
-                    scanline_plane_decoder<Coder,ConstantPlane> decoder(coders[p],images,ranges,properties,alpha,p,fr,r,greys[p],minP,alphazero,FRA);
-                    plane.accept_visitor(decoder);
-                } else if (image.getDepth() <= 8) {
-                    scanline_plane_decoder<Coder,Plane<ColorVal_intern_8>> decoder(coders[p],images,ranges,properties,alpha,p,fr,r,greys[p],minP,alphazero,FRA);
-                    plane.accept_visitor(decoder);
-#ifdef SUPPORT_HDR
-                } else {
-                    scanline_plane_decoder<Coder,Plane<ColorVal_intern_16u>> decoder(coders[p],images,ranges,properties,alpha,p,fr,r,greys[p],minP,alphazero,FRA);
-                    plane.accept_visitor(decoder);
-#endif
-                }
-            }
+            flif_decode_scanline_row(coders[p], images, ranges, properties, p, r, greys[p], minP, alphazero, FRA);
           }
-          int qual = 10000*pixels_done/pixels_todo;
-          if (callback && p != 4 && qual >= progressive_qual_target) {
+          int qual = 10000*progress.pixels_done/progress.pixels_todo;
+          if (callback && p != 4 && qual >= progress.progressive_qual_target) {
             auto populatePartialImages = [&] () {
-              for (unsigned int n=0; n < images.size(); n++) partial_images[n] = images[n].clone(); // make a copy to work with
+              for (unsigned int n=0; n < images.size(); n++) partial_images[n] = images[n].clone(options.plane_pool); // make a copy to work with
               for (int i=transforms.size()-1; i>=0; i--) if (transforms[i]->undo_redo_during_decode()) transforms[i]->invData(partial_images);
               if (options.fit) {
-                downsample(partial_images[0].cols(), partial_images[0].rows(), options.resize_width, options.resize_height, partial_images);
+                downsample(partial_images[0].cols(), partial_images[0].rows(), options.resize_width, options.resize_height, partial_images, options.plane_pool);
               }
             };
-            progressive_qual_shown = qual;
-            progressive_qual_target = issue_callback(callback, user_data, qual, io.ftell(), qual == 10000, populatePartialImages);
-            if (qual >= progressive_qual_target) return false;
+            progress.progressive_qual_shown = qual;
+            progress.progressive_qual_target = issue_callback(callback, user_data, qual, rac.ftell(), qual == 10000, populatePartialImages);
+            if (qual >= progress.progressive_qual_target) return false;
           }
         }
     }
@@ -243,7 +259,7 @@ bool flif_decode_scanlines_inner(IO &io, FLIF_UNUSED(Rac &rac), std::vector<Code
 
 template<typename IO, typename Rac, typename Coder>
 bool flif_decode_scanlines_pass(IO& io, Rac &rac, Images &images, const ColorRanges *ranges, std::vector<Tree> &forest, flif_options &options,
-                                std::vector<Transform<IO>*> &transforms, callback_t callback, void *user_data, Images &partial_images) {
+                                std::vector<Transform<IO>*> &transforms, callback_t callback, void *user_data, Images &partial_images, flif_progress &progress) {
     std::vector<Coder> coders;
     coders.reserve(images[0].numPlanes());
     for (int p = 0; p < images[0].numPlanes(); p++) {
@@ -251,9 +267,154 @@ bool flif_decode_scanlines_pass(IO& io, Rac &rac, Images &images, const ColorRan
         initPropRanges_scanlines(propRanges, *ranges, p);
         coders.emplace_back(rac, propRanges, forest[p], 0, options.cutoff, options.alpha);
     }
-    return flif_decode_scanlines_inner<IO,Rac,Coder>(io, rac, coders, images, ranges, options, transforms, callback, user_data, partial_images);
+    return flif_decode_scanlines_inner<IO,Rac,Coder>(io, rac, coders, images, ranges, options, transforms, callback, user_data, partial_images, progress);
 }
 
+template <typename IO>
+size_t read_big_endian_varint(IO& io) {
+    size_t result = 0;
+    int bytes_read = 0;
+    while (bytes_read++ < 10) {
+      int number = io.get_c();
+      if (number < 0) break;
+      if (number < 128) return result+number;
+      number -= 128;
+      result += number;
+      result <<= 7;
+    }
+    e_printf("Invalid number encountered!\n");
+    return 0;
+}
+
+// reads a stream of the given length (or what is left of it in a truncated file) into buffer
+template <typename IO>
+void read_stream(IO& io, const size_t length, std::vector<uint8_t> &buffer) {
+    // in blocks, so a corrupt length doesn't make us allocate more than there is in the file
+    buffer.clear();
+    while (buffer.size() < length) {
+        const size_t old_size = buffer.size();
+        const size_t block = std::min<size_t>(length - old_size, 1 << 20);
+        buffer.resize(old_size + block);
+        size_t n = 0, m;
+        while (n < block && (m = io.read_block(buffer.data() + old_size + n, block - n)) > 0) n += m;
+        buffer.resize(old_size + n);
+        if (n < block) break;
+    }
+}
+
+// Decodes a non-interlaced image with separate plane streams (see flif_encode_scanlines_plane_streams) on up to
+// options.threads threads. A row of a plane only depends on the same row of the planes before it in PLANE_ORDERING
+// (through the properties, the alpha plane and the lookback plane), so that is all a plane has to wait for.
+// Progressive decoding only gets a callback at the end.
+template<typename IO, typename PlaneRac, typename Coder, typename Input>
+bool flif_decode_scanlines_plane_streams(Input& in, Images &images, const ColorRanges *ranges, std::vector<Tree> &forest, flif_options &options,
+                                         std::vector<Transform<IO>*> &transforms, callback_t callback, void *user_data, Images &partial_images, flif_progress &progress) {
+    const int nump = images[0].numPlanes();
+    const uint32_t rows = images[0].rows();
+    const bool alphazero = images[0].alpha_zero_special;
+    const bool FRA = (nump == 5);
+    const std::vector<ColorVal> greys = computeGreys(ranges);
+    if (callback || options.quality<100) init_planes_grey(images, ranges);
+
+    std::vector<size_t> lengths(nump);
+    for (int p = 0; p < nump; p++) lengths[p] = read_big_endian_varint(in);
+    std::vector<std::vector<uint8_t>> streams(nump);
+    for (int p = 0; p < nump; p++) read_stream(in, lengths[p], streams[p]);
+
+    // the planes to decode, in PLANE_ORDERING and up to the quality target
+    std::vector<int> order;
+    bool complete = true;
+    for (int k=0; k < 5; k++) {
+        int p=PLANE_ORDERING[k];
+        if (p>=nump) continue;
+        if ((100*progress.pixels_done > options.quality*progress.pixels_todo)) {
+          v_printf(5,"%lu subpixels done, %lu subpixels todo, quality target %i%% reached (%i%%)\n",(long unsigned)progress.pixels_done,(long unsigned)progress.pixels_todo,(int)options.quality,(int)(100*progress.pixels_done/progress.pixels_todo));
+          complete = false;
+          break;
+        }
+        if (ranges->min(p) >= ranges->max(p)) continue;
+        order.push_back(p);
+        progress.pixels_done += images[0].cols()*rows;
+    }
+    v_printf_tty(2,"\rDEC[%ux%u, %i plane streams]    ",images[0].cols(),rows,(int)order.size());
+
+    std::unique_ptr<std::atomic<uint32_t>[]> rows_done(new std::atomic<uint32_t>[nump]);
+    for (int p = 0; p < nump; p++) rows_done[p] = 0;
+    std::mutex mutex;
+    std::condition_variable row_done;
+    std::atomic<bool> aborted(false);
+    std::atomic<size_t> next_plane(0);
+    auto worker = [&]() {
+        VerbosityScope verbose(options.verbosity);
+        size_t j;
+        while ((j = next_plane++) < order.size()) {
+            const int p = order[j];
+            BlobReader reader(streams[p].data(), streams[p].size());
+            PlaneRac rac(reader);
+            Ranges propRanges;
+            initPropRanges_scanlines(propRanges, *ranges, p);
+            Coder coder(rac, propRanges, forest[p], 0, options.cutoff, options.alpha);
+            Properties properties((nump>3?NB_PROPERTIES_scanlinesA[p]:NB_PROPERTIES_scanlines[p]));
+            for (uint32_t r = 0; r < rows; r++) {
+                // the planes before this one are taken by other threads (or done), so this can't wait forever
+                for (size_t i = 0; i < j; i++) {
+                    if (rows_done[order[i]] > r) continue;
+                    std::unique_lock<std::mutex> lock(mutex);
+                    row_done.wait(lock, [&] { return rows_done[order[i]] > r || aborted; });
+                }
+                if (images[0].cols() == 0) { // decode aborted
+                    std::lock_guard<std::mutex> lock(mutex);
+                    aborted = true;
+                }
+                if (aborted) break;
+                flif_decode_scanline_row(coder, images, ranges, properties, p, r, greys[p], ranges->min(p), alphazero, FRA);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    rows_done[p] = r + 1;
+                }
+                row_done.notify_all();
+            }
+            if (aborted) row_done.notify_all();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < std::min((size_t)options.threads, order.size()); t++) pool.emplace_back(worker);
+    worker();
+    for (std::thread &t : pool) t.join();
+    if (aborted) return false;
+
+    int qual = 10000*progress.pixels_done/progress.pixels_todo;
+    if (callback && qual >= progress.progressive_qual_target) {
+      auto populatePartialImages = [&] () {
+        for (unsigned int n=0; n < images.size(); n++) partial_images[n] = images[n].clone(options.plane_pool); // make a copy to work with
+        for (int i=transforms.size()-1; i>=0; i--) if (transforms[i]->undo_redo_during_decode()) transforms[i]->invData(partial_images);
+        if (options.fit) {
+          downsample(partial_images[0].cols(), partial_images[0].rows(), options.resize_width, options.resize_height, partial_images, options.plane_pool);
+        }
+      };
+      progress.progressive_qual_shown = qual;
+      progress.progressive_qual_target = issue_callback(callback, user_data, qual, in.ftell(), qual == 10000, populatePartialImages);
+      if (qual >= progress.progressive_qual_target) return false;
+    }
+    return complete;
+}
+
+// the input after the main stream, where the plane streams start: first what its decoder has read ahead, then the
+// rest of its input (see ResumeReader)
+template <typename IO, typename Config>
+ResumeReader<IO> plane_streams_input(RacInput<Config, IO> &rac) {
+    return ResumeReader<IO>(rac.source(), rac.read_ahead(), rac.read_ahead_size());
+}
+template <typename IO>
+ResumeReader<IO> plane_streams_input(RansInput<IO> &rans) {
+    return ResumeReader<IO>(rans.source(), rans.read_ahead(), rans.read_ahead_size());
+}
+
+// the plane streams are coded like the main stream
+template <typename Rac> struct PlaneStreamInput;
+template <typename IO> struct PlaneStreamInput<RacIn<IO>> { typedef RacIn<BlobReader> type; };
+template <typename IO> struct PlaneStreamInput<RansInput<IO>> { typedef RansInput<BlobReader> type; };
+
 template<typename IO>
 const ColorRanges * undo_palette(Images &images, const int scale, std::vector<Transform<IO>*> &transforms, std::vector<int> &zoomlevels, const ColorRanges *ranges) {
     if (images[0].palette && scale == 1) {
@@ -270,6 +431,42 @@ const ColorRanges * undo_palette(Images &images, const int scale, std::vector<Tr
     return ranges;
 }
 
+// interpolate the pixels of zoomlevel z that are not in zoomlevel z+1, like predict_plane_horizontal/vertical with predictor 0
+// (on the concrete plane type, so the full-resolution interpolation of a progressive preview doesn't make virtual calls per pixel)
+template <typename plane_t>
+void interpolate_plane_zoomlevel(plane_t &plane, const int z, const uint32_t rows, const uint32_t cols) {
+    plane.prepare_zoomlevel(z);
+    if (z % 2 == 0) {
+      // horizontal: scan the odd rows
+      for (uint32_t r = 1; r < rows; r += 2) {
+        if (r+1 < rows) {
+          for (uint32_t c = 0; c < cols; c++) plane.set_fast(r,c, (plane.get_fast(r-1,c) + plane.get_fast(r+1,c))>>1);
+        } else {
+          for (uint32_t c = 0; c < cols; c++) plane.set_fast(r,c, plane.get_fast(r-1,c));
+        }
+      }
+    } else {
+      // vertical: scan the odd columns
+      for (uint32_t r = 0; r < rows; r++) {
+        uint32_t c = 1;
+        for (; c+1 < cols; c += 2) plane.set_fast(r,c, (plane.get_fast(r,c-1) + plane.get_fast(r,c+1))>>1);
+        if (c < cols) plane.set_fast(r,c, plane.get_fast(r,c-1));
+      }
+    }
+}
+
+// (a ConstantPlane is left alone: interpolating it can't change it)
+struct zoomlevel_interpolator : public PlaneVisitor {
+    const int z; const uint32_t rows, cols;
+    zoomlevel_interpolator(const int zl, const uint32_t r, const uint32_t c) : z(zl), rows(r), cols(c) {}
+    void visit(Plane<ColorVal_intern_8>   &plane) override { interpolate_plane_zoomlevel(plane, z, rows, cols); }
+    void visit(Plane<ColorVal_intern_16>  &plane) override { interpolate_plane_zoomlevel(plane, z, rows, cols); }
+#ifdef SUPPORT_HDR
+    void visit(Plane<ColorVal_intern_16u> &plane) override { interpolate_plane_zoomlevel(plane, z, rows, cols); }
+    void visit(Plane<ColorVal_intern_32>  &plane) override { interpolate_plane_zoomlevel(plane, z, rows, cols); }
+#endif
+};
+
 // interpolate rest of the image
 // used when decoding lossy
 template<typename IO>
@@ -329,30 +526,9 @@ void flif_decode_FLIF2_inner_interpol(Images &images, const ColorRanges *ranges,
       v_printf_tty(2,"\rINTERPOLATE[%i,%ux%u]                 ",p,images[0].cols(z),images[0].rows(z));
       v_printf_tty(5,"\n");
 
-      if (z % 2 == 0) {
-        // horizontal: scan the odd rows
-        for (Image& image : images) {
-          GeneralPlane& plane = image.getPlane(p);
-          uint32_t rows = image.rows(z);
-          uint32_t cols = image.cols(z);
-          for (uint32_t r = 1; r < rows; r += 2) {
-             for (uint32_t c = 0; c < cols; c++) {
-               plane.set(z,r,c, predict_plane_horizontal(plane,z,p,r,c,rows,0));
-             }
-          }
-        }
-      } else {
-        // vertical: scan the odd columns
-        for (Image& image : images) {
-          GeneralPlane& plane = image.getPlane(p);
-          uint32_t rows = image.rows(z);
-          uint32_t cols = image.cols(z);
-          for (uint32_t r = 0; r < rows; r++) {
-            for (uint32_t c = 1; c < cols; c += 2) {
-              plane.set(z,r,c, predict_plane_vertical(plane,z,p,r,c,cols,0));
-            }
-          }
-        }
+      for (Image& image : images) {
+        zoomlevel_interpolator interpolator(z, image.rows(z), image.cols(z));
+        image.getPlane(p).accept_visitor(interpolator);
       }
     }
     v_printf_tty(2,"\n");
@@ -365,6 +541,7 @@ template<typename Coder, typename plane_t, typename alpha_t, int p, typename ran
 void flif_decode_plane_zoomlevel_horizontal(plane_t &plane, Coder &coder, Images &images, const ranges_t *ranges, const alpha_t &alpha, const alpha_t &planeY, Properties &properties,
     const int z, const int fr, const uint32_t r,  const bool alphazero, const bool FRA, const int predictor, const int invisible_predictor) {
     ColorVal min,max;
+    const uint32_t used = coder.used_properties();
     Image& image = images[fr];
     uint32_t begin=0, end=image.cols(z);
 #ifdef SUPPORT_ANIMATION
@@ -396,19 +573,19 @@ void flif_decode_plane_zoomlevel_horizontal(plane_t &plane, Coder &coder, Images
     if (r > 1 && r < image.rows(z)-1 && !FRA && begin == 0 && end > 3) {
       for (uint32_t c = begin; c < 2; c++) {
         if (alphazero && p<3 && alpha.get_fast(r,c) == 0) { plane.set_fast(r,c,predict_plane_horizontal(plane,z,p,r,c, image.rows(z), invisible_predictor)); continue;}
-        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,true,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor);
+        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,true,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor, used);
         ColorVal curr = coder.read_int(properties, min - guess, max - guess) + guess;
         plane.set_fast(r,c, curr);
       }
       for (uint32_t c = 2; c < end-2; c++) {
         if (alphazero && p<3 && alpha.get_fast(r,c) == 0) { plane.set_fast(r,c,predict_plane_horizontal(plane,z,p,r,c, image.rows(z), invisible_predictor)); continue;}
-        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,true,true,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor);
+        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,true,true,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor, used);
         ColorVal curr = coder.read_int(properties, min - guess, max - guess) + guess;
         plane.set_fast(r,c, curr);
       }
       for (uint32_t c = end-2; c < end; c++) {
         if (alphazero && p<3 && alpha.get_fast(r,c) == 0) { plane.set_fast(r,c,predict_plane_horizontal(plane,z,p,r,c, image.rows(z), invisible_predictor)); continue;}
-        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,true,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor);
+        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,true,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor, used);
         ColorVal curr = coder.read_int(properties, min - guess, max - guess) + guess;
         plane.set_fast(r,c, curr);
       }
@@ -420,7 +597,7 @@ void flif_decode_plane_zoomlevel_horizontal(plane_t &plane, Coder &coder, Images
 #ifdef SUPPORT_ANIMATION
         if (FRA && p<4 && image.getFRA(z,r,c) > 0) { plane.set_fast(r,c,images[fr-image.getFRA(z,r,c)](p,z,r,c)); continue;}
 #endif
-        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,true,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor);
+        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,true,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor, used);
 #ifdef SUPPORT_ANIMATION
         if (FRA && p==4 && max > fr) max = fr;
         if (FRA && (guess>max || guess<min)) guess = min;
@@ -444,6 +621,7 @@ template<typename Coder, typename plane_t, typename alpha_t, int p, typename ran
 void flif_decode_plane_zoomlevel_vertical(plane_t &plane, Coder &coder, Images &images, const ranges_t *ranges, const alpha_t &alpha, const alpha_t &planeY, Properties &properties,
     const int z, const int fr, const uint32_t r,  const bool alphazero, const bool FRA, const int predictor, const int invisible_predictor) {
     ColorVal min,max;
+    const uint32_t used = coder.used_properties();
     Image& image = images[fr];
     uint32_t begin=1, end=image.cols(z);
 #ifdef SUPPORT_ANIMATION
@@ -478,19 +656,19 @@ void flif_decode_plane_zoomlevel_vertical(plane_t &plane, Coder &coder, Images &
       uint32_t c = begin;
       for (; c < 3; c+=2) {
         if (alphazero && p<3 && alpha.get_fast(r,c) == 0) { plane.set_fast(r,c,predict_plane_vertical(plane, z, p, r, c, image.cols(z), invisible_predictor)); continue;}
-        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,false,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor);
+        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,false,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor, used);
         ColorVal curr = coder.read_int(properties, min - guess, max - guess) + guess;
         plane.set_fast(r,c, curr);
       }
       for (; c < end-2; c+=2) {
         if (alphazero && p<3 && alpha.get_fast(r,c) == 0) { plane.set_fast(r,c,predict_plane_vertical(plane, z, p, r, c, image.cols(z), invisible_predictor)); continue;}
-        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,false,true,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor);
+        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,false,true,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor, used);
         ColorVal curr = coder.read_int(properties, min - guess, max - guess) + guess;
         plane.set_fast(r,c, curr);
       }
       for (; c < end; c+=2) {
         if (alphazero && p<3 && alpha.get_fast(r,c) == 0) { plane.set_fast(r,c,predict_plane_vertical(plane, z, p, r, c, image.cols(z), invisible_predictor)); continue;}
-        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,false,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor);
+        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,false,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor, used);
         ColorVal curr = coder.read_int(properties, min - guess, max - guess) + guess;
         plane.set_fast(r,c, curr);
       }
@@ -502,7 +680,7 @@ void flif_decode_plane_zoomlevel_vertical(plane_t &plane, Coder &coder, Images &
 #ifdef SUPPORT_ANIMATION
         if (FRA && p<4 && image.getFRA(z,r,c) > 0) { plane.set_fast(r,c,images[fr-image.getFRA(z,r,c)](p,z,r,c)); continue;}
 #endif
-        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,false,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor);
+        ColorVal guess = predict_and_calcProps_plane<plane_t,alpha_t,false,false,p,ranges_t>(properties,ranges,image,plane,planeY,z,r,c,min,max, predictor, used);
 #ifdef SUPPORT_ANIMATION
         if (FRA && p==4 && max > fr) max = fr;
         if (FRA && (guess>max || guess<min)) guess = min;
@@ -609,8 +787,8 @@ struct vertical_plane_decoder: public PlaneVisitor {
 };
 
 template<typename IO, typename Rac, typename Coder, typename alpha_t, typename ranges_t>
-bool flif_decode_FLIF2_inner_horizontal(const int p, IO& io, FLIF_UNUSED(Rac &rac), std::vector<Coder> &coders, Images &images, const ranges_t *ranges,
-                             const int beginZL, const int endZL, FLIF_UNUSED(int quality), int scale, const int i, const int z, const int predictor, std::vector<int>& zoomlevels, std::vector<Transform<IO>*> &transforms, const int invisible_predictor) {
+bool flif_decode_FLIF2_inner_horizontal(const int p, FLIF_UNUSED(IO& io), Rac &rac, std::vector<Coder> &coders, Images &images, const ranges_t *ranges,
+                             const int beginZL, const int endZL, FLIF_UNUSED(int quality), int scale, const int i, const int z, const int predictor, std::vector<int>& zoomlevels, std::vector<Transform<IO>*> &transforms, const int invisible_predictor, flif_progress &progress) {
     const int nump = images[0].numPlanes();
     const bool alphazero = images[0].alpha_zero_special;
     const bool FRA = (nump == 5);
@@ -618,10 +796,10 @@ bool flif_decode_FLIF2_inner_horizontal(const int p, IO& io, FLIF_UNUSED(Rac &ra
     horizontal_plane_decoder<Coder,alpha_t,ranges_t> rowdecoder(coders[p],images,ranges,properties,z,alphazero,FRA, predictor, invisible_predictor,p);
           for (uint32_t r = 1; r < images[0].rows(z); r += 2) {
             if (images[0].cols() == 0) return false; // decode aborted
-            pixels_done += images[0].cols(z);
-            if (endZL == 0 && (r & 257)==257) v_printf_tty(3,"\r%i%% done [%i/%i] DEC[%i,%ux%u]  ",(int)(100*pixels_done/pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
+            progress.pixels_done += images[0].cols(z);
+            if (endZL == 0 && (r & 257)==257) v_printf_tty(3,"\r%i%% done [%i/%i] DEC[%i,%ux%u]  ",(int)(100*progress.pixels_done/progress.pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
 #ifdef CHECK_FOR_BROKENFILES
-            if (io.isEOF()) {
+            if (rac.isEOF()) {
               v_printf(1,"Row %i: Unexpected file end. Interpolation from now on.\n",r);
               flif_decode_FLIF2_inner_interpol(images, ranges, p, endZL, (r>1?r-2:r), scale, zoomlevels, transforms);
               return false;
@@ -640,8 +818,8 @@ bool flif_decode_FLIF2_inner_horizontal(const int p, IO& io, FLIF_UNUSED(Rac &ra
           return true;
 }
 template<typename IO, typename Rac, typename Coder, typename alpha_t, typename ranges_t>
-bool flif_decode_FLIF2_inner_vertical(const int p, IO& io, FLIF_UNUSED(Rac &rac), std::vector<Coder> &coders, Images &images, const ranges_t *ranges,
-                             const int beginZL, const int endZL, FLIF_UNUSED(int quality), int scale, const int i, const int z, const int predictor, std::vector<int>& zoomlevels, std::vector<Transform<IO>*> &transforms, const int invisible_predictor) {
+bool flif_decode_FLIF2_inner_vertical(const int p, FLIF_UNUSED(IO& io), Rac &rac, std::vector<Coder> &coders, Images &images, const ranges_t *ranges,
+                             const int beginZL, const int endZL, FLIF_UNUSED(int quality), int scale, const int i, const int z, const int predictor, std::vector<int>& zoomlevels, std::vector<Transform<IO>*> &transforms, const int invisible_predictor, flif_progress &progress) {
     const int nump = images[0].numPlanes();
     const bool alphazero = images[0].alpha_zero_special;
     const bool FRA = (nump == 5);
@@ -649,10 +827,10 @@ bool flif_decode_FLIF2_inner_vertical(const int p, IO& io, FLIF_UNUSED(Rac &rac)
     vertical_plane_decoder<Coder,alpha_t,ranges_t> rowdecoder(coders[p],images,ranges,properties,z,alphazero,FRA, predictor, invisible_predictor,p);
           for (uint32_t r = 0; r < images[0].rows(z); r++) {
             if (images[0].cols() == 0) return false; // decode aborted
-            pixels_done += images[0].cols(z)/2;
-            if (endZL == 0 && (r&513)==513) v_printf_tty(3,"\r%i%% done [%i/%i] DEC[%i,%ux%u]  ",(int)(100*pixels_done/pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
+            progress.pixels_done += images[0].cols(z)/2;
+            if (endZL == 0 && (r&513)==513) v_printf_tty(3,"\r%i%% done [%i/%i] DEC[%i,%ux%u]  ",(int)(100*progress.pixels_done/progress.pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
 #ifdef CHECK_FOR_BROKENFILES
-            if (io.isEOF()) {
+            if (rac.isEOF()) {
               v_printf(1,"Row %i: Unexpected file end. Interpolation from now on.\n", r);
               flif_decode_FLIF2_inner_interpol(images, ranges, p, endZL, (r>0?r-1:r), scale, zoomlevels, transforms);
               return false;
@@ -675,7 +853,7 @@ bool flif_decode_FLIF2_inner_vertical(const int p, IO& io, FLIF_UNUSED(Rac &rac)
 template<typename IO, typename Rac, typename Coder, typename ranges_t>
 bool flif_decode_FLIF2_inner(IO& io, Rac &rac, std::vector<Coder> &coders, Images &images, const ranges_t *ranges,
                              const int beginZL, const int endZL, flif_options &options, std::vector<Transform<IO>*> &transforms,
-                             callback_t callback, void *user_data, Images &partial_images) {
+                             callback_t callback, void *user_data, Images &partial_images, flif_progress &progress) {
     const int nump = images[0].numPlanes();
     int quality=options.quality, scale=options.scale;
 //    const bool alphazero = images[0].alpha_zero_special;
@@ -683,6 +861,9 @@ bool flif_decode_FLIF2_inner(IO& io, Rac &rac, std::vector<Coder> &coders, Image
     // flif_decode
     UniformSymbolCoder<Rac> metaCoder(rac);
     std::vector<int> zoomlevels(nump, beginZL);
+    // the buffers of the previous progressive preview, for the next one (the library's pool, if it has one)
+    PlanePool own_preview_pool;
+    PlanePool &preview_pool = options.plane_pool ? *options.plane_pool : own_preview_pool;
     const bool default_order = metaCoder.read_int(0, 1);
     int the_predictor[5] = {0,0,0,0,0};
     int breakpoints = options.show_breakpoints;
@@ -708,8 +889,8 @@ bool flif_decode_FLIF2_inner(IO& io, Rac &rac, std::vector<Coder> &coders, Image
       }
       int z = zoomlevels[p];
       if (z < 0) {e_printf("Corrupt file: invalid plane/zoomlevel\n"); return false;}
-      if (100*pixels_done > quality*pixels_todo && endZL==0) {
-              v_printf(5,"%lu subpixels done, %lu subpixels todo, quality target %i%% reached (%i%%)\n",(long unsigned)pixels_done,(long unsigned)pixels_todo,(int)quality,(int)(100*pixels_done/pixels_todo));
+      if (100*progress.pixels_done > quality*progress.pixels_todo && endZL==0) {
+              v_printf(5,"%lu subpixels done, %lu subpixels todo, quality target %i%% reached (%i%%)\n",(long unsigned)progress.pixels_done,(long unsigned)progress.pixels_todo,(int)quality,(int)(100*progress.pixels_done/progress.pixels_todo));
               flif_decode_FLIF2_inner_interpol(images, ranges, p, endZL, -1, scale, zoomlevels, transforms);
               return false;
       }
@@ -718,17 +899,17 @@ bool flif_decode_FLIF2_inner(IO& io, Rac &rac, std::vector<Coder> &coders, Image
         if (the_predictor[p]<0) predictor = metaCoder.read_int(0, MAX_PREDICTOR);
         else predictor = the_predictor[p];
         if (1<<(z/2) < breakpoints) {
-            v_printf(1,"1:%i scale: %li bytes\n",breakpoints,io.ftell());
+            v_printf(1,"1:%i scale: %li bytes\n",breakpoints,rac.ftell());
             breakpoints /= 2;
             options.show_breakpoints = breakpoints;
             if (options.no_full_decode && breakpoints < 2) return false;
         }
         if (1<<(z/2) < scale) {
-              v_printf(5,"%lu subpixels done (out of %lu subpixels at this scale), scale target 1:%i reached\n",(long unsigned)pixels_done,(long unsigned)pixels_todo,scale);
+              v_printf(5,"%lu subpixels done (out of %lu subpixels at this scale), scale target 1:%i reached\n",(long unsigned)progress.pixels_done,(long unsigned)progress.pixels_todo,scale);
               flif_decode_FLIF2_inner_interpol(images, ranges, p, endZL, -1, scale, zoomlevels, transforms);
               return false;
         }
-        v_printf_tty((endZL==0?2:10),"\r%i%% done [%i/%i] DEC[%i,%ux%u]  ",(int)(100*pixels_done/pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
+        v_printf_tty((endZL==0?2:10),"\r%i%% done [%i/%i] DEC[%i,%ux%u]  ",(int)(100*progress.pixels_done/progress.pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
         for (Image& image : images) { image.getPlane(p).prepare_zoomlevel(z); }
         if (p>0) for (Image& image : images) { image.getPlane(0).prepare_zoomlevel(z); }
         if (p<3 && nump>3) for (Image& image : images) { image.getPlane(3).prepare_zoomlevel(z); }
@@ -736,31 +917,32 @@ bool flif_decode_FLIF2_inner(IO& io, Rac &rac, std::vector<Coder> &coders, Image
 //        ConstantPlane null_alpha(1);
 //        GeneralPlane &alpha = nump > 3 ? images[0].getPlane(3) : null_alpha;
         if (z % 2 == 0) {
-                if (images[0].getDepth() <= 8) { if (!flif_decode_FLIF2_inner_horizontal<IO,Rac,Coder,Plane<ColorVal_intern_8>,ranges_t>(p,io, rac, coders, images, ranges, beginZL, endZL, quality, scale, i, z, predictor, zoomlevels, transforms, options.invisible_predictor)) return false;}
+                if (images[0].getDepth() <= 8) { if (!flif_decode_FLIF2_inner_horizontal<IO,Rac,Coder,Plane<ColorVal_intern_8>,ranges_t>(p,io, rac, coders, images, ranges, beginZL, endZL, quality, scale, i, z, predictor, zoomlevels, transforms, options.invisible_predictor, progress)) return false;}
 #ifdef SUPPORT_HDR
-                else if (images[0].getDepth() > 8) { if (!flif_decode_FLIF2_inner_horizontal<IO,Rac,Coder,Plane<ColorVal_intern_16u>,ranges_t>(p,io, rac, coders, images, ranges, beginZL, endZL, quality, scale, i, z, predictor, zoomlevels, transforms, options.invisible_predictor)) return false; }
+                else if (images[0].getDepth() > 8) { if (!flif_decode_FLIF2_inner_horizontal<IO,Rac,Coder,Plane<ColorVal_intern_16u>,ranges_t>(p,io, rac, coders, images, ranges, beginZL, endZL, quality, scale, i, z, predictor, zoomlevels, transforms, options.invisible_predictor, progress)) return false; }
 #endif
         } else {
-                if (images[0].getDepth() <= 8) { if (!flif_decode_FLIF2_inner_vertical<IO,Rac,Coder,Plane<ColorVal_intern_8>,ranges_t>(p,io, rac, coders, images, ranges, beginZL, endZL, quality, scale, i, z, predictor, zoomlevels, transforms, options.invisible_predictor)) return false;}
+                if (images[0].getDepth() <= 8) { if (!flif_decode_FLIF2_inner_vertical<IO,Rac,Coder,Plane<ColorVal_intern_8>,ranges_t>(p,io, rac, coders, images, ranges, beginZL, endZL, quality, scale, i, z, predictor, zoomlevels, transforms, options.invisible_predictor, progress)) return false;}
 #ifdef SUPPORT_HDR
-                else if (images[0].getDepth() > 8) { if (!flif_decode_FLIF2_inner_vertical<IO,Rac,Coder,Plane<ColorVal_intern_16u>,ranges_t>(p,io, rac, coders, images, ranges, beginZL, endZL, quality, scale, i, z, predictor, zoomlevels, transforms, options.invisible_predictor)) return false;}
+                else if (images[0].getDepth() > 8) { if (!flif_decode_FLIF2_inner_vertical<IO,Rac,Coder,Plane<ColorVal_intern_16u>,ranges_t>(p,io, rac, coders, images, ranges, beginZL, endZL, quality, scale, i, z, predictor, zoomlevels, transforms, options.invisible_predictor, progress)) return false;}
 #endif
 
         }
         if (endZL==0) {
-          v_printf(3,"    read %li bytes   ", io.ftell());
+          v_printf(3,"    read %li bytes   ", rac.ftell());
           v_printf(5,"\n");
         }
         zoomlevels[p]--;
-        int qual = 10000*pixels_done/pixels_todo;
-        if (callback && p<4 && (endZL==0 || i+1 == plane_zoomlevels(images[0], beginZL, endZL)) && qual >= progressive_qual_target) {
+        int qual = 10000*progress.pixels_done/progress.pixels_todo;
+        if (callback && p<4 && (endZL==0 || i+1 == plane_zoomlevels(images[0], beginZL, endZL)) && qual >= progress.progressive_qual_target) {
           auto populatePartialImages = [&] () {
             std::unique_ptr<bool[]> skipInterpolate(new bool[ranges->numPlanes()]);
             for (int pn = 0; pn < ranges->numPlanes(); pn++) {
               skipInterpolate[pn] = pn == 4 || ranges->min(pn) >= ranges->max(pn);
             }
             for (unsigned int n=0; n < images.size(); n++) {
-              partial_images[n] = Image(images[n], skipInterpolate.get(), zoomlevels); // make a skipped copy to work with
+              partial_images[n].recycle(preview_pool);
+              partial_images[n] = Image(images[n], skipInterpolate.get(), zoomlevels, &preview_pool); // make a skipped copy to work with
             }
 
             std::vector<Transform<IO>*> transforms_copy = transforms;
@@ -783,18 +965,18 @@ bool flif_decode_FLIF2_inner(IO& io, Rac &rac, std::vector<Coder> &coders, Image
               }
             }
 
-            int64_t pixels_really_done = pixels_done;
+            int64_t pixels_really_done = progress.pixels_done;
 
             flif_decode_FLIF2_inner_interpol(partial_images, rangesCopy, 0, endZL, -1, scale, zoomlevels_copy, transforms_copy);
             if (endZL>0) {
               flif_decode_FLIF2_inner_interpol(partial_images, rangesCopy, 0, 0, -1, scale, zoomlevels_copy, transforms_copy);
             }
-            pixels_done = pixels_really_done;
+            progress.pixels_done = pixels_really_done;
             for (Image& image : partial_images) {
               image.normalize_scale();
             }
             if (options.fit) {
-              downsample(partial_images[0].cols(), partial_images[0].rows(), options.resize_width, options.resize_height, partial_images);
+              downsample(partial_images[0].cols(), partial_images[0].rows(), options.resize_width, options.resize_height, partial_images, options.plane_pool);
             }
 
             if (scale != 1) {
@@ -807,9 +989,9 @@ bool flif_decode_FLIF2_inner(IO& io, Rac &rac, std::vector<Coder> &coders, Image
 
           };
 
-          progressive_qual_shown = qual;
-          progressive_qual_target = issue_callback(callback, user_data, qual, io.ftell(), qual == 10000, populatePartialImages);
-          if (qual >= progressive_qual_target) return false;
+          progress.progressive_qual_shown = qual;
+          progress.progressive_qual_target = issue_callback(callback, user_data, qual, rac.ftell(), qual == 10000, populatePartialImages);
+          if (qual >= progress.progressive_qual_target) return false;
         }
       } else zoomlevels[p]--;
     }
@@ -819,7 +1001,7 @@ bool flif_decode_FLIF2_inner(IO& io, Rac &rac, std::vector<Coder> &coders, Image
 template<typename IO, typename Rac, typename Coder>
 bool flif_decode_FLIF2_pass(IO &io, Rac &rac, Images &images, const ColorRanges *ranges, std::vector<Tree> &forest,
                             const int beginZL, const int endZL, flif_options &options, std::vector<Transform<IO>*> &transforms,
-                            callback_t callback, void *user_data, Images &partial_images) {
+                            callback_t callback, void *user_data, Images &partial_images, flif_progress &progress) {
     std::vector<Coder> coders;
     coders.reserve(images[0].numPlanes());
     for (int p = 0; p < images[0].numPlanes(); p++) {
@@ -838,19 +1020,19 @@ bool flif_decode_FLIF2_pass(IO &io, Rac &rac, Images &images, const ColorRanges
              const int minR = ranges->min(p);
              image.set(p,0,0,0, metaCoder.read_int(minR, ranges->max(p) - minR));
           }
-          pixels_done++;
+          progress.pixels_done++;
         }
       }
     }
 #if LARGE_BINARY > 1
     // de-virtualize some of those ColorRanges
     if (const ColorRangesCB * rangesCB = dynamic_cast<const ColorRangesCB*>(ranges))
-        return flif_decode_FLIF2_inner<IO,Rac,Coder,ColorRangesCB>(io, rac, coders, images, rangesCB, beginZL, endZL, options, transforms, callback, user_data, partial_images);
+        return flif_decode_FLIF2_inner<IO,Rac,Coder,ColorRangesCB>(io, rac, coders, images, rangesCB, beginZL, endZL, options, transforms, callback, user_data, partial_images, progress);
     if (const ColorRangesBounds * rangesB = dynamic_cast<const ColorRangesBounds*>(ranges))
-        return flif_decode_FLIF2_inner<IO,Rac,Coder,ColorRangesBounds>(io, rac, coders, images, rangesB, beginZL, endZL, options, transforms, callback, user_data, partial_images);
+        return flif_decode_FLIF2_inner<IO,Rac,Coder,ColorRangesBounds>(io, rac, coders, images, rangesB, beginZL, endZL, options, transforms, callback, user_data, partial_images, progress);
     else
 #endif
-        return flif_decode_FLIF2_inner<IO,Rac,Coder,ColorRanges>(io, rac, coders, images, ranges, beginZL, endZL, options, transforms, callback, user_data, partial_images);
+        return flif_decode_FLIF2_inner<IO,Rac,Coder,ColorRanges>(io, rac, coders, images, ranges, beginZL, endZL, options, transforms, callback, user_data, partial_images, progress);
 }
 
 
@@ -874,32 +1056,32 @@ template<typename IO, typename BitChance, typename Rac> bool flif_decode_tree(FL
     return true;
 }
 
-template <int bits, typename IO>
-bool flif_decode_main(RacIn<IO>& rac, IO& io, Images &images, const ColorRanges *ranges,
-        std::vector<Transform<IO>*> &transforms, flif_options &options, callback_t callback, void *user_data, Images &partial_images) {
+template <int bits, typename IO, typename Rac>
+bool flif_decode_main(Rac& rac, IO& io, Images &images, const ColorRanges *ranges,
+        std::vector<Transform<IO>*> &transforms, flif_options &options, callback_t callback, void *user_data, Images &partial_images, flif_progress &progress, const bool plane_streams) {
     int scale=options.scale;
     std::vector<Tree> forest(ranges->numPlanes(), Tree());
     int roughZL = 0;
     if (options.method.encoding == flifEncoding::interlaced) {
 //      roughZL = images[0].zooms() - NB_NOLEARN_ZOOMS-1;
 //      if (roughZL < 0) roughZL = 0;
-      UniformSymbolCoder<RacIn<IO>> metaCoder(rac);
+      UniformSymbolCoder<Rac> metaCoder(rac);
       roughZL = metaCoder.read_int(0,images[0].zooms());
 //      v_printf(2,"Decoding rough data\n");
-      if (!flif_decode_FLIF2_pass<IO, RacIn<IO>, FinalPropertySymbolCoder<FLIFBitChancePass2, RacIn<IO>, bits> >(io, rac, images, ranges, forest, images[0].zooms(), roughZL+1, options, transforms, callback, user_data, partial_images)) {
+      if (!flif_decode_FLIF2_pass<IO, Rac, FinalPropertySymbolCoder<FLIFBitChancePass2, Rac, bits> >(io, rac, images, ranges, forest, images[0].zooms(), roughZL+1, options, transforms, callback, user_data, partial_images, progress)) {
         std::vector<int> zoomlevels(ranges->numPlanes(),roughZL);
         flif_decode_FLIF2_inner_interpol(images, ranges, 0, 0, -1, scale, zoomlevels, transforms);
         return false;
       }
     }
-    if (options.method.encoding == flifEncoding::interlaced && (options.quality <= 0 || pixels_done >= pixels_todo) && pixels_todo > 1) {
-      v_printf(3,"Not decoding MANIAC tree (%i pixels done, had %i pixels to do)\n", pixels_done, pixels_todo);
+    if (options.method.encoding == flifEncoding::interlaced && (options.quality <= 0 || progress.pixels_done >= progress.pixels_todo) && progress.pixels_todo > 1) {
+      v_printf(3,"Not decoding MANIAC tree (%i pixels done, had %i pixels to do)\n", progress.pixels_done, progress.pixels_todo);
       std::vector<int> zoomlevels(ranges->numPlanes(),roughZL);
       flif_decode_FLIF2_inner_interpol(images, ranges, 0, 0, -1, scale, zoomlevels, transforms);
-      return pixels_done >= pixels_todo;
+      return progress.pixels_done >= progress.pixels_todo;
     } else {
       v_printf(3,"Decoded header + rough data. Decoding MANIAC tree.\n");
-      if (!flif_decode_tree<IO, FLIFBitChanceTree, RacIn<IO>>(io, rac, ranges, forest, options.method.encoding)) {
+      if (!flif_decode_tree<IO, FLIFBitChanceTree, Rac>(io, rac, ranges, forest, options.method.encoding)) {
          if (options.method.encoding == flifEncoding::interlaced) {
             v_printf(1,"File probably truncated in the middle of MANIAC tree representation. Interpolating.\n");
             std::vector<int> zoomlevels(ranges->numPlanes(),roughZL);
@@ -911,29 +1093,29 @@ bool flif_decode_main(RacIn<IO>& rac, IO& io, Images &images, const ColorRanges
 
     switch(options.method.encoding) {
         case flifEncoding::nonInterlaced: v_printf(3,"Decoding data (scanlines)\n");
-                return flif_decode_scanlines_pass<IO, RacIn<IO>, FinalPropertySymbolCoder<FLIFBitChancePass2, RacIn<IO>, bits> >(io, rac, images, ranges, forest, options, transforms, callback, user_data, partial_images);
+                if (plane_streams) {
+                    // the main stream ends after the MANIAC trees
+                    auto in = plane_streams_input(rac);
+                    typedef typename PlaneStreamInput<Rac>::type PlaneRac;
+                    return flif_decode_scanlines_plane_streams<IO, PlaneRac, FinalPropertySymbolCoder<FLIFBitChancePass2, PlaneRac, bits> >(in, images, ranges, forest, options, transforms, callback, user_data, partial_images, progress);
+                }
+                return flif_decode_scanlines_pass<IO, Rac, FinalPropertySymbolCoder<FLIFBitChancePass2, Rac, bits> >(io, rac, images, ranges, forest, options, transforms, callback, user_data, partial_images, progress);
                 break;
         case flifEncoding::interlaced: v_printf(3,"Decoding data (interlaced)\n");
-                return flif_decode_FLIF2_pass<IO, RacIn<IO>, FinalPropertySymbolCoder<FLIFBitChancePass2, RacIn<IO>, bits> >(io, rac, images, ranges, forest, roughZL, 0, options, transforms, callback, user_data, partial_images);
+                return flif_decode_FLIF2_pass<IO, Rac, FinalPropertySymbolCoder<FLIFBitChancePass2, Rac, bits> >(io, rac, images, ranges, forest, roughZL, 0, options, transforms, callback, user_data, partial_images, progress);
                 break;
     }
     return false;
 }
 
-template <typename IO>
-size_t read_big_endian_varint(IO& io) {
-    size_t result = 0;
-    int bytes_read = 0;
-    while (bytes_read++ < 10) {
-      int number = io.get_c();
-      if (number < 0) break;
-      if (number < 128) return result+number;
-      number -= 128;
-      result += number;
-      result <<= 7;
-    }
-    e_printf("Invalid number encountered!\n");
-    return 0;
+template <typename Rac>
+bool read_checksum(Rac& rac, uint32_t &checksum) {
+    UniformSymbolCoder<Rac> metaCoder(rac);
+    if (!metaCoder.read_int(0,1)) return false;
+    checksum = metaCoder.read_int(16);
+    checksum *= 0x10000;
+    checksum += metaCoder.read_int(16);
+    return true;
 }
 
 template <typename IO>
@@ -950,6 +1132,9 @@ int read_chunk(IO& io, MetaData& metadata) {
     if (strcmp(metadata.name,"iCCP")
      && strcmp(metadata.name,"eXif")
      && strcmp(metadata.name,"eXmp")
+     && strcmp(metadata.name,"Tile")
+     && strcmp(metadata.name,"Plns")
+     && strcmp(metadata.name,"zIdx")
     ) {
         if (metadata.name[0] > 'Z') v_printf(1,"Warning: Encountered unknown chunk: %s\n",metadata.name);
         else { e_printf("Error: Encountered unknown critical chunk: %s\n",metadata.name); return -1; }
@@ -963,12 +1148,147 @@ int read_chunk(IO& io, MetaData& metadata) {
     return 0; // read next chunk
 }
 
+// the "Tile" chunk of a tiled image (see flif_encode_tiles)
+struct TileTable {
+    uint32_t tile_width, tile_height;
+    uint32_t tiles_x, tiles_y;
+    int maxmax;
+    std::vector<size_t> offsets;    // where every tile starts (and the last one ends), counted from the first tile
+};
+
+bool read_tile_table(const MetaData& chunk, const int width, const int height, TileTable &table) {
+    BlobReader reader(chunk.contents.data(), chunk.contents.size());
+    table.tile_width = read_big_endian_varint(reader);
+    table.tile_height = read_big_endian_varint(reader);
+    table.maxmax = read_big_endian_varint(reader);
+    if (table.tile_width < 1 || table.tile_height < 1 || table.maxmax < 1 || table.maxmax > 65535) return false;
+    table.tiles_x = (width - 1) / table.tile_width + 1;
+    table.tiles_y = (height - 1) / table.tile_height + 1;
+    const size_t num_tiles = (size_t)table.tiles_x * table.tiles_y;
+    table.offsets.assign(1, 0);
+    for (size_t i = 0; i < num_tiles; i++) {
+        if (reader.isEOF()) return false;
+        table.offsets.push_back(table.offsets.back() + read_big_endian_varint(reader));
+    }
+    return true;
+}
+
+// the "zIdx" chunk of an interlaced image (see flif_encode): where every plane/zoomlevel step ends, counted from the
+// end of the header
+bool read_zoomlevel_index(const MetaData& chunk, std::vector<ZoomlevelOffset> &steps) {
+    BlobReader reader(chunk.contents.data(), chunk.contents.size());
+    const size_t count = read_big_endian_varint(reader);
+    if (count > chunk.contents.size()) return false;
+    steps.clear();
+    uint64_t end = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (reader.isEOF()) return false;
+        ZoomlevelOffset step;
+        step.plane = read_big_endian_varint(reader);
+        step.zoomlevel = read_big_endian_varint(reader);
+        if (reader.isEOF() || step.plane > 4) return false;
+        end += read_big_endian_varint(reader);
+        step.end = end;
+        steps.push_back(step);
+    }
+    return true;
+}
+
+// reads the bytes of the next tile (as far as they are in the file) into buffer; the tiles are stored one after the
+// other in the order of the table, so they are read in that order (and io doesn't have to be seekable)
+template <typename IO>
+void read_tile(IO& io, const TileTable &table, const size_t i, std::vector<uint8_t> &buffer) {
+    buffer.resize(table.offsets[i+1] - table.offsets[i]);
+    size_t done = 0, n;
+    while (done < buffer.size() && (n = io.read_block(buffer.data() + done, buffer.size() - done)) > 0) done += n;
+    buffer.resize(done);
+}
+
+// Decodes the tiles of a tiled image on options.threads threads, and puts them together in images[0].
+// A tile is decoded like any other FLIF file, so with -q or -s every tile is decoded partially or downscaled.
+template <typename IO>
+bool flif_decode_tiles(IO& io, const TileTable &table, Images &images, const int width, const int height,
+                       const int numPlanes, const int scale, flif_options &options, bool &fully_decoded) {
+    if (table.tile_width % scale || table.tile_height % scale) {
+        e_printf("Cannot decode this FLIF file at scale 1:%i, its tiles are %ux%u.\n", scale, table.tile_width, table.tile_height);
+        return false;
+    }
+    images.push_back(Image());
+    Image &image = images[0];
+    if (!image.semi_init((width-1)/scale+1, (height-1)/scale+1, 0, table.maxmax, numPlanes)) return false;
+    if (!image.real_init(false, options.plane_pool)) return false;
+
+    const size_t num_tiles = table.offsets.size() - 1;
+    std::mutex io_mutex;
+    size_t next_tile = 0;   // guarded by io_mutex
+    std::atomic<bool> ok(true), complete(true), alpha_zero_special(true);
+    auto worker = [&]() {
+        std::vector<uint8_t> buffer;
+        // the pool of the decoder can't be shared between threads, so every thread keeps its own (with the same
+        // allocator), which also lets a tile reuse the buffers of the previous one
+        PlanePool tile_pool;
+        tile_pool.set_allocator(options.plane_pool ? options.plane_pool->get_allocator() : nullptr);
+        while (ok) {
+            if (image.cols() == 0) { complete = false; break; } // decode aborted
+            size_t i = 0;
+            try {
+                {
+                    // taking the next tile and reading it go together, so the tiles are read in order
+                    std::lock_guard<std::mutex> lock(io_mutex);
+                    if ((i = next_tile++) >= num_tiles) break;
+                    read_tile(io, table, i, buffer);
+                }
+                const uint32_t r = (i / table.tiles_x) * table.tile_height;
+                const uint32_t c = (i % table.tiles_x) * table.tile_width;
+                const uint32_t tile_cols = (std::min(table.tile_width, width - c) - 1) / scale + 1;
+                const uint32_t tile_rows = (std::min(table.tile_height, height - r) - 1) / scale + 1;
+                if (buffer.empty()) { complete = false; continue; } // truncated file, this tile stays black
+                BlobReader reader(buffer.data(), buffer.size());
+                Images tile_images;
+                flif_options tile_options = options;
+                tile_options.resize_width = tile_options.resize_height = tile_options.fit = 0;
+                tile_options.keep_palette = 0;
+                tile_options.threads = 1;
+                tile_options.plane_pool = &tile_pool;
+                tile_options.row_output = nullptr;
+                metadata_options md = {false, false, false};
+                if (!flif_decode(reader, tile_images, tile_options, md) || tile_images.size() != 1
+                    || tile_images[0].numPlanes() != numPlanes || tile_images[0].cols() != tile_cols || tile_images[0].rows() != tile_rows) {
+                    e_printf("Could not decode tile %u of %u.\n", (unsigned)i, (unsigned)num_tiles);
+                    ok = false;
+                    break;
+                }
+                image.copy_block(tile_images[0], 0, 0, r/scale, c/scale, tile_cols, tile_rows);
+                if (!tile_images[0].fully_decoded) complete = false;
+                if (!tile_images[0].alpha_zero_special) alpha_zero_special = false;
+                tile_images[0].recycle(tile_pool);
+            } catch (std::bad_alloc& ba) {
+                e_printf("Error: could not allocate enough memory for tile %u.\n", (unsigned)i);
+                ok = false;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < std::min((size_t)options.threads, num_tiles); t++) pool.emplace_back(worker);
+    worker();
+    for (std::thread &t : pool) t.join();
+    if (!ok) return false;
+
+    image.alpha_zero_special = alpha_zero_special;
+    fully_decoded = complete;
+    v_printf_tty(2,"\r");
+    v_printf(2,"Decoded input file %s, %li bytes for %ux%u pixels in %u tiles   \n",io.getName(),(long)table.offsets.back(), image.cols(), image.rows(), (unsigned)num_tiles);
+    return true;
+}
+
 template <typename IO>
 bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, int first_callback_quality, Images &partial_images, flif_options &options, metadata_options &md, FLIF_INFO* info) {
+    VerbosityScope verbose(options.verbosity);
     int quality = options.quality;
     int scale = options.scale;
     int rw = options.resize_width;
     int rh = options.resize_height;
+    flif_progress progress;
 
     bool fit = options.fit;
     bool just_identify = false;
@@ -1010,6 +1330,12 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
 
     if (!ioget_int_8bit (io, &c))
         return false;
+    bool use_rans = false;
+    if (c & 128) {
+        // the MANIAC trees, pixel data and checksum are coded with rANS
+        use_rans = true;
+        c -= 128;
+    }
     if (c < ' ' || c > ' '+32+15+32) { e_printf("Invalid or unknown FLIF format byte\n"); return false;}
     c -= ' ';
     int numFrames=1;
@@ -1048,7 +1374,28 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
 #endif
     MetaData chunk;
     int result = 0;
+    bool tiled = false;
+    TileTable tiles;
+    bool plane_streams = false;
+    std::vector<ZoomlevelOffset> zoomlevel_offsets;
     while (!(result = read_chunk(io, chunk))) {
+        if (!strcmp(chunk.name, "Tile")) {
+            if (numFrames > 1 || !read_tile_table(chunk, width, height, tiles)) { e_printf("Invalid tile table.\n"); return false; }
+            tiled = true;
+            continue;
+        }
+        if (!strcmp(chunk.name, "Plns")) {
+            plane_streams = true;
+            continue;
+        }
+        if (!strcmp(chunk.name, "zIdx")) {
+            // only useful to fetch a partial file, so a broken index doesn't stop the decoding
+            if (encoding != flifEncoding::interlaced || !read_zoomlevel_index(chunk, zoomlevel_offsets)) {
+                v_printf(1,"Warning: ignoring invalid zoomlevel index.\n");
+                zoomlevel_offsets.clear();
+            }
+            continue;
+        }
         if (!md.icc && !strcmp(chunk.name, "iCCP")) continue;
         if (!md.exif && !strcmp(chunk.name, "eXif")) continue;
         if (!md.xmp && !strcmp(chunk.name, "eXmp")) continue;
@@ -1065,8 +1412,12 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
         return true;
     }
 
+    if (plane_streams && encoding != flifEncoding::nonInterlaced) { e_printf("Invalid FLIF file: plane streams are only possible in non-interlaced images.\n"); return false; }
+    if (tiled && options.show_breakpoints) { e_printf("Tiled FLIF file, no breakpoints to report.\n"); return false; }
     if (options.show_breakpoints) v_printf(1,"Image data starts at offset %li\n",io.ftell());
 
+    // for tiled images, this is where the first tile starts (and the range coder below only reads ahead into it)
+    const long data_start = io.ftell();
     RacIn<IO> rac(io);
 //    SimpleSymbolCoder<FLIFBitChanceMeta, RacIn<IO>, 18> metaCoder(rac);
     UniformSymbolCoder<RacIn<IO>> metaCoder(rac);
@@ -1083,7 +1434,7 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
 //        int min = 0;
         int max = 255;
         if (c=='2') max=65535;
-        else if (c=='0') max=(1 << metaCoder.read_int(1, 15)) - 1;
+        else if (c=='0') max=(tiled ? tiles.maxmax : (1 << metaCoder.read_int(1, 15)) - 1);
         if (max>maxmax) maxmax=max;
 //        image.add_plane(min, max);
 //        v_printf(2," [%i] %i bpp (%i..%i)",p,ilog2(image.max(p)+1),image.min(p), image.max(p));
@@ -1093,7 +1444,7 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
     else if (c=='2') v_printf(3," %i, depth: 16 bit",numPlanes);
     if (numFrames>1) v_printf(3,", frames: %i",numFrames);
     bool alphazero=false;
-    if (numPlanes>3) {
+    if (numPlanes>3 && !tiled) {
         alphazero=metaCoder.read_int(0, 1);
         if (!alphazero) v_printf(3, ", store RGB at A=0");
     }
@@ -1111,6 +1462,10 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
         else if (numPlanes == 4) v_printf(1,"RGBA");
         if (encoding == flifEncoding::nonInterlaced) v_printf(1,", non-interlaced");
         else if (encoding == flifEncoding::interlaced) v_printf(1,", interlaced");
+        if (use_rans) v_printf(1,", rANS");
+        if (plane_streams) v_printf(1,", plane streams");
+        if (zoomlevel_offsets.size()) v_printf(1,", zoomlevel index");
+        if (tiled) v_printf(1,", %u tiles of %ux%u", tiles.tiles_x*tiles.tiles_y, tiles.tile_width, tiles.tile_height);
         v_printf(1,"\n");
         if (metadata.size() > 0) {
             v_printf(1, "Contains metadata: ");
@@ -1135,6 +1490,8 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
         else if (c=='0')
             info->bit_depth = ilog2(maxmax+1);
         info->num_images = numFrames;
+        info->zoomlevel_offsets = zoomlevel_offsets;
+        for (ZoomlevelOffset &step : info->zoomlevel_offsets) step.end += data_start;
         return true; // info was requested, skip the rest of the file
     }
     if (numFrames>1) {
@@ -1160,14 +1517,32 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
     if (scale_shift>0) v_printf(3,"Decoding downscaled image at scale 1:%i (%ix%i -> %ix%i)\n", scale, width, height, ((width-1)/scale)+1, ((height-1)/scale)+1);
     uint64_t bytesperpixel = (maxmax > 255 ? 2 : 1) * (numPlanes + (numPlanes > 1 ? 2 : 0));
     uint64_t estimated_buffer_size = (uint64_t)(((width-1)/scale)+1) * (uint64_t)(((height-1)/scale)+1) * (uint64_t)numFrames * (uint64_t)numPlanes * bytesperpixel;
-    if (estimated_buffer_size > MAX_IMAGE_BUFFER_SIZE) {
-        e_printf("This is going to take too much memory (%llu > %llu). Aborting.\nCompile with a higher MAX_IMAGE_BUFFER_SIZE if you really want to do this.\n",estimated_buffer_size, MAX_IMAGE_BUFFER_SIZE); return false;
+    // (with out-of-core planes, the image only has to fit on the disk)
+    if (estimated_buffer_size > MAX_IMAGE_BUFFER_SIZE && !mapped_planes_enabled()) {
+        e_printf("This is going to take too much memory (%llu > %llu). Aborting.\nCompile with a higher MAX_IMAGE_BUFFER_SIZE or use out-of-core planes if you really want to do this.\n",estimated_buffer_size, MAX_IMAGE_BUFFER_SIZE); return false;
     }
     if (numFrames > MAX_FRAMES) {
         e_printf("Too many frames. Aborting.\nCompile with a higher MAX_FRAMES value if you really want to do this.\n");
         return false;
     }
 
+    if (tiled) {
+        bool fully_decoded = false;
+        // the range coder has already read ahead into the first tile, so continue from its window
+        ResumeReader<IO> tile_io(io, rac.window(), rac.window_size());
+        if (!flif_decode_tiles(tile_io, tiles, images, width, height, numPlanes, scale, options, fully_decoded)) return false;
+        images[0].fully_decoded = fully_decoded;
+        if (!fully_decoded && quality>=100 && scale==1 && !options.no_full_decode) v_printf(1,"File ended prematurely or decoding was interrupted.\n");
+        if (fit) downsample(width, height, target_w, target_h, images, options.plane_pool);
+        if (options.row_output) options.row_output->rows(images[0], 0, images[0].rows());
+        if (callback) {
+            partial_images.push_back(Image());
+            issue_callback(callback, user_data, 10000, io.ftell(), true, [&] () { partial_images[0] = images[0].clone(options.plane_pool); });
+        }
+        if (options.metadata) images[0].metadata = metadata;
+        return true;
+    }
+
     for (int i=0; i<numFrames; i++) {
       try {
       images.push_back(Image(scale_shift));
@@ -1200,7 +1575,7 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
     int tcount=0;
     int tnb=0, tpnb=-1;
     while (rac.read_bit()) {
-        if (io.isEOF()) {
+        if (rac.isEOF()) {
             e_printf("Unexpected file end while reading header. Aborting.\n");
             return false;
         }
@@ -1257,12 +1632,12 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
 
     int realnumplanes = 0;
     for (int i=0; i<ranges->numPlanes(); i++) if (ranges->min(i)<ranges->max(i)) realnumplanes++;
-    pixels_todo = (long unsigned)width*height*realnumplanes/scale/scale;
-    pixels_done = 0;
-    if (pixels_todo == 0) pixels_todo = pixels_done = 1;
-    progressive_qual_target = first_callback_quality;
-    progressive_qual_shown = -1;
-    v_printf(9,"%lu subpixels done (%i channels), %lu subpixels todo, quality target %i%%\n",(long unsigned)pixels_done,realnumplanes,(long unsigned)pixels_todo,(int)quality);
+    progress.pixels_todo = (long unsigned)width*height*realnumplanes/scale/scale;
+    progress.pixels_done = 0;
+    if (progress.pixels_todo == 0) progress.pixels_todo = progress.pixels_done = 1;
+    progress.progressive_qual_target = first_callback_quality;
+    progress.progressive_qual_shown = -1;
+    v_printf(9,"%lu subpixels done (%i channels), %lu subpixels todo, quality target %i%%\n",(long unsigned)progress.pixels_done,realnumplanes,(long unsigned)progress.pixels_todo,(int)quality);
 
     for (int p = 0; p < ranges->numPlanes(); p++) {
       v_printf(10,"Plane %i: %i..%i\n",p,ranges->min(p),ranges->max(p));
@@ -1284,7 +1659,8 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
     // Y plane shouldn't be constant, even if it is (because we want to avoid special-casing fast Y plane access)
     if (!smaller_buffer) for (int fr = 0; fr < numFrames; fr++) images[fr].undo_make_constant_plane(0);
 
-    for (int fr = 0; fr < numFrames; fr++) if (! images[fr].real_init(smaller_buffer)) return false;
+    for (int fr = 0; fr < numFrames; fr++) if (! images[fr].real_init(smaller_buffer, options.plane_pool)) return false;
+    for (Image& image : images) image.advise_mapped_planes(encoding == flifEncoding::interlaced);
 
     // Alpha plane is never special if it is never zero
     if (ranges->numPlanes()>3 && ranges->min(3) > 0)
@@ -1310,22 +1686,39 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
 #else
     if (mbits > bits) { e_printf("This FLIF cannot decode >8 bit per channel. Please compile with SUPPORT_HDR.\n"); return false;}
 #endif
+    // the range coder stream ends here, and the rANS stream starts with what the RacInput has read ahead
+    std::unique_ptr<ResumeReader<IO>> rans_io;
+    std::unique_ptr<RansInput<ResumeReader<IO>>> rans;
+    if (use_rans) {
+        rans_io.reset(new ResumeReader<IO>(io, rac.read_ahead(), rac.read_ahead_size()));
+        rans.reset(new RansInput<ResumeReader<IO>>(*rans_io));
+    }
+    // (the plane streams come after the main stream)
+    auto data_ftell = [&] () { return plane_streams ? io.ftell() : rans ? rans->ftell() : rac.ftell(); };
+
+    // with plane streams, the checksum comes before the MANIAC trees
+    uint32_t checksum2 = 0;
+    bool contains_checksum = false;
+    if (plane_streams) contains_checksum = (rans ? read_checksum(*rans, checksum2) : read_checksum(rac, checksum2));
+
     bool fully_decoded;
     if (bits == 10) {
-       fully_decoded = flif_decode_main<10>(rac, io, images, ranges, transform_ptrs, options, callback, user_data, partial_images);
+       fully_decoded = rans ? flif_decode_main<10>(*rans, io, images, ranges, transform_ptrs, options, callback, user_data, partial_images, progress, plane_streams)
+                            : flif_decode_main<10>(rac, io, images, ranges, transform_ptrs, options, callback, user_data, partial_images, progress, plane_streams);
 #ifdef SUPPORT_HDR
     } else {
-       fully_decoded = flif_decode_main<18>(rac, io, images, ranges, transform_ptrs, options, callback, user_data, partial_images);
+       fully_decoded = rans ? flif_decode_main<18>(*rans, io, images, ranges, transform_ptrs, options, callback, user_data, partial_images, progress, plane_streams)
+                            : flif_decode_main<18>(rac, io, images, ranges, transform_ptrs, options, callback, user_data, partial_images, progress, plane_streams);
 #endif
     }
 
    v_printf_tty(2,"\r");
    if (numFrames==1)
-      v_printf(2,"Decoded input file %s, %li bytes for %ux%u pixels (%.4fbpp)   \n",io.getName(),io.ftell(), images[0].cols()/scale, images[0].rows()/scale, 8.0*io.ftell()/images[0].rows()*scale*scale/images[0].cols());
+      v_printf(2,"Decoded input file %s, %li bytes for %ux%u pixels (%.4fbpp)   \n",io.getName(),data_ftell(), images[0].cols()/scale, images[0].rows()/scale, 8.0*data_ftell()/images[0].rows()*scale*scale/images[0].cols());
     else
-      v_printf(2,"Decoded input file %s, %li bytes for %i frames of %ux%u pixels (%.4fbpp)   \n",io.getName(),io.ftell(), numFrames, images[0].cols()/scale, images[0].rows()/scale, 8.0*io.ftell()/numFrames/images[0].rows()*scale*scale/images[0].cols());
+      v_printf(2,"Decoded input file %s, %li bytes for %i frames of %ux%u pixels (%.4fbpp)   \n",io.getName(),data_ftell(), numFrames, images[0].cols()/scale, images[0].rows()/scale, 8.0*data_ftell()/numFrames/images[0].rows()*scale*scale/images[0].cols());
 
-    bool contains_checksum = metaCoder.read_int(0,1);
+    if (!plane_streams) contains_checksum = (rans ? read_checksum(*rans, checksum2) : read_checksum(rac, checksum2));
 
     for (Image& i : images) {
         i.normalize_scale();
@@ -1333,7 +1726,21 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
             i.fully_decoded=true;
     }
 
-    if (!smaller_buffer || !images[0].palette) {
+    // a single frame that goes to a row output as it is (not resized) can be finished in bands of rows: every band
+    // gets all inverse transforms and then goes out while it is still in the cache (instead of one pass over the
+    // whole image per transform and another one to copy it out)
+    bool output_in_bands = options.row_output && numFrames == 1 && !fit && !(alphazero && options.crc_check)
+                           && (!smaller_buffer || !images[0].palette);
+    for (const auto &t : transform_ptrs) if (!t->undo_by_rows()) output_in_bands = false;
+    if (output_in_bands) {
+      const uint32_t rows = images[0].rows(), band = std::max<uint32_t>(1, ROW_OUTPUT_BAND_VALUES / images[0].cols());
+      for (uint32_t begin = 0; begin < rows; begin += band) {
+        const uint32_t end = std::min(rows, begin + band);
+        for (int i = transform_ptrs.size() - 1; i >= 0; i--) transform_ptrs[i]->invDataRows(images, begin, end);
+        options.row_output->rows(images[0], begin, end);
+      }
+      transform_ptrs.clear();
+    } else if (!smaller_buffer || !images[0].palette) {
       while(!transform_ptrs.empty()) {
         transform_ptrs.back()->invData(images);
         transform_ptrs.pop_back();
@@ -1357,7 +1764,7 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
           transform_ptrs.back()->invData(palette);
           transform_ptrs.pop_back();
         }
-        std::shared_ptr<Image> p_image = std::make_shared<Image>(palette[0].clone());
+        std::shared_ptr<Image> p_image = std::make_shared<Image>(palette[0].clone(options.plane_pool));
         for (Image& i : images) i.palette_image = p_image;
       }
     }
@@ -1372,12 +1779,9 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
     } else if (quality>=100 && scale==1 && fully_decoded) {
       if (contains_checksum) {
         // don't bother making the invisible pixels black if we're not checking the crc anyway
-        if (alphazero && options.crc_check) for (Image& image : images) image.make_invisible_rgb_black();
+        if (alphazero && options.crc_check) for (Image& image : images) image.make_invisible_rgb_black(options.plane_pool);
         const uint32_t checksum = images[0].checksum();
         v_printf(8,"Computed checksum: %X\n", checksum);
-        uint32_t checksum2 = metaCoder.read_int(16);
-        checksum2 *= 0x10000;
-        checksum2 += metaCoder.read_int(16);
         v_printf(8,"Read checksum: %X\n", checksum2);
         if (checksum != checksum2) {
           v_printf(1,"\nCORRUPTION DETECTED: checksums don't match (computed: %x v/s read: %x)! (partial file?)\n\n", checksum, checksum2);
@@ -1398,16 +1802,17 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
 
     // downscale to target_w, target_h
     if (fit) {
-      downsample(width, height, target_w, target_h, images);
+      downsample(width, height, target_w, target_h, images, options.plane_pool);
     }
+    if (options.row_output && !output_in_bands) options.row_output->rows(images[0], 0, images[0].rows());
 
     // ensure that the callback gets called even if the image is completely constant
-    if (progressive_qual_target > 10000) progressive_qual_target = 10000;
-    if (callback && progressive_qual_target > progressive_qual_shown) {
+    if (progress.progressive_qual_target > 10000) progress.progressive_qual_target = 10000;
+    if (callback && progress.progressive_qual_target > progress.progressive_qual_shown) {
         auto populatePartialImages = [&] () {
-          for (unsigned int n=0; n < images.size(); n++) partial_images[n] = images[n].clone(); // make a copy to work with
+          for (unsigned int n=0; n < images.size(); n++) partial_images[n] = images[n].clone(options.plane_pool); // make a copy to work with
         };
-        issue_callback(callback, user_data, 10000*pixels_done/pixels_todo, io.ftell(), true, populatePartialImages);
+        issue_callback(callback, user_data, 10000*progress.pixels_done/progress.pixels_todo, data_ftell(), true, populatePartialImages);
     }
 
     if (options.metadata) {
@@ -1418,3 +1823,4 @@ bool flif_decode(IO& io, Images &images, callback_t callback, void *user_data, i
 
 template bool flif_decode(FileIO& io, Images &images, callback_t callback, void *user_data, int, Images &partial_images, flif_options &, metadata_options &, FLIF_INFO* info);
 template bool flif_decode(BlobReader& io, Images &images, callback_t callback, void *user_data, int, Images &partial_images, flif_options &, metadata_options &, FLIF_INFO* info);
+template bool flif_decode(StreamReader& io, Images &images, callback_t callback, void *user_data, int, Images &partial_images, flif_options &, metadata_options &, FLIF_INFO* info);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "common.hpp"
+
 struct FLIF_INFO
 {
     FLIF_INFO();
@@ -9,6 +11,15 @@ struct FLIF_INFO
     uint8_t channels;
     uint8_t bit_depth;
     size_t num_images;
+    std::vector<ZoomlevelOffset> zoomlevel_offsets; // from the "zIdx" chunk, with offsets counted from the start of the file
+};
+
+// receives the rows of the decoded image (the first frame) when they are final, e.g. to copy them out while they
+// are still in the cache; rows may come in bands as the last transforms are undone, or all at once at the end
+class RowOutput {
+public:
+    virtual ~RowOutput() {}
+    virtual void rows(Image &image, uint32_t begin, uint32_t end) = 0;
 };
 
 typedef uint32_t (*callback_t)(uint32_t quality, int64_t bytes_read, uint8_t decode_over, void *user_data, void *context);
@@ -20,8 +20,12 @@
 #ifdef HAS_ENCODER
 #include <string>
 #include <string.h>
+#include <atomic>
+#include <thread>
+#include <type_traits>
 
 #include "maniac/rac.hpp"
+#include "maniac/rans.hpp"
 #include "maniac/compound.hpp"
 #include "maniac/util.hpp"
 
@@ -32,6 +36,7 @@
 
 #include "common.hpp"
 #include "fileio.hpp"
+#include "flif-enc.hpp"
 
 using namespace maniac::util;
 
@@ -46,14 +51,27 @@ template<typename RAC> void static write_name(RAC& rac, std::string desc) {
     coder.write_int(0, MAX_TRANSFORM, nb);
 }
 
+// Sampled learning: with sample > 1, only every sample-th band of LEARN_SAMPLE_BAND rows is used, starting at a
+// different band in every repeat. Zoomlevels with less than sample bands are learned completely.
+inline bool learn_row(const uint32_t row, const uint32_t rows, const int sample, const int repeat) {
+    if (sample <= 1 || rows < (uint32_t)LEARN_SAMPLE_BAND * sample) return true;
+    return (row / LEARN_SAMPLE_BAND + repeat) % sample == 0;
+}
+
 // alphazero = true: image has alpha plane and A=0 implies RGB(YIQ) is irrelevant
 // alphazero = false: image either has no alpha plane, or A=0 has no special meaning
 // FRA = true: image has FRA plane (animation with lookback)
+// only_plane >= 0: only encode that plane (used when learning the planes on separate threads); progress is then not
+// printed or added to progress.pixels_done, but returned
+// sample, repeat: see learn_row (only for learning)
 template<typename IO, typename Rac, typename Coder>
-void flif_encode_scanlines_inner(IO& io, FLIF_UNUSED(Rac& rac), std::vector<Coder> &coders, const Images &images, const ColorRanges *ranges) {
+int64_t flif_encode_scanlines_inner(IO& io, FLIF_UNUSED(Rac& rac), std::vector<Coder> &coders, const Images &images, const ColorRanges *ranges,
+                                    flif_progress &progress, const int only_plane = -1, const int sample = 1, const int repeat = 0) {
     const std::vector<ColorVal> greys = computeGreys(ranges);
     ColorVal min,max;
-    long fs = io.ftell();
+    int64_t plane_pixels_done = 0;
+    int64_t &done = (only_plane < 0 ? progress.pixels_done : plane_pixels_done);
+    long fs = (only_plane < 0 ? io.ftell() : 0);
     long pixels = images[0].cols()*images[0].rows()*images.size();
     const int nump = images[0].numPlanes();
     const bool alphazero = (nump>3 && images[0].alpha_zero_special);
@@ -64,12 +82,14 @@ void flif_encode_scanlines_inner(IO& io, FLIF_UNUSED(Rac& rac), std::vector<Code
         int p=PLANE_ORDERING[k];
         if (p>=nump) continue;
         i++;
+        if (only_plane >= 0 && p != only_plane) continue;
         if (ranges->min(p) >= ranges->max(p)) continue;
         const ColorVal minP = ranges->min(p);
         Properties properties((nump>3?NB_PROPERTIES_scanlinesA[p]:NB_PROPERTIES_scanlines[p]));
-        v_printf_tty(2,"\r%i%% done [%i/%i] ENC[%ux%u]    ",(int)(100*pixels_done/pixels_todo),i,nump,images[0].cols(),images[0].rows());
-        pixels_done += images[0].cols()*images[0].rows();
+        if (only_plane < 0) v_printf_tty(2,"\r%i%% done [%i/%i] ENC[%ux%u]    ",(int)(100*progress.pixels_done/progress.pixels_todo),i,nump,images[0].cols(),images[0].rows());
+        done += images[0].cols()*images[0].rows();
         for (uint32_t r = 0; r < images[0].rows(); r++) {
+            if (!learn_row(r, images[0].rows(), sample, repeat)) continue;
             for (int fr=0; fr< (int)images.size(); fr++) {
               const Image& image = images[fr];
               if (image.seen_before >= 0) continue;
@@ -89,6 +109,7 @@ void flif_encode_scanlines_inner(IO& io, FLIF_UNUSED(Rac& rac), std::vector<Code
               }
             }
         }
+        if (only_plane >= 0) continue;
         long nfs = io.ftell();
         if (nfs-fs > 0) {
            v_printf(3,"filesize : %li (+%li for %li pixels, %f bpp)", nfs, nfs-fs, pixels, 8.0*(nfs-fs)/pixels );
@@ -96,10 +117,48 @@ void flif_encode_scanlines_inner(IO& io, FLIF_UNUSED(Rac& rac), std::vector<Code
         }
         fs = nfs;
     }
+    return plane_pixels_done;
+}
+
+// Calls learn(p) for every plane p, spread over at most `threads` threads (including the calling one).
+// learn(p) returns the number of pixels it has done, which is added to progress.pixels_done afterwards.
+template<typename Learn>
+void learn_planes_threaded(const int nump, const int threads, flif_progress &progress, Learn learn) {
+    std::atomic<int> next_plane(0);
+    std::atomic<int64_t> done(0);
+    const int verbosity = get_verbosity();
+    auto worker = [&]() {
+        VerbosityScope verbose(verbosity);
+        int p;
+        while ((p = next_plane++) < nump) done += learn(p);
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < std::min(threads, nump); t++) pool.emplace_back(worker);
+    worker();
+    for (std::thread &t : pool) t.join();
+    progress.pixels_done += done;
 }
 
 template<typename IO, typename Rac, typename Coder>
-void flif_encode_scanlines_pass(IO& io, Rac &rac, const Images &images, const ColorRanges *ranges, std::vector<Tree> &forest, int repeats, flif_options &options) {
+void flif_encode_scanlines_repeats(IO& io, Rac &rac, std::vector<Coder> &coders, const Images &images, const ColorRanges *ranges, int repeats, flif_options &options, flif_progress &progress) {
+    const int learn_sample = (std::is_same<Rac, RacDummy>::value ? options.learn_sample : 1);
+    if (options.threads > 1 && std::is_same<Rac, RacDummy>::value) {
+        // learning pass: every plane has its own tree and only reads the (known) image, so the planes can be learned
+        // concurrently and the trees are the same as when learning them one after the other
+        learn_planes_threaded(ranges->numPlanes(), options.threads, progress, [&](int p) {
+            int64_t done = 0;
+            for (int i = 0; i < repeats; i++) done += flif_encode_scanlines_inner<IO,Rac,Coder>(io, rac, coders, images, ranges, progress, p, learn_sample, i);
+            return done;
+        });
+    } else {
+        for (int i = 0; i < repeats; i++) {
+         flif_encode_scanlines_inner<IO,Rac,Coder>(io, rac, coders, images, ranges, progress, -1, learn_sample, i);
+        }
+    }
+}
+
+template<typename IO, typename Rac, typename Coder>
+void flif_encode_scanlines_pass(IO& io, Rac &rac, const Images &images, const ColorRanges *ranges, std::vector<Tree> &forest, int repeats, flif_options &options, flif_progress &progress) {
 
     std::vector<Coder> coders;
     coders.reserve(ranges->numPlanes());
@@ -110,15 +169,63 @@ void flif_encode_scanlines_pass(IO& io, Rac &rac, const Images &images, const Co
         coders.emplace_back(rac, propRanges, forest[p], options.split_threshold, options.cutoff, options.alpha);
     }
 
-    while(repeats-- > 0) {
-     flif_encode_scanlines_inner<IO,Rac,Coder>(io, rac, coders, images, ranges);
-    }
+    flif_encode_scanlines_repeats<IO,Rac,Coder>(io, rac, coders, images, ranges, repeats, options, progress);
 
     for (int p = 0; p < ranges->numPlanes(); p++) {
         coders[p].simplify(options.divisor, options.min_size, p);
     }
 }
 
+template <typename IO>
+void write_big_endian_varint(IO& io, unsigned long number, bool done = true) {
+    if (number < 128) {
+        if (done) io.fputc(number);
+        else io.fputc(number + 128);
+    } else {
+        unsigned long lsb = (number & 127);
+        number >>= 7;
+        write_big_endian_varint(io, number, false);
+        write_big_endian_varint(io, lsb, done);
+    }
+}
+
+// Separate plane streams (non-interlaced only): every plane has its own range coder (or rANS coder, like the main
+// stream), so the planes can be encoded and decoded on separate threads. The main stream is closed after the MANIAC
+// trees; it is followed by the length of every plane stream (in plane order, 0 for constant planes) and then the plane
+// streams themselves.
+template<typename IO, typename PlaneRac, typename Coder>
+void flif_encode_scanlines_plane_streams(IO& io, const Images &images, const ColorRanges *ranges, std::vector<Tree> &forest, flif_options &options, flif_progress &progress) {
+    const int nump = ranges->numPlanes();
+    std::vector<BlobIO> streams(nump);
+    std::vector<std::unique_ptr<PlaneRac>> racs;
+    std::vector<Coder> coders;
+    coders.reserve(nump);
+    for (int p = 0; p < nump; p++) {
+        Ranges propRanges;
+        initPropRanges_scanlines(propRanges, *ranges, p);
+        racs.emplace_back(new PlaneRac(streams[p]));
+        coders.emplace_back(*racs[p], propRanges, forest[p], 0, options.cutoff, options.alpha);
+    }
+    v_printf_tty(2,"\rENC[%ux%u, %i plane streams]    ",images[0].cols(),images[0].rows(),nump);
+    learn_planes_threaded(nump, options.threads, progress, [&](int p) {
+        if (ranges->min(p) >= ranges->max(p)) return (int64_t)0;
+        int64_t done = flif_encode_scanlines_inner<BlobIO, PlaneRac, Coder>(streams[p], *racs[p], coders, images, ranges, progress, p);
+        racs[p]->flush();
+        return done;
+    });
+
+    for (int p = 0; p < nump; p++) {
+        write_big_endian_varint(io, streams[p].ftell());
+        v_printf(3," plane %i: %i bytes.", p, streams[p].ftell());
+    }
+    v_printf(3,"\n");
+    for (int p = 0; p < nump; p++) {
+        size_t length;
+        std::unique_ptr<uint8_t[]> data(streams[p].release(&length));
+        io.write_block(data.get(), length);
+    }
+}
+
 // return the predictor that has the smallest total difference
 int find_best_predictor(const Images &images, const ColorRanges *ranges, const int p, const int z) {
     const int zerobonus = 1;
@@ -191,9 +298,15 @@ int find_best_predictor(const Images &images, const ColorRanges *ranges, const i
     return best;
 }
 
+// only_plane, sample, repeat: like flif_encode_scanlines_inner
+// how many bytes of the range coder stream a decoder needs to get to the current position (-1: nothing is written)
+template <typename IO> long rac_bytes_needed(const RacOut<IO> &rac) { return rac.bytes_needed(); }
+template <typename Rac> long rac_bytes_needed(const Rac &) { return -1; }
+
 template<typename IO, typename Rac, typename Coder>
-void flif_encode_FLIF2_inner(IO& io, Rac& rac, std::vector<Coder> &coders, const Images &images,
-                             const ColorRanges *ranges, const int beginZL, const int endZL, flif_options &options) {
+int64_t flif_encode_FLIF2_inner(IO& io, Rac& rac, std::vector<Coder> &coders, const Images &images,
+                             const ColorRanges *ranges, const int beginZL, const int endZL, flif_options &options,
+                             flif_progress &progress, const int only_plane = -1, const int sample = 1, const int repeat = 0) {
     ColorVal min,max;
     const int nump = images[0].numPlanes();
     const bool alphazero = (nump>3 && images[0].alpha_zero_special);
@@ -201,7 +314,10 @@ void flif_encode_FLIF2_inner(IO& io, Rac& rac, std::vector<Coder> &coders, const
 #ifdef SUPPORT_ANIMATION
     const bool FRA = (nump == 5);
 #endif
-    long fs = io.ftell();
+    int64_t plane_pixels_done = 0;
+    int64_t &done = (only_plane < 0 ? progress.pixels_done : plane_pixels_done);
+    const bool report = (endZL == 0 && only_plane < 0);
+    long fs = (only_plane < 0 ? io.ftell() : 0);
     UniformSymbolCoder<Rac> metaCoder(rac);
     const bool default_order = (options.chroma_subsampling==0);
     metaCoder.write_int(0, 1, (default_order? 1 : 0)); // we're using the default zoomlevel/plane ordering
@@ -212,17 +328,21 @@ void flif_encode_FLIF2_inner(IO& io, Rac& rac, std::vector<Coder> &coders, const
       int z = pzl.second;
       if (options.chroma_subsampling && p > 0 && p < 3 && z < 2) continue;
       if (!default_order) metaCoder.write_int(0, nump-1, p);
+      if (only_plane >= 0 && p != only_plane) continue;
       if (ranges->min(p) >= ranges->max(p)) continue;
       int predictor = (the_predictor[p] < 0 ? find_best_predictor(images, ranges, p, z) : the_predictor[p]);
       //if (z < 2 && the_predictor < 0) printf("Plane %i, zoomlevel %i: predictor %i\n",p,z,predictor);
       if (the_predictor[p] < 0) metaCoder.write_int(0, MAX_PREDICTOR, predictor);
-      if (endZL == 0) v_printf_tty(2,"\r%i%% done [%i/%i] ENC[%i,%ux%u]  ",(int)(100*pixels_done/pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
+      if (only_plane < 0 && progress.zoomlevel_index && rac_bytes_needed(rac) >= 0)
+          progress.zoomlevel_index->step_started(rac_bytes_needed(rac) - progress.zoomlevel_index->data_start, p, z);
+      if (report) v_printf_tty(2,"\r%i%% done [%i/%i] ENC[%i,%ux%u]  ",(int)(100*progress.pixels_done/progress.pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
       Properties properties((nump>3?NB_PROPERTIESA[p]:NB_PROPERTIES[p]));
       if (z % 2 == 0) {
         // horizontal: scan the odd rows, output pixel values
           for (uint32_t r = 1; r < images[0].rows(z); r += 2) {
-            pixels_done += images[0].cols(z);
-            if (endZL == 0 && (r & 257)==257) v_printf_tty(3,"\r%i%% done [%i/%i] ENC[%i,%ux%u]  ",(int)(100*pixels_done/pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
+            done += images[0].cols(z);
+            if (report && (r & 257)==257) v_printf_tty(3,"\r%i%% done [%i/%i] ENC[%i,%ux%u]  ",(int)(100*progress.pixels_done/progress.pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
+            if (!learn_row(r/2, images[0].rows(z)/2, sample, repeat)) continue;
             for (int fr=0; fr<(int)images.size(); fr++) {
               const Image& image = images[fr];
               if (image.seen_before >= 0) { continue; }
@@ -249,8 +369,9 @@ void flif_encode_FLIF2_inner(IO& io, Rac& rac, std::vector<Coder> &coders, const
       } else {
         // vertical: scan the odd columns
           for (uint32_t r = 0; r < images[0].rows(z); r++) {
-            pixels_done += images[0].cols(z)/2;
-            if (endZL == 0 && (r&513)==513) v_printf_tty(3,"\r%i%% done [%i/%i] ENC[%i,%ux%u]  ",(int)(100*pixels_done/pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
+            done += images[0].cols(z)/2;
+            if (report && (r&513)==513) v_printf_tty(3,"\r%i%% done [%i/%i] ENC[%i,%ux%u]  ",(int)(100*progress.pixels_done/progress.pixels_todo),i,plane_zoomlevels(images[0], beginZL, endZL)-1,p,images[0].cols(z),images[0].rows(z));
+            if (!learn_row(r, images[0].rows(z), sample, repeat)) continue;
             for (int fr=0; fr<(int)images.size(); fr++) {
               const Image& image = images[fr];
               if (image.seen_before >= 0) { continue; }
@@ -277,17 +398,35 @@ void flif_encode_FLIF2_inner(IO& io, Rac& rac, std::vector<Coder> &coders, const
             }
           }
       }
-      if (endZL==0 && io.ftell()>fs) {
+      if (report && io.ftell()>fs) {
           v_printf_tty(3,"    wrote %li bytes    ", io.ftell());
           v_printf_tty(5,"\n");
           fs = io.ftell();
       }
     }
     if (options.chroma_subsampling && nump>1 && endZL==0) metaCoder.write_int(0, nump-1, 1); // pretend to be interrupted right after Co zoomlevel 1 started
+    return plane_pixels_done;
 }
 
 template<typename IO, typename Rac, typename Coder>
-void flif_encode_FLIF2_pass(IO& io, Rac &rac, const Images &images, const ColorRanges *ranges, std::vector<Tree> &forest, const int beginZL, const int endZL, int repeats, flif_options &options) {
+void flif_encode_FLIF2_repeats(IO& io, Rac &rac, std::vector<Coder> &coders, const Images &images, const ColorRanges *ranges, const int beginZL, const int endZL, int repeats, flif_options &options, flif_progress &progress) {
+    const int learn_sample = (std::is_same<Rac, RacDummy>::value ? options.learn_sample : 1);
+    if (options.threads > 1 && std::is_same<Rac, RacDummy>::value) {
+        // learning pass: see flif_encode_scanlines_repeats
+        learn_planes_threaded(images[0].numPlanes(), options.threads, progress, [&](int p) {
+            int64_t done = 0;
+            for (int i = 0; i < repeats; i++) done += flif_encode_FLIF2_inner<IO,Rac,Coder>(io, rac, coders, images, ranges, beginZL, endZL, options, progress, p, learn_sample, i);
+            return done;
+        });
+    } else {
+        for (int i = 0; i < repeats; i++) {
+         flif_encode_FLIF2_inner<IO,Rac,Coder>(io, rac, coders, images, ranges, beginZL, endZL, options, progress, -1, learn_sample, i);
+        }
+    }
+}
+
+template<typename IO, typename Rac, typename Coder>
+void flif_encode_FLIF2_pass(IO& io, Rac &rac, const Images &images, const ColorRanges *ranges, std::vector<Tree> &forest, const int beginZL, const int endZL, int repeats, flif_options &options, flif_progress &progress) {
     std::vector<Coder> coders;
     coders.reserve(ranges->numPlanes());
     for (int p = 0; p < ranges->numPlanes(); p++) {
@@ -303,13 +442,11 @@ void flif_encode_FLIF2_pass(IO& io, Rac &rac, const Images &images, const ColorR
       for (int p = 0; p < images[0].numPlanes(); p++) {
         if (ranges->min(p) < ranges->max(p)) {
             for (const Image& image : images) metaCoder.write_int(ranges->min(p), ranges->max(p), image(p,0,0,0));
-            pixels_done++;
+            progress.pixels_done++;
         }
       }
     }
-    while(repeats-- > 0) {
-     flif_encode_FLIF2_inner<IO,Rac,Coder>(io, rac, coders, images, ranges, beginZL, endZL, options);
-    }
+    flif_encode_FLIF2_repeats<IO,Rac,Coder>(io, rac, coders, images, ranges, beginZL, endZL, repeats, options, progress);
     for (int p = 0; p < images[0].numPlanes(); p++) {
         coders[p].simplify(options.divisor, options.min_size, p);
     }
@@ -550,6 +687,7 @@ void flif_make_lossy_interlaced(Images &images, const ColorRanges * ranges, int
                          end=(1+(image.col_end[r*image.zoom_rowpixelsize(z)]-1)/image.zoom_colpixelsize(z))|1;
               if (begin>1 && ((begin&1) ==0)) begin--;
               if (begin==0) begin=1;
+              if (end > image.cols(z)) end = image.cols(z); // c+1 has to be in the image
               for (uint32_t c = begin; c < end-1; c+=2) {
                     if (adaptive && ((map(0,z,r,c-1) == 255) || (map(0,z,r,c+1)==255))) continue;
                     if (alphazero && p<3 && image(3,z,r,c) == 0) continue;
@@ -678,20 +816,191 @@ template<typename IO, typename BitChance, typename Rac> void flif_encode_tree(FL
         metacoder.write_tree(forest[p]);
     }
 }
+void init_forest_ranges(std::vector<Ranges> &forest_ranges, const ColorRanges *ranges, const flifEncoding encoding) {
+    forest_ranges.assign(ranges->numPlanes(), Ranges());
+    for (int p = 0; p < ranges->numPlanes(); p++) {
+        if (ranges->min(p) >= ranges->max(p)) continue;
+        if (encoding==flifEncoding::nonInterlaced) initPropRanges_scanlines(forest_ranges[p], *ranges, p);
+        else initPropRanges(forest_ranges[p], *ranges, p);
+    }
+}
+
+// Copies the subtree at pos of a pretrained tree to position out_pos in out, leaving out the decisions that subrange
+// already decides (because this image has smaller property ranges than the training images)
+void fit_subtree(const Tree &tree, const uint32_t pos, Ranges &subrange, Tree &out, const uint32_t out_pos) {
+    const PropertyDecisionNode &n = tree[pos];
+    if (n.property == -1) return;
+    const int p = n.property;
+    if (n.splitval >= subrange[p].second) return fit_subtree(tree, n.childID+1, subrange, out, out_pos);
+    if (n.splitval < subrange[p].first) return fit_subtree(tree, n.childID, subrange, out, out_pos);
+    const uint32_t child = out.size();
+    out.push_back(PropertyDecisionNode());
+    out.push_back(PropertyDecisionNode());
+    out[out_pos] = n;
+    out[out_pos].childID = child;
+    const PropertyVal oldmin = subrange[p].first, oldmax = subrange[p].second;
+    subrange[p].first = n.splitval + 1;
+    fit_subtree(tree, n.childID, subrange, out, child);
+    subrange[p].first = oldmin;
+    subrange[p].second = n.splitval;
+    fit_subtree(tree, n.childID+1, subrange, out, child+1);
+    subrange[p].second = oldmax;
+}
+
+// returns false if the pretrained forest can't be used for this image
+bool fit_forest(const ManiacForest &pretrained, std::vector<Tree> &forest, const ColorRanges *ranges, const flifEncoding encoding, const int bits) {
+    std::vector<Ranges> forest_ranges;
+    init_forest_ranges(forest_ranges, ranges, encoding);
+    if (pretrained.encoding != encoding || pretrained.bits != bits || pretrained.trees.size() != forest_ranges.size()) return false;
+    for (size_t p = 0; p < forest_ranges.size(); p++) {
+        if (forest_ranges[p].empty()) continue;
+        if (pretrained.ranges[p].size() != forest_ranges[p].size()) return false;
+        forest[p] = Tree();
+        fit_subtree(pretrained.trees[p], 0, forest_ranges[p], forest[p], 0);
+    }
+    return true;
+}
+
+template <int bits> class ForestLearner : public ManiacForest::Learner {
+public:
+    RacDummy dummy;
+    std::vector<PropertySymbolCoder<FLIFBitChancePass1, RacDummy, bits> > coders;
+    void simplify(int divisor, int min_size) override {
+        for (size_t p = 0; p < coders.size(); p++) coders[p].simplify(divisor, min_size, p);
+    }
+};
+
+// learning pass of a training image: continues learning the trees of the forest
 template <int bits, typename IO>
-void flif_encode_main(RacOut<IO>& rac, IO& io, Images &images, const ColorRanges *ranges, flif_options &options) {
+void flif_learn_forest(IO& io, ManiacForest &forest, Images &images, const ColorRanges *ranges, flif_options &options, flif_progress &progress, const int roughZL) {
+    const flifEncoding encoding = options.method.encoding;
+    std::vector<Ranges> forest_ranges;
+    init_forest_ranges(forest_ranges, ranges, encoding);
+    if (!forest.learner) {
+        forest.encoding = encoding;
+        forest.bits = bits;
+        forest.ranges = forest_ranges;
+        forest.trees.assign(ranges->numPlanes(), Tree());
+        forest.divisor = options.divisor;
+        forest.min_size = options.min_size;
+        std::unique_ptr<ForestLearner<bits> > learner(new ForestLearner<bits>());
+        learner->coders.reserve(ranges->numPlanes());
+        for (int p = 0; p < ranges->numPlanes(); p++)
+            learner->coders.emplace_back(learner->dummy, forest.ranges[p], forest.trees[p], options.split_threshold, options.cutoff, options.alpha);
+        forest.learner = std::move(learner);
+    } else {
+        bool match = (forest.encoding == encoding && forest.bits == bits && forest.ranges.size() == forest_ranges.size());
+        for (size_t p = 0; match && p < forest_ranges.size(); p++) {
+            if (forest_ranges[p].empty()) continue;
+            if (forest.ranges[p].size() != forest_ranges[p].size()) match = false;
+            for (size_t i = 0; match && i < forest_ranges[p].size(); i++)
+                if (forest_ranges[p][i].first < forest.ranges[p][i].first || forest_ranges[p][i].second > forest.ranges[p][i].second) match = false;
+        }
+        if (!match) { e_printf("Warning: image has different planes, bit depth or encoding than the first training image, not learning from it.\n"); return; }
+    }
+    std::vector<PropertySymbolCoder<FLIFBitChancePass1, RacDummy, bits> > &coders = static_cast<ForestLearner<bits>&>(*forest.learner).coders;
+    RacDummy &dummy = static_cast<ForestLearner<bits>&>(*forest.learner).dummy;
+    if (encoding == flifEncoding::nonInterlaced)
+        flif_encode_scanlines_repeats<IO, RacDummy, PropertySymbolCoder<FLIFBitChancePass1, RacDummy, bits> >(io, dummy, coders, images, ranges, options.learn_repeats, options, progress);
+    else
+        flif_encode_FLIF2_repeats<IO, RacDummy, PropertySymbolCoder<FLIFBitChancePass1, RacDummy, bits> >(io, dummy, coders, images, ranges, roughZL, 0, options.learn_repeats, options, progress);
+}
+
+void ManiacForest::finish() {
+    if (!learner) return;
+    learner->simplify(divisor, min_size);
+    learner.reset();
+}
+
+// The forest file is plain text: a header line, then per plane the number of properties, their ranges, and the nodes.
+bool ManiacForest::save(const char *filename) {
+    finish();
+    if (trees.empty()) { e_printf("Error: MANIAC forest has not been trained.\n"); return false; }
+    FILE *f = fopen(filename, "w");
+    if (!f) return false;
+    fprintf(f, "FLIF MANIAC forest 1\n%i %i %i\n", (int)encoding, bits, (int)trees.size());
+    for (size_t p = 0; p < trees.size(); p++) {
+        // only write the nodes that are reachable after simplification, renumbered in the same order
+        Tree tree;
+        Ranges subrange = ranges[p];
+        if (!subrange.empty()) fit_subtree(trees[p], 0, subrange, tree, 0);
+        fprintf(f, "%i %i\n", (int)ranges[p].size(), (int)tree.size());
+        for (const auto &r : ranges[p]) fprintf(f, "%i %i\n", r.first, r.second);
+        for (const auto &n : tree) fprintf(f, "%i %i %i %u\n", n.property, n.count, n.splitval, n.childID);
+    }
+    return !fclose(f);
+}
+
+bool ManiacForest::load(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (!f) return false;
+    int version = 0, enc = 0, nb_planes = 0;
+    bool ok = (fscanf(f, "FLIF MANIAC forest %i %i %i %i", &version, &enc, &bits, &nb_planes) == 4 && version == 1
+               && (enc == (int)flifEncoding::nonInterlaced || enc == (int)flifEncoding::interlaced) && nb_planes > 0 && nb_planes <= 5);
+    encoding = (flifEncoding) enc;
+    learner.reset();
+    trees.assign(ok ? nb_planes : 0, Tree());
+    ranges.assign(ok ? nb_planes : 0, Ranges());
+    for (int p = 0; ok && p < nb_planes; p++) {
+        int nb_properties = 0, nb_nodes = 0;
+        ok = (fscanf(f, "%i %i", &nb_properties, &nb_nodes) == 2 && nb_properties >= 0 && nb_properties < 128 && nb_nodes >= 1);
+        for (int i = 0; ok && i < nb_properties; i++) {
+            int min, max;
+            ok = (fscanf(f, "%i %i", &min, &max) == 2 && min <= max);
+            ranges[p].push_back(std::make_pair(min, max));
+        }
+        if (ok) trees[p].resize(nb_nodes);
+        for (int i = 0; ok && i < nb_nodes; i++) {
+            int property, count, splitval;
+            unsigned int childID;
+            ok = (fscanf(f, "%i %i %i %u", &property, &count, &splitval, &childID) == 4
+                  && property >= -1 && property < nb_properties
+                  && (property == -1 || (childID > (unsigned int)i && childID + 1 < (unsigned int)nb_nodes
+                                         && count >= CONTEXT_TREE_MIN_COUNT && count <= CONTEXT_TREE_MAX_COUNT)));
+            trees[p][i] = PropertyDecisionNode(property, splitval, childID);
+            trees[p][i].count = count;
+        }
+    }
+    fclose(f);
+    if (!ok) { e_printf("Error: could not read MANIAC forest from %s\n", filename); trees.clear(); ranges.clear(); }
+    return ok;
+}
+
+// with plane streams, the main stream ends before them (a rANS stream ends where its last block does)
+template <typename IO> void close_main_stream(RacOut<IO> &rac) { rac.close(); }
+template <typename IO> void close_main_stream(RansOutput<IO> &rans) { rans.flush(); }
+
+// the plane streams are coded like the main stream
+template <typename Rac> struct PlaneStreamOutput;
+template <typename IO> struct PlaneStreamOutput<RacOut<IO>> { typedef RacOut<BlobIO> type; };
+template <typename IO> struct PlaneStreamOutput<RansOutput<IO>> { typedef RansOutput<BlobIO> type; };
+
+template <int bits, typename IO, typename Rac>
+void flif_encode_main(Rac& rac, IO& io, Images &images, const ColorRanges *ranges, const flif_options &caller_options, ZoomlevelIndex *zoomlevel_index, const bool plane_streams) {
+    // the thresholds are scaled and cleared below, which must not leak into the caller's (e.g. a library encoder's) options
+    flif_options options = caller_options;
 
     flifEncoding encoding = options.method.encoding;
     int learn_repeats = options.learn_repeats;
+    // use the trees of a pretrained forest instead of learning them
+    std::vector<Tree> pretrained(ranges->numPlanes(), Tree());
+    const bool training = options.train_forest;
+    const bool use_forest = options.forest && !training && fit_forest(*options.forest, pretrained, ranges, encoding, bits);
+    if (options.forest && !training && !use_forest) v_printf(2,"MANIAC forest does not fit this image, learning a new tree.\n");
+    if (use_forest) learn_repeats = 0;
+    const int passes = learn_repeats + (training ? 0 : 1);
     Image& image=images[0];
     int realnumplanes = 0;
     for (int i=0; i<ranges->numPlanes(); i++) if (ranges->min(i)<ranges->max(i)) realnumplanes++;
-    pixels_todo = (int64_t)image.rows()*image.cols()*realnumplanes*(learn_repeats+1);
+    flif_progress progress;
+    progress.pixels_todo = (int64_t)image.rows()*image.cols()*realnumplanes*passes;
     for (int i=1; i<ranges->numPlanes(); i++)
         if (options.chroma_subsampling && ranges->min(i)<ranges->max(i))
-            pixels_todo -= (image.rows()*image.cols()-image.rows(2)*image.cols(2))*(learn_repeats+1);
-    pixels_done = 0;
-    if (pixels_todo == 0) pixels_todo = pixels_done = 1;
+            progress.pixels_todo -= (image.rows()*image.cols()-image.rows(2)*image.cols(2))*passes;
+    progress.pixels_done = 0;
+    if (progress.pixels_todo == 0) progress.pixels_todo = progress.pixels_done = 1;
+    progress.zoomlevel_index = zoomlevel_index;
+    for (Image& image : images) image.advise_mapped_planes(encoding == flifEncoding::interlaced);
 
     // two passes
     std::vector<Tree> forest(ranges->numPlanes(), Tree());
@@ -705,19 +1014,33 @@ void flif_encode_main(RacOut<IO>& rac, IO& io, Images &images, const ColorRanges
       roughZL = image.zooms() - NB_NOLEARN_ZOOMS-1;
       if (roughZL < 0) roughZL = 0;
       //v_printf(2,"Encoding rough data\n");
-      UniformSymbolCoder<RacOut<IO>> metaCoder(rac);
+      UniformSymbolCoder<Rac> metaCoder(rac);
       metaCoder.write_int(0,image.zooms(),roughZL);
-      flif_encode_FLIF2_pass<IO, RacOut<IO>, FinalPropertySymbolCoder<FLIFBitChancePass2, RacOut<IO>, bits> >(io, rac, images, ranges, forest, image.zooms(), roughZL+1, 1, options);
+      flif_encode_FLIF2_pass<IO, Rac, FinalPropertySymbolCoder<FLIFBitChancePass2, Rac, bits> >(io, rac, images, ranges, forest, image.zooms(), roughZL+1, 1, options, progress);
     }
 
     //v_printf(2,"Encoding data (pass 1)\n");
     if (learn_repeats>0) v_printf(3,"Learning a MANIAC tree. Iterating %i time%s.\n",learn_repeats,(learn_repeats>1?"s":""));
-    switch(encoding) {
+    if (learn_repeats>0 && options.learn_sample>1) {
+        // the trees only see about one in learn_sample pixels, so scale down the thresholds that count pixels or bits
+        // (the split threshold by less, since the gains are estimated from fewer pixels)
+        v_printf(3,"Learning from one in %i bands of %i rows.\n",options.learn_sample,LEARN_SAMPLE_BAND);
+        options.split_threshold = options.split_threshold * 2 / (options.learn_sample + 1);
+        options.divisor = std::max(1, options.divisor / options.learn_sample);
+        options.min_size /= options.learn_sample;
+    }
+    if (training) {
+        flif_learn_forest<bits>(io, *options.forest, images, ranges, options, progress, roughZL);
+        v_printf_tty(3,"\r");
+        return;
+    }
+    if (use_forest) forest = pretrained;
+    else switch(encoding) {
         case flifEncoding::nonInterlaced:
-           flif_encode_scanlines_pass<IO, RacDummy, PropertySymbolCoder<FLIFBitChancePass1, RacDummy, bits> >(io, dummy, images, ranges, forest, learn_repeats, options);
+           flif_encode_scanlines_pass<IO, RacDummy, PropertySymbolCoder<FLIFBitChancePass1, RacDummy, bits> >(io, dummy, images, ranges, forest, learn_repeats, options, progress);
            break;
         case flifEncoding::interlaced:
-           flif_encode_FLIF2_pass<IO, RacDummy, PropertySymbolCoder<FLIFBitChancePass1, RacDummy, bits> >(io, dummy, images, ranges, forest, roughZL, 0, learn_repeats, options);
+           flif_encode_FLIF2_pass<IO, RacDummy, PropertySymbolCoder<FLIFBitChancePass1, RacDummy, bits> >(io, dummy, images, ranges, forest, roughZL, 0, learn_repeats, options, progress);
            break;
     }
     v_printf_tty(3,"\r");
@@ -727,7 +1050,7 @@ void flif_encode_main(RacOut<IO>& rac, IO& io, Images &images, const ColorRanges
 
     //v_printf(2,"Encoding tree\n");
     fs = io.ftell();
-    flif_encode_tree<IO, FLIFBitChanceTree, RacOut<IO>>(io, rac, ranges, forest, encoding);
+    flif_encode_tree<IO, FLIFBitChanceTree, Rac>(io, rac, ranges, forest, encoding);
     v_printf(3," MANIAC tree: %li bytes.\n", io.ftell()-fs);
     options.divisor=0;
     options.min_size=0;
@@ -735,26 +1058,52 @@ void flif_encode_main(RacOut<IO>& rac, IO& io, Images &images, const ColorRanges
     //v_printf(2,"Encoding data (pass 2)\n");
     switch(encoding) {
         case flifEncoding::nonInterlaced:
-           flif_encode_scanlines_pass<IO, RacOut<IO>, FinalPropertySymbolCoder<FLIFBitChancePass2, RacOut<IO>, bits> >(io, rac, images, ranges, forest, 1, options);
+           if (plane_streams) {
+             close_main_stream(rac);
+             typedef typename PlaneStreamOutput<Rac>::type PlaneRac;
+             flif_encode_scanlines_plane_streams<IO, PlaneRac, FinalPropertySymbolCoder<FLIFBitChancePass2, PlaneRac, bits> >(io, images, ranges, forest, options, progress);
+           } else
+           flif_encode_scanlines_pass<IO, Rac, FinalPropertySymbolCoder<FLIFBitChancePass2, Rac, bits> >(io, rac, images, ranges, forest, 1, options, progress);
            break;
         case flifEncoding::interlaced:
-           flif_encode_FLIF2_pass<IO, RacOut<IO>, FinalPropertySymbolCoder<FLIFBitChancePass2, RacOut<IO>, bits> >(io, rac, images, ranges, forest, roughZL, 0, 1, options);
+           flif_encode_FLIF2_pass<IO, Rac, FinalPropertySymbolCoder<FLIFBitChancePass2, Rac, bits> >(io, rac, images, ranges, forest, roughZL, 0, 1, options, progress);
            break;
     }
 
 }
 
-template <typename IO>
-void write_big_endian_varint(IO& io, unsigned long number, bool done = true) {
-    if (number < 128) {
-        if (done) io.fputc(number);
-        else io.fputc(number + 128);
+template <typename IO, typename Rac>
+void flif_encode_data(Rac& rac, IO& io, Images &images, const ColorRanges *ranges, flif_options &options, int bits, uint32_t checksum, ZoomlevelIndex *zoomlevel_index, const bool plane_streams) {
+    auto write_checksum = [&] () {
+      UniformSymbolCoder<Rac> metaCoder(rac);
+      // (with plane streams, the file size isn't known yet, so the checksum is written even for tiny images)
+      if (options.crc_check && !options.loss && (options.crc_check>0 || plane_streams || io.ftell() > 100) && !options.chroma_subsampling) {
+        v_printf(2,"Writing checksum: %X\n", checksum);
+        metaCoder.write_int(0,1,1);
+        metaCoder.write_int(16, (checksum >> 16) & 0xFFFF);
+        metaCoder.write_int(16, checksum & 0xFFFF);
+      } else {
+        v_printf(2,"Not writing checksum\n");
+        metaCoder.write_int(0,1,0); // don't write checksum for tiny images or when asked not to
+      }
+    };
+    // the plane streams come after the main range coder, so the checksum has to be written before the MANIAC trees
+    if (plane_streams) write_checksum();
+
+    if (bits ==10) {
+      flif_encode_main<10>(rac, io, images, ranges, options, zoomlevel_index, plane_streams);
+#ifdef SUPPORT_HDR
     } else {
-        unsigned long lsb = (number & 127);
-        number >>= 7;
-        write_big_endian_varint(io, number, false);
-        write_big_endian_varint(io, lsb, done);
+      flif_encode_main<18>(rac, io, images, ranges, options, zoomlevel_index, plane_streams);
+#endif
     }
+
+    if (!plane_streams) {
+      write_checksum();
+      rac.flush();
+    }
+    // the last step ends where the range coder does
+    if (zoomlevel_index) zoomlevel_index->finish(io.ftell() - zoomlevel_index->data_start);
 }
 
 template <typename IO>
@@ -769,9 +1118,76 @@ void write_chunk(IO& io, MetaData& metadata) {
     }
 }
 
+// Tiled images: the image is cut into tiles of tile_size x tile_size pixels (smaller at the right and bottom edge),
+// which are encoded on options.threads threads as separate FLIF files, each with its own transforms, MANIAC trees
+// and range coder. The "Tile" chunk has the tile width and height, the maximum channel value and the length of every
+// tile (row by row); the tiles follow back to back after the end of the header.
+template <typename IO>
+bool flif_encode_tiles(IO& io, const Image &image, const std::vector<std::string> &transDesc, const flif_options &options) {
+    const uint32_t tile_size = options.tile_size;
+    const uint32_t tiles_x = (image.cols() - 1) / tile_size + 1;
+    const uint32_t tiles_y = (image.rows() - 1) / tile_size + 1;
+    const size_t num_tiles = (size_t)tiles_x * tiles_y;
+    v_printf(2," (%ux%u, %u tiles of %ux%u)\n", image.cols(), image.rows(), (unsigned)num_tiles, tile_size, tile_size);
+
+    std::vector<std::unique_ptr<uint8_t[]>> tiles(num_tiles);
+    std::vector<size_t> lengths(num_tiles);
+    std::atomic<size_t> next_tile(0);
+    std::atomic<bool> ok(true);
+    auto worker = [&]() {
+        size_t i;
+        while (ok && (i = next_tile++) < num_tiles) {
+            const uint32_t r = (i / tiles_x) * tile_size;
+            const uint32_t c = (i % tiles_x) * tile_size;
+            try {
+                Images tile_images;
+                tile_images.push_back(image.crop(r, c, std::min<uint32_t>(tile_size, image.cols() - c), std::min<uint32_t>(tile_size, image.rows() - r)));
+                flif_options tile_options = options;
+                tile_options.tile_size = 0;
+                tile_options.zoomlevel_index = 0;
+                // threads that are left over learn the trees of the planes of a tile
+                tile_options.threads = std::max(1, options.threads / (int)std::min(num_tiles, (size_t)options.threads));
+                BlobIO blob;
+                if (!flif_encode(blob, tile_images, transDesc, tile_options)) ok = false;
+                else tiles[i].reset(blob.release(&lengths[i]));
+            } catch (std::bad_alloc& ba) {
+                ok = false;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < std::min((size_t)options.threads, num_tiles); t++) pool.emplace_back(worker);
+    worker();
+    for (std::thread &t : pool) t.join();
+    if (!ok) { e_printf("Error: could not encode the tiles of the image.\n"); return false; }
+
+    BlobIO table;
+    write_big_endian_varint(table, tile_size);
+    write_big_endian_varint(table, tile_size);
+    ColorVal maxmax = 0;
+    for (int p = 0; p < image.numPlanes(); p++) maxmax = std::max(maxmax, image.max(p));
+    write_big_endian_varint(table, maxmax);
+    for (size_t length : lengths) write_big_endian_varint(table, length);
+    MetaData chunk;
+    strcpy(chunk.name, "Tile");
+    uint8_t *contents = table.release(&chunk.length);
+    chunk.contents.assign(contents, contents + chunk.length);
+    delete [] contents;
+    write_chunk(io, chunk);
+
+    // end of the header
+    io.fputc(0);
+    for (size_t i = 0; i < num_tiles; i++) io.write_block(tiles[i].get(), lengths[i]);
+    io.flush();
+
+    v_printf_tty(2,"\r");
+    v_printf(2,"Wrote output FLIF file %s, %li bytes for %ux%u pixels (%.4fbpp)   \n",io.getName(),io.ftell(), image.cols(), image.rows(), 8.0*io.ftell()/image.rows()/image.cols());
+    return true;
+}
+
 
 template <typename IO>
-bool flif_encode(IO& io, Images &images, const std::vector<std::string> &transDesc, flif_options &options) {
+bool flif_encode_image(IO& io, Images &images, const std::vector<std::string> &transDesc, flif_options &options, ZoomlevelIndex *zoomlevel_index) {
 
     flifEncoding encoding = options.method.encoding;
 
@@ -783,6 +1199,10 @@ bool flif_encode(IO& io, Images &images, const std::vector<std::string> &transDe
         return false;
     }
 #endif
+    if (options.plane_streams && encoding != flifEncoding::nonInterlaced) {
+        e_printf("Separate plane streams are only possible in non-interlaced images.\n");
+        return false;
+    }
 
     bool adaptive = (options.loss<0);
     Image adaptive_map;
@@ -811,9 +1231,10 @@ bool flif_encode(IO& io, Images &images, const std::vector<std::string> &transDe
     //              0 0 1 1   = RGB (3 planes)
     //              0 1 0 0   = RGBA (4 planes)       (grayscale + alpha is encoded as RGBA to keep the number of cases low)
     //   0                    = MANIAC trees with default context properties
-    //   1                    = (not yet implemented; could be used for other entropy coding methods)
+    //   1                    = MANIAC trees, pixel data and checksum are coded with rANS instead of the range coder
     int c=' '+16*(static_cast<uint8_t>(encoding))+numPlanes;
     if (numFrames>1) c += 32;
+    if (options.rans) c += 128;
     io.fputc(c);
 
     // next byte (byte 6) encodes the bit depth:
@@ -840,8 +1261,30 @@ bool flif_encode(IO& io, Images &images, const std::vector<std::string> &transDe
             v_printf(3,"Encoded metadata chunk: %s\n",images[0].metadata[i].name);
     }
 
+    // images that don't fit in a single tile (but not animations) can be encoded as independent tiles
+    if (options.tile_size > 0 && numFrames == 1 && !adaptive && !options.just_add_loss && !options.train_forest
+        && (image.cols() > (uint32_t)options.tile_size || image.rows() > (uint32_t)options.tile_size)) {
+        return flif_encode_tiles(io, image, transDesc, options);
+    }
+
+    // separate plane streams are signalled with an empty "Plns" chunk
+    const bool plane_streams = options.plane_streams && !options.train_forest;
+    if (options.plane_streams && !plane_streams) v_printf(2,"Separate plane streams are not used with a trained forest.\n");
+    if (plane_streams) {
+        MetaData chunk;
+        strcpy(chunk.name, "Plns");
+        chunk.length = 0;
+        write_chunk(io, chunk);
+    }
+    // a decoder can only stop cleanly between steps when they come in the default order
+    if (zoomlevel_index && (encoding != flifEncoding::interlaced || options.rans || options.train_forest || options.chroma_subsampling || options.just_add_loss)) {
+        v_printf(2,"A zoomlevel index is only made for interlaced images without rANS or chroma subsampling.\n");
+        zoomlevel_index = nullptr;
+    }
+
     // marker to indicate FLIF version (version 0 aka FLIF16 in this case)
     io.fputc(0);
+    if (zoomlevel_index) zoomlevel_index->data_start = io.ftell();
 
 
     RacOut<IO> rac(io);
@@ -901,8 +1344,13 @@ bool flif_encode(IO& io, Images &images, const std::vector<std::string> &transDe
     std::vector<std::unique_ptr<Transform<IO>>> transforms;
 
     int warn_about_incompatibility = 0;
+    // a forest is trained on the ranges of the color space rather than those of the training images,
+    // so that it fits every image that is encoded with it later
+    const bool training = options.train_forest;
     try {
       for (unsigned int i=0; i<transDesc.size(); i++) {
+        if (training && (transDesc[i] == "Channel_Compact" || transDesc[i] == "Bounds" || transDesc[i] == "Palette_Alpha"
+                         || transDesc[i] == "Palette" || transDesc[i] == "Color_Buckets")) continue;
         auto trans = create_transform<IO>(transDesc[i]);
         auto previous_range = rangesList.back().get();
         if (transDesc[i] == "Palette" || transDesc[i] == "Palette_Alpha") trans->configure(options.palette_size);
@@ -960,6 +1408,10 @@ bool flif_encode(IO& io, Images &images, const std::vector<std::string> &transDe
 #endif
     if (mbits > bits) { e_printf("OOPS: this FLIF only supports 8-bit RGBA (not compiled with SUPPORT_HDR)\n"); return false;}
 
+    // imported planes that a transform wrote to have a copy of their own by now, which takes the place of the view;
+    // the others keep reading the input (the prediction code reads both)
+    for (Image& i : images) i.release_view_copies();
+
     if (alphazero && ranges->numPlanes() > 3 && ranges->min(3) <= 0) {
       v_printf(4,"Replacing fully transparent subpixels with predicted subpixel values\n");
       switch(encoding) {
@@ -1035,24 +1487,14 @@ bool flif_encode(IO& io, Images &images, const std::vector<std::string> &transDe
     }
 
 
-    if (bits ==10) {
-      flif_encode_main<10>(rac, io, images, ranges, options);
-#ifdef SUPPORT_HDR
+    if (options.rans) {
+      // the MANIAC trees, pixel data and checksum follow as a separate rANS stream
+      rac.close();
+      RansOutput<IO> rans(io);
+      flif_encode_data(rans, io, images, ranges, options, bits, checksum, nullptr, plane_streams);
     } else {
-      flif_encode_main<18>(rac, io, images, ranges, options);
-#endif
+      flif_encode_data(rac, io, images, ranges, options, bits, checksum, zoomlevel_index, plane_streams);
     }
-
-    if (options.crc_check && !options.loss && (options.crc_check>0 || io.ftell() > 100) && !options.chroma_subsampling) {
-      v_printf(2,"Writing checksum: %X\n", checksum);
-      metaCoder.write_int(0,1,1);
-      metaCoder.write_int(16, (checksum >> 16) & 0xFFFF);
-      metaCoder.write_int(16, checksum & 0xFFFF);
-    } else {
-      v_printf(2,"Not writing checksum\n");
-      metaCoder.write_int(0,1,0); // don't write checksum for tiny images or when asked not to
-    }
-    rac.flush();
     io.flush();
 
     v_printf_tty(2,"\r");
@@ -1066,6 +1508,61 @@ bool flif_encode(IO& io, Images &images, const std::vector<std::string> &transDe
     return true;
 }
 
+// With options.zoomlevel_index, the file gets a "zIdx" chunk with the byte offset at which every plane/zoomlevel step
+// of the interlaced pixel data is complete, so a partial file for a given scale can be fetched with one range request.
+// The offsets are only known after encoding, so the image is encoded in memory and the chunk is inserted at the end
+// of the header. The chunk has the number of steps, and for every step its plane, its zoomlevel and the number of
+// bytes since the previous step (the first one counted from the end of the header).
+template <typename IO>
+bool flif_encode(IO& io, Images &images, const std::vector<std::string> &transDesc, flif_options &options) {
+    VerbosityScope verbose(options.verbosity);
+    // an empty forest has no trees to encode with, and a finished one can't learn more
+    if (options.train_forest && (!options.forest || options.forest->trained())) {
+        e_printf("Error: training needs a MANIAC forest that is not finished.\n");
+        return false;
+    }
+    if (options.forest && !options.train_forest && !options.forest->trained()) {
+        e_printf("Error: MANIAC forest has not been trained.\n");
+        return false;
+    }
+    if (!options.zoomlevel_index) return flif_encode_image(io, images, transDesc, options, nullptr);
+
+    ZoomlevelIndex index;
+    BlobIO blob;
+    if (!flif_encode_image(blob, images, transDesc, options, &index)) return false;
+    size_t length;
+    std::unique_ptr<uint8_t[]> data(blob.release(&length));
+    if (index.data_start < 0) {
+        io.write_block(data.get(), length);
+        io.flush();
+        return true;
+    }
+
+    BlobIO table;
+    write_big_endian_varint(table, index.steps.size());
+    uint64_t previous = 0;
+    for (const ZoomlevelOffset &step : index.steps) {
+        write_big_endian_varint(table, step.plane);
+        write_big_endian_varint(table, step.zoomlevel);
+        write_big_endian_varint(table, step.end - previous);
+        previous = step.end;
+    }
+    MetaData chunk;
+    strcpy(chunk.name, "zIdx");
+    uint8_t *contents = table.release(&chunk.length);
+    chunk.contents.assign(contents, contents + chunk.length);
+    delete [] contents;
+
+    // the header up to its end marker, the chunk, and then the marker and the image data
+    const size_t header = index.data_start - 1;
+    io.write_block(data.get(), header);
+    write_chunk(io, chunk);
+    io.write_block(data.get() + header, length - header);
+    io.flush();
+    v_printf(2,"Zoomlevel index: %u steps, %lu bytes\n", (unsigned)index.steps.size(), (unsigned long)chunk.length);
+    return true;
+}
+
 
 template bool flif_encode(FileIO& io, Images &images, const std::vector<std::string> &transDesc, flif_options &options);
 template bool flif_encode(BlobIO& io, Images &images, const std::vector<std::string> &transDesc, flif_options &options);
@@ -4,6 +4,35 @@
 #include "transform/factory.hpp"
 #include "common.hpp"
 
+#include <memory>
+
+// MANIAC trees (one per plane) learned from a set of similar images, to encode other images without a learning pass.
+// Training: encode every training image with options.forest pointing to the forest (nothing useful is written then),
+// and finally call finish() or save(). Encoding with a finished forest uses it instead of learning new trees, as long
+// as the image has the same planes and properties as the training images; the trees are still written to the file.
+class ManiacForest {
+public:
+    class Learner {
+    public:
+        virtual void simplify(int divisor, int min_size) = 0;
+        virtual ~Learner() {}
+    };
+
+    flifEncoding encoding;
+    int bits;
+    std::vector<Tree> trees;
+    std::vector<Ranges> ranges;         // the property ranges the trees were learned for, per plane (empty: plane not used)
+    std::unique_ptr<Learner> learner;   // the learning coders, while training
+    int divisor, min_size;              // for simplifying the trees when training is finished
+
+    ManiacForest() : encoding(flifEncoding::interlaced), bits(0), divisor(CONTEXT_TREE_COUNT_DIV), min_size(CONTEXT_TREE_MIN_SUBTREE_SIZE) {}
+
+    bool trained() const { return !learner && !trees.empty(); }
+    void finish();
+    bool save(const char *filename);    // finishes training first
+    bool load(const char *filename);
+};
+
 template <typename IO>
 bool flif_encode(IO& io, Images &images, const std::vector<std::string> &transDesc, flif_options &options);
 
@@ -37,10 +37,6 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #undef  GDK_PIXBUF_ENABLE_BACKEND
 
-#if (_XOPEN_SOURCE >= 700 || _POSIX_C_SOURCE >= 200809L)
-    #define HAVE_OPEN_MEMSTREAM
-#endif
-
 /* Progressive loader context */
 typedef struct {
         GdkPixbufModuleSizeFunc size_func;
@@ -55,13 +51,13 @@ typedef struct {
         gpointer user_data;
         GdkPixbuf *pixbuf;
         gboolean got_header;
+        gboolean prepared;
+        gboolean updated;
         GError **error;
 
-        FILE *increment_buffer;
-#ifdef HAVE_OPEN_MEMSTREAM
-        char *increment_buffer_ptr;
-        size_t increment_buffer_size;
-#endif
+        /* the increments are fed to the decoder as they come in */
+        FLIF_DECODER *decoder;
+        int32_t status;
 
 } FLIFContext;
 
@@ -146,9 +142,74 @@ static GdkPixbuf *gdk_pixbuf__flif_image_load (FILE *f, GError **error) {
 }
 
 
+/* Copies a (partially) decoded image to the pixbuf, which is made the first time */
+static gboolean flif_copy_to_pixbuf (FLIFContext *context, FLIF_IMAGE *image) {
+    gint32 w = flif_image_get_width(image);
+    gint32 h = flif_image_get_height(image);
+
+    if (!context->pixbuf) {
+        context->pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, w, h);
+        if (!context->pixbuf)
+            return FALSE;
+    }
+    if (gdk_pixbuf_get_width(context->pixbuf) != w || gdk_pixbuf_get_height(context->pixbuf) != h)
+        return FALSE;
+
+    gint32 rowstride = gdk_pixbuf_get_rowstride(context->pixbuf);
+    guchar *rowpointer = gdk_pixbuf_get_pixels(context->pixbuf);
+    for (uint32_t row = 0; row < (uint32_t)h; row++) {
+        flif_image_read_row_RGBA8(image, row, rowpointer, w * 4);
+        rowpointer += rowstride;
+    }
+    context->updated = TRUE;
+    return TRUE;
+}
+
+/* Progressive previews: called by the decoder during flif_decoder_feed, as the zoomlevels come in */
+static uint32_t flif_preview_callback (uint32_t quality, int64_t bytes_read, uint8_t decode_over, void *user_data, void *flif_context) {
+    FLIFContext *context = (FLIFContext *) user_data;
+
+    flif_decoder_generate_preview(flif_context);
+    FLIF_IMAGE *image = flif_decoder_get_image(context->decoder, 0);
+    if (image)
+        flif_copy_to_pixbuf(context, image);
+
+    return quality + 1000;
+}
+
+/* Tells the application about new pixels in the pixbuf (from the thread that feeds the loader) */
+static void flif_notify (FLIFContext *context) {
+    if (!context->pixbuf || !context->updated)
+        return;
+
+    if (!context->prepared && context->prepare_func) {
+        (* context->prepare_func) (context->pixbuf, NULL, context->user_data);
+    }
+    context->prepared = TRUE;
+
+    if (context->update_func) {
+        (* context->update_func) (context->pixbuf, 0, 0, gdk_pixbuf_get_width(context->pixbuf), gdk_pixbuf_get_height(context->pixbuf), context->user_data);
+    }
+    context->updated = FALSE;
+}
+
+/* Takes the final image once the decoder is done */
+static gboolean flif_finish (FLIFContext *context, GError **error) {
+    FLIF_IMAGE *image = (context->status == FLIF_FEED_DONE ? flif_decoder_get_image(context->decoder, 0) : NULL);
+
+    if (!image || !flif_copy_to_pixbuf(context, image)) {
+        g_set_error (error,
+            GDK_PIXBUF_ERROR,
+            GDK_PIXBUF_ERROR_CORRUPT_IMAGE,
+            "Failed to decode image");
+        return FALSE;
+    }
+    return TRUE;
+}
+
 static gpointer gdk_pixbuf__flif_image_begin_load (GdkPixbufModuleSizeFunc size_func, GdkPixbufModulePreparedFunc prepare_func,
                                    GdkPixbufModuleUpdatedFunc update_func, gpointer user_data, GError **error) {
-    FLIFContext *context = g_new(FLIFContext, 1);
+    FLIFContext *context = g_new0(FLIFContext, 1);
     context->size_func = size_func;
     context->prepare_func = prepare_func;
     context->update_func  = update_func;
@@ -156,17 +217,17 @@ static gpointer gdk_pixbuf__flif_image_begin_load (GdkPixbufModuleSizeFunc size_
     context->error = error;
     context->got_header = FALSE;
 
-#ifdef HAVE_OPEN_MEMSTREAM
-    context->increment_buffer = open_memstream(&context->increment_buffer_ptr, &context->increment_buffer_size);
-#else
-    context->increment_buffer = tmpfile();
-#endif
-
-    if (!context->increment_buffer){
-        perror("Cannot create increment buffer.");
+    context->decoder = flif_create_decoder();
+    if (!context->decoder) {
+        g_set_error (error,
+            GDK_PIXBUF_ERROR,
+            GDK_PIXBUF_ERROR_FAILED,
+            "Cannot create FLIF decoder.");
         g_free(context);
         return NULL;
     }
+    flif_decoder_set_callback(context->decoder, flif_preview_callback, context);
+    context->status = FLIF_FEED_NEED_MORE;
 
     return context;
 }
@@ -174,69 +235,28 @@ static gpointer gdk_pixbuf__flif_image_begin_load (GdkPixbufModuleSizeFunc size_
 static gboolean gdk_pixbuf__flif_image_stop_load (gpointer user_context, GError **error) {
 
     FLIFContext *context = (FLIFContext *) user_context;
-
-    int status = fflush(context->increment_buffer);
-    status |= fseek(context->increment_buffer, 0L, SEEK_SET);
-
-    if (status != 0){
-        perror("Cannot flush and rewind increment buffer.");
-        fclose(context->increment_buffer);
-#ifdef HAVE_OPEN_MEMSTREAM
-        // we don't use g_free here because open_memstream uses the internal malloc from stdlib.h
-        free(context->increment_buffer_ptr);
-#endif
-        g_free(context);
-        return FALSE;
-    }
-
-    context->pixbuf = gdk_pixbuf__flif_image_load(context->increment_buffer, error);
-
-    if (context->prepare_func) {
-        (* context->prepare_func) (context->pixbuf, NULL, context->user_data);
-    }
-
-    if (context->update_func) {
-        (* context->update_func) (context->pixbuf, 0, 0, context->w, context->h, context->user_data);
+    gboolean ok = TRUE;
+
+    // the input ends here: finish decoding what has been fed (a partial file gives a partial image)
+    if (context->status != FLIF_FEED_DONE) {
+        if (context->status == FLIF_FEED_NEED_MORE)
+            context->status = flif_decoder_end_feed(context->decoder);
+        ok = flif_finish(context, error);
+        flif_notify(context);
     }
 
-    fclose(context->increment_buffer);
-
-#ifdef HAVE_OPEN_MEMSTREAM
-    // we don't use g_free here because open_memstream uses the internal malloc from stdlib.h
-    free(context->increment_buffer_ptr);
-#endif
-
-    g_object_unref(context->pixbuf);
+    flif_destroy_decoder(context->decoder);
+    if (context->pixbuf)
+        g_object_unref(context->pixbuf);
     g_free(context);
 
-    return TRUE;
+    return ok;
 }
 
 static gboolean gdk_pixbuf__flif_image_load_increment (gpointer user_context, const guchar *buf, guint size, GError **error) {
         
     FLIFContext *context = (FLIFContext *) user_context;
 
-    int status = fwrite(buf, size, sizeof(guchar), context->increment_buffer);
-
-    if (status != sizeof(guchar)){
-        g_set_error(error,
-            GDK_PIXBUF_ERROR,
-            GDK_PIXBUF_ERROR_FAILED,
-            "Can't write to increment buffer.");
-        return FALSE;
-    }
-
-    status = fflush(context->increment_buffer);
-    
-    if (status != 0){
-        g_set_error(error,
-            GDK_PIXBUF_ERROR,
-            GDK_PIXBUF_ERROR_FAILED,
-            "Can't flush the increment buffer.");
-        return FALSE;
-    }
-
-
     if (!context->got_header) {
         
         FLIF_INFO* flif_info = flif_read_info_from_memory(buf, size);
@@ -270,6 +290,21 @@ static gboolean gdk_pixbuf__flif_image_load_increment (gpointer user_context, co
         }
         
     }
+
+    // decode as far as the data goes; anything after the end of the image is ignored
+    if (context->status == FLIF_FEED_NEED_MORE) {
+        context->status = flif_decoder_feed(context->decoder, buf, size);
+        if (context->status == FLIF_FEED_ERROR) {
+            g_set_error (error,
+                GDK_PIXBUF_ERROR,
+                GDK_PIXBUF_ERROR_CORRUPT_IMAGE,
+                "Failed to decode image");
+            return FALSE;
+        }
+        if (context->status == FLIF_FEED_DONE && !flif_finish(context, error))
+            return FALSE;
+        flif_notify(context);
+    }
     return TRUE;
 }
 
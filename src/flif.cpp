@@ -82,6 +82,8 @@ void show_help(int mode) {
     v_printf(2,"   -p, --no-color-profile      strip ICC color profile (default is to keep it)\n");
     v_printf(2,"   -o, --overwrite             overwrite existing files\n");
     v_printf(2,"   -k, --keep-palette          use input PNG palette / write palette PNG if possible\n");
+    v_printf(2,"   -O, --out-of-core=N         keep at most N MB of pixels in RAM, the rest in temporary files (in $TMPDIR)\n");
+    v_printf(2,"   -j, --threads=N             use N threads (for tiles and plane streams, to learn MANIAC trees); default: -j1\n");
 #ifdef HAS_ENCODER
     if (mode != 1) {
     v_printf(1,"Encode options: (-e, --encode)\n");
@@ -102,6 +104,12 @@ void show_help(int mode) {
     v_printf(2,"   -S, --no-frame-shape        disable Frame_Shape transform\n");
     v_printf(2,"   -L, --max-frame-lookback=N  max nb of frames for Frame_Lookback; default: -L1\n");
     v_printf(2,"   -R, --maniac-repeats=N      MANIAC learning iterations; default: -R%i\n",TREE_LEARN_REPEATS);
+    v_printf(2,"   -g, --tile-size=N           encode large images as independent tiles of NxN pixels (encoded/decoded in parallel with -j)\n");
+    v_printf(2,"   -z, --plane-streams         non-interlaced, with a separate stream per plane (encoded/decoded in parallel with -j)\n");
+    v_printf(2,"   -u, --zoomlevel-index       add the byte offsets of the zoomlevels, to fetch a partial file for a given scale\n");
+    v_printf(2,"   -l, --maniac-sample=N       MANIAC learning on one in N bands of rows (faster); default: -l1\n");
+    v_printf(2,"   -y, --train-forest=FILE     learn MANIAC trees from all input images, save them to FILE (no output image)\n");
+    v_printf(2,"   -x, --use-forest=FILE       use the MANIAC trees from FILE instead of learning them (much faster)\n");
     v_printf(3,"   -T, --maniac-threshold=N    MANIAC tree growth split threshold, in bits saved; default: -T%i\n",CONTEXT_TREE_SPLIT_THRESHOLD/5461);
     v_printf(3,"   -D, --maniac-divisor=N      MANIAC inner node count divisor; default: -D%i\n",CONTEXT_TREE_COUNT_DIV);
     v_printf(3,"   -M, --maniac-min-size=N     MANIAC post-pruning threshold; default: -M%i\n",CONTEXT_TREE_MIN_SUBTREE_SIZE);
@@ -112,6 +120,7 @@ void show_help(int mode) {
     v_printf(3,"                               ?=pick heuristically, 0=avg, 1=median_grad, 2=median_nb, X=mixed\n");
     v_printf(3,"   -H, --invisible-guess=N     predictor for invisible pixels (only if -K is not used)\n");
     v_printf(3,"   -J, --chroma-subsample      write an incomplete 4:2:0 chroma subsampled FLIF file (lossy!)\n");
+    v_printf(3,"   -a, --rans                  use rANS instead of the range coder for the pixel data (needs a recent decoder)\n");
     }
 #endif
     if (mode != 0) {
@@ -318,7 +327,8 @@ bool encode_flif(FLIF_UNUSED(int argc), char **argv, Images &images, flif_option
     }
     if (options.method.o == Optional::undefined) {
         // no method specified, pick one heuristically
-        if (nb_pixels * images.size() < 10000) options.method.encoding=flifEncoding::nonInterlaced; // if the image is small, not much point in doing interlacing
+        if (options.plane_streams) options.method.encoding=flifEncoding::nonInterlaced; // plane streams imply non-interlaced
+        else if (nb_pixels * images.size() < 10000) options.method.encoding=flifEncoding::nonInterlaced; // if the image is small, not much point in doing interlacing
         else options.method.encoding=flifEncoding::interlaced; // default method: interlacing
     }
     if (images.size() > 1) {
@@ -335,7 +345,10 @@ bool encode_flif(FLIF_UNUSED(int argc), char **argv, Images &images, flif_option
         if (options.learn_repeats < 0) options.learn_repeats=0;
     }
     bool result = true;
-    if (!options.just_add_loss) {
+    if (options.train_forest) {
+      BlobIO bio; // only learning a MANIAC forest, the encoded image is not needed
+      if (!flif_encode(bio, images, desc, options)) result = false;
+    } else if (!options.just_add_loss) {
       FILE *file = NULL;
       if (!strcmp(argv[0],"-")) file = stdout;
       else file = fopen(argv[0],"wb");
@@ -360,6 +373,31 @@ bool handle_encode(int argc, char **argv, Images &images, flif_options &options)
     return encode_flif(argc, argv, images, options);
 }
 
+// every argument is a training image (or a pattern for the frames of one); the trees are learned from all of them
+bool handle_train_forest(int argc, char **argv, flif_options &options, const char *filename) {
+    if (file_exists(filename) && !options.overwrite) {
+        e_printf("Error: output file already exists: %s\nUse --overwrite to force overwrite.\n",filename);
+        return false;
+    }
+    ManiacForest forest;
+    for (int i = 0; i < argc; i++) {
+        Images images;
+        flif_options image_options = options;
+        image_options.forest = &forest;
+        image_options.train_forest = 1;
+        v_printf(2,"Learning from %s\n", argv[i]);
+        if (!encode_load_input_images(2, &argv[i], images, image_options)) return false;
+        if (!image_options.alpha_zero_special) for (Image& im : images) im.alpha_zero_special = false;
+        if (!encode_flif(1, &argv[i], images, image_options)) return false;
+    }
+    if (!forest.save(filename)) {
+        e_printf("Error: could not write MANIAC forest to %s\n",filename);
+        return false;
+    }
+    v_printf(2,"Saved MANIAC forest to %s\n",filename);
+    return true;
+}
+
 #endif
 
 bool decode_flif(char **argv, Images &images, flif_options &options) {
@@ -474,6 +512,10 @@ int main(int argc, char **argv) {
     int mode = 1;
 #endif
     bool showhelp = false;
+#ifdef HAS_ENCODER
+    ManiacForest forest;
+    const char *train_forest = NULL;
+#endif
     if (strcmp(argv[0],"cflif") == 0) mode = 0;
     if (strcmp(argv[0],"dflif") == 0) mode = 1;
     if (strcmp(argv[0],"deflif") == 0) mode = 1;
@@ -494,6 +536,8 @@ int main(int argc, char **argv) {
         {"overwrite", 0, NULL, 'o'},
         {"breakpoints", 0, NULL, 'b'},
         {"keep-palette", 0, NULL, 'k'},
+        {"out-of-core", 1, NULL, 'O'},
+        {"threads", 1, NULL, 'j'},
 #ifdef HAS_ENCODER
         {"encode", 0, NULL, 'e'},
         {"transcode", 0, NULL, 't'},
@@ -521,14 +565,21 @@ int main(int argc, char **argv) {
         {"effort", 1, NULL, 'E'},
         {"chroma-subsample", 0, NULL, 'J'},
         {"no-subtract-green", 0, NULL, 'W'},
+        {"rans", 0, NULL, 'a'},
+        {"tile-size", 1, NULL, 'g'},
+        {"plane-streams", 0, NULL, 'z'},
+        {"zoomlevel-index", 0, NULL, 'u'},
+        {"maniac-sample", 1, NULL, 'l'},
+        {"use-forest", 1, NULL, 'x'},
+        {"train-forest", 1, NULL, 'y'},
 #endif
         {0, 0, 0, 0}
     };
     int i,c;
 #ifdef HAS_ENCODER
-    while ((c = getopt_long (argc, argv, "hdvcmiVq:s:r:f:obketINnF:KP:ABYWCL:SR:D:M:T:X:Z:Q:UG:H:E:J", optlist, &i)) != -1) {
+    while ((c = getopt_long (argc, argv, "hdvcmiVq:s:r:f:obkO:j:etINnF:KP:ABYWCL:SR:D:M:T:X:Z:Q:UG:H:E:Jag:zul:x:y:", optlist, &i)) != -1) {
 #else
-    while ((c = getopt_long (argc, argv, "hdvcmiVq:s:r:f:obk", optlist, &i)) != -1) {
+    while ((c = getopt_long (argc, argv, "hdvcmiVq:s:r:f:obkO:j:", optlist, &i)) != -1) {
 #endif
         switch (c) {
         case 'd': mode=1; break;
@@ -557,6 +608,15 @@ int main(int argc, char **argv) {
         case 'i': options.scale = -1; break;
         case 'b': options.show_breakpoints = 8; mode=1; break;
         case 'k': options.keep_palette = true; break;
+        case 'O': {
+                  int budget=atoi(optarg);
+                  if (budget < 0) {e_printf("Not a sensible number for option -O\n"); return 1; }
+                  if (!set_mapped_plane_allocator((size_t)budget << 20, NULL)) {e_printf("Out-of-core planes are not supported on this platform\n"); return 1; }
+                  }
+                  break;
+        case 'j': options.threads=atoi(optarg);
+                  if (options.threads < 1 || options.threads > 256) {e_printf("Not a sensible number for option -j\n"); return 1; }
+                  break;
 #ifdef HAS_ENCODER
         case 'e': mode=0; break;
         case 't': mode=2; break;
@@ -573,6 +633,21 @@ int main(int argc, char **argv) {
         case 'R': options.learn_repeats=atoi(optarg);
                   if (options.learn_repeats < 0 || options.learn_repeats > 20) {e_printf("Not a sensible number for option -R\n"); return 1; }
                   break;
+        case 'g': options.tile_size=atoi(optarg);
+                  if (options.tile_size < 16) {e_printf("Not a sensible number for option -g (tiles should be at least 16x16)\n"); return 1; }
+                  break;
+        case 'z': options.plane_streams=1;
+                  break;
+        case 'u': options.zoomlevel_index=1;
+                  break;
+        case 'l': options.learn_sample=atoi(optarg);
+                  if (options.learn_sample < 1 || options.learn_sample > 64) {e_printf("Not a sensible number for option -l\n"); return 1; }
+                  break;
+        case 'x': if (!forest.load(optarg)) return 1;
+                  options.forest = &forest;
+                  break;
+        case 'y': train_forest = optarg; mode = 0;
+                  break;
         case 'F': options.frame_delay.clear();
                   while(optarg != 0) {
                     int d=strtol(optarg,&optarg,10);
@@ -646,6 +721,8 @@ int main(int argc, char **argv) {
                   break;
         case 'J': options.chroma_subsampling = 1;
                   break;
+        case 'a': options.rans = 1;
+                  break;
         case 'E': {
                   int effort=atoi(optarg);
                   if (effort < 0 || effort > 100) {e_printf("Not a sensible number for option -E (try something between 0 and 100)\n"); return 1; }
@@ -674,6 +751,13 @@ int main(int argc, char **argv) {
     }
     argc -= optind;
     argv += optind;
+    options.verbosity = get_verbosity();
+#ifdef HAS_ENCODER
+    if (options.plane_streams && options.method.encoding == flifEncoding::interlaced) {
+        e_printf("Option -z (plane streams) cannot be combined with -I (interlacing)\n");
+        return 1;
+    }
+#endif
     bool last_is_output = (options.scale != -1);
     if (options.show_breakpoints && argc == 1) { last_is_output = false; options.no_full_decode = 1; options.scale = 2; }
 
@@ -687,6 +771,9 @@ int main(int argc, char **argv) {
         if (get_verbosity() == 1 || showhelp) show_help(mode);
         return 0;
     }
+#ifdef HAS_ENCODER
+    if (train_forest) return handle_train_forest(argc, argv, options, train_forest) ? 0 : 2;
+#endif
 
     if (argc == 1 && last_is_output) {
         show_help(mode);
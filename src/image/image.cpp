@@ -11,6 +11,136 @@
 #define strcasecmp _stricmp
 #endif
 
+#include <mutex>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <map>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// buffers of at least this size start on a hugepage boundary, so transparent hugepages can back them
+#define HUGEPAGE_SIZE ((size_t)2 << 20)
+
+static void* default_plane_allocate(size_t size, size_t alignment, void *) {
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    if (size >= HUGEPAGE_SIZE) alignment = HUGEPAGE_SIZE;
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, size)) return nullptr;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (size >= HUGEPAGE_SIZE) madvise(ptr, size & ~(HUGEPAGE_SIZE - 1), MADV_HUGEPAGE);
+#endif
+    return ptr;
+#endif
+}
+
+static void default_plane_release(void *ptr, size_t, void *) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+static const PlaneAllocator default_plane_allocator = {default_plane_allocate, default_plane_release, nullptr};
+static PlaneAllocator plane_allocator = default_plane_allocator;
+static std::mutex plane_allocator_mutex;
+
+PlaneAllocator get_plane_allocator() {
+    std::lock_guard<std::mutex> lock(plane_allocator_mutex);
+    return plane_allocator;
+}
+
+void set_plane_allocator(const PlaneAllocator *allocator) {
+    std::lock_guard<std::mutex> lock(plane_allocator_mutex);
+    plane_allocator = (allocator ? *allocator : default_plane_allocator);
+}
+
+#ifndef _WIN32
+// the state of the out-of-core allocator: buffers go to RAM while they fit in the budget, and to temporary files after that
+struct MappedPlaneArena {
+    std::mutex mutex;
+    size_t ram_budget = 0;
+    size_t ram_used = 0;
+    std::string directory;
+    std::map<void*, size_t> mapped;     // the buffers in temporary files, with their sizes
+};
+static MappedPlaneArena mapped_arena;
+
+static void* mapped_plane_allocate(size_t size, size_t alignment, void *) {
+    std::lock_guard<std::mutex> lock(mapped_arena.mutex);
+    if (mapped_arena.ram_used + size <= mapped_arena.ram_budget) {
+        void *ptr = default_plane_allocate(size, alignment, nullptr);
+        if (ptr) {
+            mapped_arena.ram_used += size;
+            return ptr;
+        }
+    }
+    // mappings start on a page boundary, which is more than PLANE_ALIGNMENT
+    std::string name = mapped_arena.directory + "/flif-plane-XXXXXX";
+    int fd = mkstemp(&name[0]);
+    if (fd < 0) return nullptr;
+    unlink(name.c_str());
+#ifdef __linux__
+    // reserve the disk space now, so a full disk is an allocation failure instead of a SIGBUS later on
+    bool ok = (posix_fallocate(fd, 0, size) == 0);
+#else
+    bool ok = (ftruncate(fd, size) == 0);
+#endif
+    void *ptr = (ok ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED);
+    close(fd);
+    if (ptr == MAP_FAILED) return nullptr;
+    mapped_arena.mapped[ptr] = size;
+    v_printf(5,"Mapped a %llu byte buffer to a temporary file in %s.\n", (unsigned long long)size, mapped_arena.directory.c_str());
+    return ptr;
+}
+
+static void mapped_plane_release(void *ptr, size_t size, void *) {
+    std::lock_guard<std::mutex> lock(mapped_arena.mutex);
+    auto it = mapped_arena.mapped.find(ptr);
+    if (it != mapped_arena.mapped.end()) {
+        munmap(ptr, it->second);
+        mapped_arena.mapped.erase(it);
+    } else {
+        default_plane_release(ptr, size, nullptr);
+        mapped_arena.ram_used -= size;
+    }
+}
+
+bool set_mapped_plane_allocator(size_t ram_budget, const char *directory) {
+    {
+        std::lock_guard<std::mutex> lock(mapped_arena.mutex);
+        if (!directory) directory = getenv("TMPDIR");
+        mapped_arena.ram_budget = ram_budget;
+        mapped_arena.directory = (directory && *directory ? directory : "/tmp");
+    }
+    const PlaneAllocator allocator = {mapped_plane_allocate, mapped_plane_release, nullptr};
+    set_plane_allocator(&allocator);
+    return true;
+}
+
+bool mapped_planes_enabled() {
+    return get_plane_allocator().allocate == mapped_plane_allocate;
+}
+
+void advise_mapped_buffer(const void *buffer, bool interlaced) {
+    std::lock_guard<std::mutex> lock(mapped_arena.mutex);
+    auto it = mapped_arena.mapped.find(const_cast<void*>(buffer));
+    if (it != mapped_arena.mapped.end())
+        posix_madvise(it->first, it->second, interlaced ? POSIX_MADV_NORMAL : POSIX_MADV_SEQUENTIAL);
+}
+#else
+bool set_mapped_plane_allocator(size_t, const char *) { return false; }
+bool mapped_planes_enabled() { return false; }
+void advise_mapped_buffer(const void *, bool) {}
+#endif
+
 #ifdef HAS_ENCODER
 bool Image::load(const char *filename, metadata_options &options)
 {
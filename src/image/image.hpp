@@ -24,6 +24,9 @@ limitations under the License.
 #include <string.h>
 #include <vector>
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <algorithm>
 #include "crc32k.hpp"
 
 #include "../io.hpp"
@@ -186,6 +189,22 @@ public:
     virtual void normalize_scale() {}
     virtual void accept_visitor(FLIF_UNUSED(PlaneVisitor &v)) =0;
     virtual uint32_t compute_crc32(uint32_t previous_crc32) =0;
+    // see advise_mapped_buffer
+    virtual void advise_mapped(FLIF_UNUSED(bool interlaced)) const {}
+    // another plane that shares the memory of this one, if this is a view onto memory owned by someone else
+    virtual std::unique_ptr<GeneralPlane> clone_view() const { return nullptr; }
+    // the copy that such a view made of its values when something wrote to it (after which the view can go)
+    virtual std::unique_ptr<GeneralPlane> release_copy() { return nullptr; }
+    // the plane that holds the values of this one: the plane itself, the copy of such a view, or nullptr for a view
+    // that nothing has written to (which still reads the memory of its owner)
+    virtual const GeneralPlane *own_values() const { return this; }
+    // copies the values of every row_step-th row and col_step-th column of other (a plane of the same size) in bulk;
+    // returns false if this plane can't do that for other, and then nothing was copied
+    virtual bool copy_values(FLIF_UNUSED(const GeneralPlane &other), FLIF_UNUSED(size_t row_step), FLIF_UNUSED(size_t col_step)) { return false; }
+    // copies the w x h values of other at (other_r, other_c) to (r, c) in bulk; returns false (and copies nothing)
+    // if this plane can't do that for other
+    virtual bool copy_block(FLIF_UNUSED(const GeneralPlane &other), FLIF_UNUSED(size_t other_r), FLIF_UNUSED(size_t other_c),
+                            FLIF_UNUSED(size_t r), FLIF_UNUSED(size_t c), FLIF_UNUSED(size_t w), FLIF_UNUSED(size_t h)) { return false; }
     // access pixel by zoomlevel coordinate
     static size_t zoom_rowpixelsize(int zoomlevel) {
     //    return pixelsizes[zoomlevel+1];
@@ -208,51 +227,140 @@ struct PlaneVisitor {
     virtual void visit(Plane<ColorVal_intern_32>&) =0;
 #endif
 //    virtual void visit(ConstantPlane&) =0;
+    // gets a view onto memory of the library user (see ViewPlane) that nothing has written to; a visitor that only
+    // reads can do so here through the GeneralPlane interface and return true, otherwise the view copies its values
+    // and the copy is visited
+    virtual bool visit_view(FLIF_UNUSED(const GeneralPlane &plane)) { return false; }
     virtual ~PlaneVisitor() {}
 };
 
+// read-only access to a particular zoomlevel that does not store the zoomlevel in the plane (unlike prepare_zoomlevel),
+// so different threads can read the same plane at different zoomlevels
+template <typename pixel_t> class ZoomView {
+    const pixel_t* data;
+    const size_t s_r, s_c;
+public:
+    ZoomView(const pixel_t* d, size_t sr, size_t sc) : data(d), s_r(sr), s_c(sc) {}
+    ColorVal get_fast(size_t r, size_t c) const {
+        return data[r*s_r+c*s_c];
+    }
+};
+
 #define SCALED(x) ((x)==0?0:((((x)-1)>>scale)+1))
 #ifdef USE_SIMD
-// pad to a multiple of 8, leaving room for alignment
+// pad so that vector reads and writes just past the last pixel stay inside the buffer
 #define PAD(x) ((x) + 16)
 #else
 #define PAD(x) (x)
 #endif
 
+// Allocator for the pixel buffers of planes (flif_set_allocator in the library interface).
+// allocate(size, alignment, arena) returns size bytes aligned to alignment, or nullptr if it can't;
+// release(ptr, size, arena) gets back a buffer with the size it was allocated with.
+struct PlaneAllocator {
+    void* (*allocate)(size_t size, size_t alignment, void *arena);
+    void (*release)(void *ptr, size_t size, void *arena);
+    void *arena;
+};
+
+// alignment of plane buffers: a cache line, and enough for any vector loads
+#define PLANE_ALIGNMENT 64
+
+
+// the allocator that new planes use unless they are given one; set_plane_allocator(nullptr) restores the default,
+// which allocates big buffers on hugepage boundaries (and asks for transparent hugepages on Linux)
+PlaneAllocator get_plane_allocator();
+void set_plane_allocator(const PlaneAllocator *allocator);
+
+// Out-of-core planes: makes the plane allocator keep at most ram_budget bytes of plane buffers in RAM (in total), and put
+// the buffers of any further planes in memory-mapped temporary files in directory (nullptr: $TMPDIR, or else /tmp),
+// so images that do not fit in RAM can still be encoded and decoded, at the speed of the disk.
+// Returns false if memory-mapped files are not supported on this platform. set_plane_allocator() turns it off again.
+bool set_mapped_plane_allocator(size_t ram_budget, const char *directory);
+bool mapped_planes_enabled();
+// if buffer is a plane buffer in a memory-mapped file, tells the kernel how it will be visited: row after row (read
+// ahead, drop what is behind), or in the repeated sweeps of interlaced encoding/decoding (normal read ahead, keep pages
+// for the next sweep)
+void advise_mapped_buffer(const void *buffer, bool interlaced);
+
 
 template <typename pixel_t> class Plane final : public GeneralPlane {
-    std::vector<pixel_t> data_vec;
+    template <typename> friend class Plane;
+    PlaneAllocator allocator;
     pixel_t* data;
+    size_t data_size;   // number of values in data, including padding
     const size_t width, height;
     int s;
     mutable size_t s_r = 0, s_c = 0;
 
+    size_t allocated_bytes() const { return std::max(data_size, (size_t)1) * sizeof(pixel_t); }
+    // where value (r,c) is in data
+    size_t index(const size_t r, const size_t c) const {
+        return r*width + c;
+    }
+
+    // same conversion as set(r,c,other.get(r,c)), but a row at a time (and a single memcpy if nothing is skipped)
+    template <typename other_t>
+    bool copy_rows(const Plane<other_t> &other, const size_t row_step, const size_t col_step) {
+        if (other.width != width || other.height != height) return false;
+        if (std::is_same<pixel_t, other_t>::value && row_step == 1 && col_step == 1) {
+            memcpy(data, other.data, width * height * sizeof(pixel_t));
+            return true;
+        }
+        for (size_t r = 0; r < height; r += row_step) {
+            const other_t *in = other.data + r * width;
+            pixel_t *out = data + r * width;
+            if (col_step == 1) {
+                for (size_t c = 0; c < width; c++) out[c] = (ColorVal)in[c];
+            } else {
+                for (size_t c = 0; c < width; c += col_step) out[c] = (ColorVal)in[c];
+            }
+        }
+        return true;
+    }
+
+    template <typename other_t>
+    void copy_block_rows(const Plane<other_t> &other, const size_t other_r, const size_t other_c, const size_t r, const size_t c, const size_t w, const size_t h) {
+        for (size_t y = 0; y < h; y++) {
+            pixel_t *to = &data[index(r + y, c)];
+            const other_t *from = &other.data[other.index(other_r + y, other_c)];
+            if (std::is_same<pixel_t, other_t>::value) memcpy(to, from, w * sizeof(pixel_t));
+            else for (size_t x = 0; x < w; x++) to[x] = (ColorVal)from[x];
+        }
+    }
+
 public:
-    Plane(size_t w, size_t h, ColorVal color=0, int scale = 0) : data_vec(PAD(SCALED(w)*SCALED(h)), color), width(SCALED(w)), height(SCALED(h)), s(scale) {
-      // Align only when required. The emscripten port doesn't work with padded alignment and doesn't support SIMD, so
-      // `USE_SIMD` is a good condition for alignment, for now.
-#ifdef USE_SIMD
-        //size_t space = data_vec.size()*sizeof(pixel_t);
-        void *ptr = data_vec.data();
-        //std::align (C++11) is not in GCC or Clang (the versions used by Travis-CI at least) for some stupid reason
-        //data = static_cast<pixel_t*>(std::align(16,16,ptr,space));
-        uintptr_t diff = (uintptr_t)ptr % 16;
-        data = static_cast<pixel_t*>((diff == 0) ? ptr : ((char*)ptr) + (16-diff));
-#else
-        data = data_vec.data();
-#endif
-        assert(data != nullptr);
+    Plane(size_t w, size_t h, ColorVal color=0, int scale = 0, const PlaneAllocator *alloc = nullptr)
+      : allocator(alloc ? *alloc : get_plane_allocator()), data(nullptr), data_size(PAD(SCALED(w)*SCALED(h))),
+        width(SCALED(w)), height(SCALED(h)), s(scale) {
+        data = static_cast<pixel_t*>(allocator.allocate(allocated_bytes(), PLANE_ALIGNMENT, allocator.arena));
+        if (!data) throw std::bad_alloc();
+        assert(((uintptr_t)data % PLANE_ALIGNMENT) == 0);
+        std::fill(data, data + data_size, color);
         if (height > 1) v_printf(6,"Allocated %u x %u buffer (%i-bit).\n",width,height,8 * sizeof(pixel_t));
     }
+    Plane(const Plane&) = delete;
+    Plane& operator=(const Plane&) = delete;
+    ~Plane() { clear(); }
     void clear() {
-        data_vec.clear();
+        if (data) allocator.release(data, allocated_bytes(), allocator.arena);
+        data = nullptr;
+        data_size = 0;
+    }
+    // makes this a fresh plane (all color) of the given size and scale, if it has that size
+    bool reuse(size_t w, size_t h, int scale, ColorVal color = 0) {
+        if (SCALED(w) != width || SCALED(h) != height || !data || data_size != PAD(width*height)) return false;
+        std::fill(data, data + data_size, color);
+        s = scale;
+        s_r = s_c = 0;
+        return true;
     }
     void set(const size_t r, const size_t c, const ColorVal x) override {
 //        const size_t sr = r>>s, sc = c>>s;
         const size_t sr = r, sc = c;
 //        assert(s==0);  // can also be used when using downscaled plane; in this case you have to make sure to use downscaled r,c !
         assert(sr<height); assert(sc<width);
-        data[sr*width + sc] = x;
+        data[index(sr, sc)] = x;
     }
     ColorVal get(const size_t r, const size_t c) const override ATTRIBUTE_HOT {
 //        if (r >= height || r < 0 || c >= width || c < 0) {printf("OUT OF RANGE!\n"); return 0;}
@@ -260,8 +368,11 @@ public:
         const size_t sr = r, sc = c;
 //        assert(s==0);  // can also be used when using downscaled plane; in this case you have to make sure to use downscaled r,c !
         assert(sr<height); assert(sc<width);
-        return data[sr*width + sc];
+        return data[index(sr, sc)];
     }
+// the values of row r, for code that converts whole rows at once
+    pixel_t* row_data(const size_t r) { assert(r<height); return data + r*width; }
+    const pixel_t* row_data(const size_t r) const { assert(r<height); return data + r*width; }
 // get/set specialized for a particular zoomlevel
     void prepare_zoomlevel(const int z) const override {
         s_r = (zoom_rowpixelsize(z)>>s)*width;
@@ -273,6 +384,10 @@ public:
     void set_fast(size_t r, size_t c, ColorVal x) override {
         data[r*s_r+c*s_c] = x;
     }
+    ZoomView<pixel_t> zoomed(const int z) const {
+        return ZoomView<pixel_t>(data, (zoom_rowpixelsize(z)>>s)*width, zoom_colpixelsize(z)>>s);
+    }
+    size_t values() const { return width*height; }
 #ifdef USE_SIMD
 // methods to just get all the values quickly
     FourColorVals get4(const size_t pos) const ATTRIBUTE_HOT {
@@ -323,35 +438,69 @@ public:
 #endif
     void set(const int z, const size_t r, const size_t c, const ColorVal x) override {
 //        set(r*zoom_rowpixelsize(z),c*zoom_colpixelsize(z),x);
-         data[(r*zoom_rowpixelsize(z)>>s)*width + (c*zoom_colpixelsize(z)>>s)] = x;
+         data[index(r*zoom_rowpixelsize(z)>>s, c*zoom_colpixelsize(z)>>s)] = x;
     }
     ColorVal get(const int z, const size_t r, const size_t c) const override {
 //        return get(r*zoom_rowpixelsize(z),c*zoom_colpixelsize(z));
-        return data[(r*zoom_rowpixelsize(z)>>s)*width + (c*zoom_colpixelsize(z)>>s)];
+        return data[index(r*zoom_rowpixelsize(z)>>s, c*zoom_colpixelsize(z)>>s)];
     }
     void normalize_scale() override { s = 0; }
 
     int bytes_per_pixel() const override { return sizeof(pixel_t); }
 
+    bool copy_values(const GeneralPlane &other, const size_t row_step, const size_t col_step) override {
+        if (other.is_constant()) {
+            const pixel_t color = other.get(0, 0);
+            for (size_t r = 0; r < height; r += row_step)
+                for (size_t c = 0; c < width; c += col_step) data[index(r, c)] = color;
+            return true;
+        }
+        if (const Plane<ColorVal_intern_8> *o = dynamic_cast<const Plane<ColorVal_intern_8>*>(&other)) return copy_rows(*o, row_step, col_step);
+        if (const Plane<ColorVal_intern_16> *o = dynamic_cast<const Plane<ColorVal_intern_16>*>(&other)) return copy_rows(*o, row_step, col_step);
+#ifdef SUPPORT_HDR
+        if (const Plane<ColorVal_intern_16u> *o = dynamic_cast<const Plane<ColorVal_intern_16u>*>(&other)) return copy_rows(*o, row_step, col_step);
+        if (const Plane<ColorVal_intern_32> *o = dynamic_cast<const Plane<ColorVal_intern_32>*>(&other)) return copy_rows(*o, row_step, col_step);
+#endif
+        return false;
+    }
+
+    bool copy_block(const GeneralPlane &other, const size_t other_r, const size_t other_c, const size_t r, const size_t c, const size_t w, const size_t h) override {
+        if (r + h > height || c + w > width) return false;
+        if (other.is_constant()) {
+            const pixel_t color = other.get(0, 0);
+            for (size_t y = r; y < r + h; y++)
+                for (size_t x = c; x < c + w; x++) data[index(y, x)] = color;
+            return true;
+        }
+        if (const Plane<ColorVal_intern_8> *o = dynamic_cast<const Plane<ColorVal_intern_8>*>(&other)) { copy_block_rows(*o, other_r, other_c, r, c, w, h); return true; }
+        if (const Plane<ColorVal_intern_16> *o = dynamic_cast<const Plane<ColorVal_intern_16>*>(&other)) { copy_block_rows(*o, other_r, other_c, r, c, w, h); return true; }
+#ifdef SUPPORT_HDR
+        if (const Plane<ColorVal_intern_16u> *o = dynamic_cast<const Plane<ColorVal_intern_16u>*>(&other)) { copy_block_rows(*o, other_r, other_c, r, c, w, h); return true; }
+        if (const Plane<ColorVal_intern_32> *o = dynamic_cast<const Plane<ColorVal_intern_32>*>(&other)) { copy_block_rows(*o, other_r, other_c, r, c, w, h); return true; }
+#endif
+        return false;
+    }
+
     void accept_visitor(FLIF_UNUSED(PlaneVisitor &v)) override {
         v.visit(*this);
     }
+    void advise_mapped(bool interlaced) const override { advise_mapped_buffer(data, interlaced); }
     uint32_t compute_crc32(uint32_t previous_crc32) override {
 #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
         // temporarily make the buffer little endian (TODO: avoid this by modifying the crc to take the swapped bytes into account directly)
         if (sizeof(pixel_t) == 2) {
-            for (pixel_t& x : data_vec) x = swap16(x);
+            for (size_t i = 0; i < data_size; i++) data[i] = swap16(data[i]);
         } else if (sizeof(pixel_t) == 4) {
-            for (pixel_t& x : data_vec) x = swap(x);
+            for (size_t i = 0; i < data_size; i++) data[i] = swap(data[i]);
         }
 #endif
         uint32_t result = crc32_fast(&data[0], width*height*sizeof(pixel_t), previous_crc32);
 #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
         // make the buffer big endian again
         if (sizeof(pixel_t) == 2) {
-            for (pixel_t& x : data_vec) x = swap16(x);
+            for (size_t i = 0; i < data_size; i++) data[i] = swap16(data[i]);
         } else if (sizeof(pixel_t) == 4) {
-            for (pixel_t& x : data_vec) x = swap(x);
+            for (size_t i = 0; i < data_size; i++) data[i] = swap(data[i]);
         }
 #endif
         return result;
@@ -371,6 +520,7 @@ public:
 
     void prepare_zoomlevel(FLIF_UNUSED(const int z)) const override {}
     ColorVal get_fast(FLIF_UNUSED(size_t r), FLIF_UNUSED(size_t c)) const override { return color; }
+    const ConstantPlane& zoomed(FLIF_UNUSED(const int z)) const { return *this; }
     void set_fast(FLIF_UNUSED(size_t r), FLIF_UNUSED(size_t c), FLIF_UNUSED(ColorVal x)) override { assert(x == color); }
 
 #ifdef USE_SIMD
@@ -420,6 +570,119 @@ public:
     }
 };
 
+// A plane that reads its values from memory owned by the library user, e.g. one channel of an interleaved RGBA buffer:
+// value (r,c) is source[r*stride + c*step]. The values are only copied (into a Plane<pixel_t> of its own) on the first
+// write, so an imported image takes no memory of its own as long as nothing modifies it.
+template <typename source_t> class SourceView : public GeneralPlane {
+public:
+    // like Plane::zoomed, on the memory of the owner (only for a view that nothing has written to)
+    virtual ZoomView<source_t> zoomed(const int z) const =0;
+};
+
+template <typename pixel_t, typename source_t> class ViewPlane final : public SourceView<source_t> {
+    using GeneralPlane::zoom_rowpixelsize;
+    using GeneralPlane::zoom_colpixelsize;
+    const source_t *source;
+    const size_t stride, step;
+    const size_t width, height;
+    std::unique_ptr<Plane<pixel_t>> copy;
+    mutable int zoomlevel = -1; // of the last prepare_zoomlevel, which the copy also needs
+    mutable size_t s_r = 0, s_c = 0;
+
+    ColorVal at(size_t pos) const {
+        return (pos < width*height ? source[(pos / width) * stride + (pos % width) * step] : 0);
+    }
+    Plane<pixel_t>& writable() {
+        if (!copy) {
+            copy = make_unique<Plane<pixel_t>>(width, height);
+            for (size_t r = 0; r < height; r++)
+                for (size_t c = 0; c < width; c++) copy->set(r, c, source[r*stride + c*step]);
+            if (zoomlevel >= 0) copy->prepare_zoomlevel(zoomlevel);
+        }
+        return *copy;
+    }
+
+public:
+    ViewPlane(size_t w, size_t h, const source_t *src, size_t row_stride, size_t col_step)
+      : source(src), stride(row_stride), step(col_step), width(w), height(h) {}
+
+    void set(const size_t r, const size_t c, const ColorVal x) override { writable().set(r, c, x); }
+    ColorVal get(const size_t r, const size_t c) const override {
+        if (copy) return copy->get(r, c);
+        assert(r<height); assert(c<width);
+        return source[r*stride + c*step];
+    }
+    void prepare_zoomlevel(const int z) const override {
+        zoomlevel = z;
+        if (copy) copy->prepare_zoomlevel(z);
+        s_r = zoom_rowpixelsize(z)*stride;
+        s_c = zoom_colpixelsize(z)*step;
+    }
+    ColorVal get_fast(size_t r, size_t c) const override {
+        if (copy) return copy->get_fast(r, c);
+        return source[r*s_r + c*s_c];
+    }
+    void set_fast(size_t r, size_t c, ColorVal x) override { writable().set_fast(r, c, x); }
+#ifdef USE_SIMD
+    FourColorVals get4(const size_t pos) const override {
+        if (copy) return copy->get4(pos);
+#ifdef _MSC_VER
+        FourColorVals x(at(pos+3), at(pos+2), at(pos+1), at(pos)); // _mm_set_epi32 takes the highest element first
+#else
+        FourColorVals x {at(pos), at(pos+1), at(pos+2), at(pos+3)};
+#endif
+        return x;
+    }
+    void VCALL set4(const size_t pos, const FourColorVals x) override { writable().set4(pos, x); }
+    EightColorVals get8(const size_t pos) const override {
+        if (copy) return copy->get8(pos);
+        EightColorVals x {(int16_t)at(pos), (int16_t)at(pos+1), (int16_t)at(pos+2), (int16_t)at(pos+3),
+                          (int16_t)at(pos+4), (int16_t)at(pos+5), (int16_t)at(pos+6), (int16_t)at(pos+7)};
+        return x;
+    }
+    void VCALL set8(const size_t pos, const EightColorVals x) override { writable().set8(pos, x); }
+#endif
+    void set(const int z, const size_t r, const size_t c, const ColorVal x) override { writable().set(z, r, c, x); }
+    ColorVal get(const int z, const size_t r, const size_t c) const override {
+        if (copy) return copy->get(z, r, c);
+        return source[r*zoom_rowpixelsize(z)*stride + c*zoom_colpixelsize(z)*step];
+    }
+    void normalize_scale() override { if (copy) copy->normalize_scale(); }
+    int bytes_per_pixel() const override { return sizeof(pixel_t); }
+    void accept_visitor(PlaneVisitor &v) override {
+        if (!copy && v.visit_view(*this)) return;
+        writable().accept_visitor(v);
+    }
+    uint32_t compute_crc32(uint32_t previous_crc32) override {
+        if (copy) return copy->compute_crc32(previous_crc32);
+        // same as the crc of a Plane<pixel_t> with these values, one row at a time
+        std::vector<pixel_t> row(width);
+        uint32_t crc = previous_crc32;
+        for (size_t r = 0; r < height; r++) {
+            for (size_t c = 0; c < width; c++) row[c] = source[r*stride + c*step];
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            if (sizeof(pixel_t) == 2) {
+                for (pixel_t& x : row) x = swap16(x);
+            } else if (sizeof(pixel_t) == 4) {
+                for (pixel_t& x : row) x = swap(x);
+            }
+#endif
+            crc = crc32_fast(row.data(), width*sizeof(pixel_t), crc);
+        }
+        return crc;
+    }
+    std::unique_ptr<GeneralPlane> clone_view() const override {
+        if (copy) return nullptr;
+        return make_unique<ViewPlane<pixel_t, source_t>>(width, height, source, stride, step);
+    }
+    std::unique_ptr<GeneralPlane> release_copy() override { return std::move(copy); }
+    const GeneralPlane *own_values() const override { return copy.get(); }
+    ZoomView<source_t> zoomed(const int z) const override {
+        assert(!copy);
+        return ZoomView<source_t>(source, zoom_rowpixelsize(z)*stride, zoom_colpixelsize(z)*step);
+    }
+};
+
 template<typename plane_t>
 void copy_row_range(plane_t &plane, const GeneralPlane &other, const size_t r, const size_t begin, const size_t end, const size_t stride = 1) {
     //assuming pixels are only ever copied from either a constant plane or a plane of the same type
@@ -432,6 +695,40 @@ void copy_row_range(plane_t &plane, const GeneralPlane &other, const size_t r, c
     }
 }
 
+// Where Image::real_init gets its planes: buffers of previously decoded images that can be reused instead of allocating
+// new ones (this avoids allocator traffic and page faults when many images of the same size are decoded one after the
+// other), and the allocator for new buffers.
+class PlanePool {
+    std::vector<std::unique_ptr<GeneralPlane>> planes;
+    PlaneAllocator allocator;
+    bool own_allocator = false;
+public:
+    // new buffers come from allocator (nullptr: the one of get_plane_allocator); drops the buffers kept for reuse,
+    // since they came from the previous allocator
+    void set_allocator(const PlaneAllocator *alloc) {
+        own_allocator = (alloc != nullptr);
+        if (alloc) allocator = *alloc;
+        clear();
+    }
+    const PlaneAllocator *get_allocator() const { return own_allocator ? &allocator : nullptr; }
+    void add(std::unique_ptr<GeneralPlane> plane) {
+        if (plane && !plane->is_constant()) planes.push_back(std::move(plane));
+    }
+    // returns a Plane<pixel_t> of the given size (all color), reusing a kept buffer if there is one
+    template <typename pixel_t>
+    std::unique_ptr<GeneralPlane> get(size_t w, size_t h, int scale, ColorVal color = 0) {
+        for (size_t i = 0; i < planes.size(); i++) {
+            Plane<pixel_t> *plane = dynamic_cast<Plane<pixel_t>*>(planes[i].get());
+            if (!plane || !plane->reuse(w, h, scale, color)) continue;
+            std::unique_ptr<GeneralPlane> result = std::move(planes[i]);
+            planes.erase(planes.begin() + i);
+            return result;
+        }
+        return make_unique<Plane<pixel_t>>(w, h, color, scale, own_allocator ? &allocator : nullptr);
+    }
+    void clear() { planes.clear(); }
+};
+
 struct MetaData {
     char name[5];               // name of the chunk (every chunk is assumed to be unique, 4 ascii letters plus terminating 0)
     size_t length;              // length of the chunk contents
@@ -455,6 +752,10 @@ class Image {
 #else
     const int depth=8;
 #endif
+    // the allocator of the pool the planes came from, for the planes that are made later on (e.g. by
+    // undo_make_constant_plane in an inverse transform); otherwise the one of get_plane_allocator is used
+    PlaneAllocator allocator;
+    bool own_allocator = false;
 
     Image(const Image& other) {
       // reuse implementation from assignment operator
@@ -463,6 +764,13 @@ class Image {
 
 
     Image& operator=(const Image& other) {
+      copy_from(other, nullptr);
+      return *this;
+    }
+
+    // the new planes come from pool if it is given, like in real_init
+    void copy_from(const Image& other, PlanePool *pool) {
+      take_allocator(pool);
       width = other.width;
       height = other.height;
       minval = other.minval;
@@ -483,32 +791,46 @@ class Image {
       col_end = other.col_end;
       seen_before = other.seen_before;
       fully_decoded = other.fully_decoded;
+      // views onto memory of the library user are shared instead of copied
+      bool view[5] = {false, false, false, false, false};
+      for(int p=0; p<num; p++) {
+          if (other.planes[p]) planes[p] = other.planes[p]->clone_view();
+          view[p] = (planes[p] != nullptr);
+      }
       {
       int p=num;
       if (depth <= 8) {
-        if (p>0) planes[0] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // R,Y
-        if (p>1) planes[1] = make_unique<Plane<ColorVal_intern_16>>(width, height, 0, scale); // G,I
-        if (p>2) planes[2] = make_unique<Plane<ColorVal_intern_16>>(width, height, 0, scale); // B,Q
-        if (p>3) planes[3] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // A
+        if (p>0 && !planes[0]) planes[0] = new_plane<ColorVal_intern_8>(pool); // R,Y
+        if (p>1 && !planes[1]) planes[1] = new_plane<ColorVal_intern_16>(pool); // G,I
+        if (p>2 && !planes[2]) planes[2] = new_plane<ColorVal_intern_16>(pool); // B,Q
+        if (p>3 && !planes[3]) planes[3] = new_plane<ColorVal_intern_8>(pool); // A
 #ifdef SUPPORT_HDR
       } else {
-        if (p>0) planes[0] = make_unique<Plane<ColorVal_intern_16u>>(width, height, 0, scale); // R,Y
-        if (p>1) planes[1] = make_unique<Plane<ColorVal_intern_32>>(width, height, 0, scale); // G,I
-        if (p>2) planes[2] = make_unique<Plane<ColorVal_intern_32>>(width, height, 0, scale); // B,Q
-        if (p>3) planes[3] = make_unique<Plane<ColorVal_intern_16u>>(width, height, 0, scale); // A
+        if (p>0 && !planes[0]) planes[0] = new_plane<ColorVal_intern_16u>(pool); // R,Y
+        if (p>1 && !planes[1]) planes[1] = new_plane<ColorVal_intern_32>(pool); // G,I
+        if (p>2 && !planes[2]) planes[2] = new_plane<ColorVal_intern_32>(pool); // B,Q
+        if (p>3 && !planes[3]) planes[3] = new_plane<ColorVal_intern_16u>(pool); // A
 #endif
       }
-      if (p>4) planes[4] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // FRA
+      if (p>4) planes[4] = new_plane<ColorVal_intern_8>(pool); // FRA
       }
-      for(int p=0; p<num; p++)
+      for(int p=0; p<num; p++) {
+          if (view[p] || planes[p]->copy_values(*other.planes[p], 1, 1)) continue;
           for (size_t r=0; r<SCALED(height); r++)
              for (size_t c=0; c<SCALED(width); c++)
                  set(p,r,c,other.operator()(p,r,c));
-
-      return *this;
+      }
     }
 
-
+    template <typename pixel_t>
+    std::unique_ptr<GeneralPlane> new_plane(PlanePool *pool, ColorVal color = 0) const {
+      if (pool) return pool->template get<pixel_t>(width, height, scale, color);
+      return make_unique<Plane<pixel_t>>(width, height, color, scale, own_allocator ? &allocator : nullptr);
+    }
+    void take_allocator(PlanePool *pool) {
+      own_allocator = (pool && pool->get_allocator());
+      if (own_allocator) allocator = *pool->get_allocator();
+    }
 
 public:
     bool palette;
@@ -552,6 +874,8 @@ public:
       scale = other.scale;
       fully_decoded = other.fully_decoded;
       for (int p=0; p<num; p++) planes[p] = std::move(other.planes[p]);
+      allocator = other.allocator;
+      own_allocator = other.own_allocator;
       frame_delay = other.frame_delay;
 #ifdef SUPPORT_HDR
       depth = other.depth;
@@ -578,10 +902,11 @@ public:
       return *this;
     }
 
-    // downsampling copy constructor
-    Image(const Image& other, int new_w, int new_h) :
+    // downsampling copy constructor (the planes come from pool if it is given, like in real_init)
+    Image(const Image& other, int new_w, int new_h, PlanePool *pool = nullptr) :
       metadata(other.metadata)
     {
+      take_allocator(pool);
       width = new_w;
       height = new_h;
       minval = other.minval;
@@ -607,19 +932,19 @@ public:
       {
       int p=num;
       if (depth <= 8) {
-        if (p>0) planes[0] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // R,Y
-        if (p>1) planes[1] = make_unique<Plane<ColorVal_intern_16>>(width, height, 0, scale); // G,I
-        if (p>2) planes[2] = make_unique<Plane<ColorVal_intern_16>>(width, height, 0, scale); // B,Q
-        if (p>3) planes[3] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // A
+        if (p>0) planes[0] = new_plane<ColorVal_intern_8>(pool); // R,Y
+        if (p>1) planes[1] = new_plane<ColorVal_intern_16>(pool); // G,I
+        if (p>2) planes[2] = new_plane<ColorVal_intern_16>(pool); // B,Q
+        if (p>3) planes[3] = new_plane<ColorVal_intern_8>(pool); // A
 #ifdef SUPPORT_HDR
       } else {
-        if (p>0) planes[0] = make_unique<Plane<ColorVal_intern_16u>>(width, height, 0, scale); // R,Y
-        if (p>1) planes[1] = make_unique<Plane<ColorVal_intern_32>>(width, height, 0, scale); // G,I
-        if (p>2) planes[2] = make_unique<Plane<ColorVal_intern_32>>(width, height, 0, scale); // B,Q
-        if (p>3) planes[3] = make_unique<Plane<ColorVal_intern_16u>>(width, height, 0, scale); // A
+        if (p>0) planes[0] = new_plane<ColorVal_intern_16u>(pool); // R,Y
+        if (p>1) planes[1] = new_plane<ColorVal_intern_32>(pool); // G,I
+        if (p>2) planes[2] = new_plane<ColorVal_intern_32>(pool); // B,Q
+        if (p>3) planes[3] = new_plane<ColorVal_intern_16u>(pool); // A
 #endif
       }
-      if (p>4) planes[4] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // FRA
+      if (p>4) planes[4] = new_plane<ColorVal_intern_8>(pool); // FRA
       }
       // this is stupid downsampling
       // TODO: replace this with more accurate downscaling
@@ -629,8 +954,9 @@ public:
                  set(p,r,c,other.operator()(p,r*other.height/height,c*other.width/width));
     }
 
-    // copy constructor with stride
-    Image(const Image& other, bool *skipInterpolate, std::vector<int> zoomlevels) : metadata(other.metadata) {
+    // copy constructor with stride (the planes come from pool if it is given, like in real_init)
+    Image(const Image& other, bool *skipInterpolate, std::vector<int> zoomlevels, PlanePool *pool = nullptr) : metadata(other.metadata) {
+      take_allocator(pool);
       width = other.width;
       height = other.height;
       minval = other.minval;
@@ -653,19 +979,19 @@ public:
       {
       int p=num;
       if (depth <= 8) {
-        if (p>0) planes[0] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // R,Y
-        if (p>1) planes[1] = make_unique<Plane<ColorVal_intern_16>>(width, height, 0, scale); // G,I
-        if (p>2) planes[2] = make_unique<Plane<ColorVal_intern_16>>(width, height, 0, scale); // B,Q
-        if (p>3) planes[3] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // A
+        if (p>0) planes[0] = new_plane<ColorVal_intern_8>(pool); // R,Y
+        if (p>1) planes[1] = new_plane<ColorVal_intern_16>(pool); // G,I
+        if (p>2) planes[2] = new_plane<ColorVal_intern_16>(pool); // B,Q
+        if (p>3) planes[3] = new_plane<ColorVal_intern_8>(pool); // A
 #ifdef SUPPORT_HDR
       } else {
-        if (p>0) planes[0] = make_unique<Plane<ColorVal_intern_16u>>(width, height, 0, scale); // R,Y
-        if (p>1) planes[1] = make_unique<Plane<ColorVal_intern_32>>(width, height, 0, scale); // G,I
-        if (p>2) planes[2] = make_unique<Plane<ColorVal_intern_32>>(width, height, 0, scale); // B,Q
-        if (p>3) planes[3] = make_unique<Plane<ColorVal_intern_16u>>(width, height, 0, scale); // A
+        if (p>0) planes[0] = new_plane<ColorVal_intern_16u>(pool); // R,Y
+        if (p>1) planes[1] = new_plane<ColorVal_intern_32>(pool); // G,I
+        if (p>2) planes[2] = new_plane<ColorVal_intern_32>(pool); // B,Q
+        if (p>3) planes[3] = new_plane<ColorVal_intern_16u>(pool); // A
 #endif
       }
-      if (p>4) planes[4] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // FRA
+      if (p>4) planes[4] = new_plane<ColorVal_intern_8>(pool); // FRA
       }
       size_t scaledHeight = SCALED(height);
       size_t scaledWidth = SCALED(width);
@@ -675,6 +1001,7 @@ public:
         const size_t zoomlevelScaled = zoomlevels[p] + 1-(2*scale);
         const size_t strideRow = skipInterpolate[p] ? 1 :  1<<((zoomlevelScaled+1)/2);
         const size_t strideCol = skipInterpolate[p] ? 1 :  1<<((zoomlevelScaled)/2);
+          if (planeDest.copy_values(planeSrc, strideRow, strideCol)) continue;
           for (size_t r=0; r<scaledHeight; r+=strideRow) {
              for (size_t c=0; c<scaledWidth; c+=strideCol) {
                  planeDest.set(r,c,planeSrc.get(r,c));
@@ -720,27 +1047,28 @@ public:
       }
       return true;
     }
-    bool real_init(bool smaller_buffer) {
+    bool real_init(bool smaller_buffer, PlanePool *pool = nullptr) {
+      take_allocator(pool);
       int p = num;
 //      printf("smaller: %i\n",(int)smaller_buffer);
       try {
       if (depth <= 8) {
-        if (p>0 && !planes[0]) planes[0] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // R,Y
+        if (p>0 && !planes[0]) planes[0] = new_plane<ColorVal_intern_8>(pool); // R,Y
         if (p>1 && !planes[1]) {
-          if (smaller_buffer)  planes[1] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale);  // 8-bit Palette
-          else                 planes[1] = make_unique<Plane<ColorVal_intern_16>>(width, height, 0, scale); // G,I
+          if (smaller_buffer)  planes[1] = new_plane<ColorVal_intern_8>(pool);  // 8-bit Palette
+          else                 planes[1] = new_plane<ColorVal_intern_16>(pool); // G,I
         }
-        if (p>2 && !planes[2]) planes[2] = make_unique<Plane<ColorVal_intern_16>>(width, height, 0, scale); // B,Q
-        if (p>3 && !planes[3]) planes[3] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // A
+        if (p>2 && !planes[2]) planes[2] = new_plane<ColorVal_intern_16>(pool); // B,Q
+        if (p>3 && !planes[3]) planes[3] = new_plane<ColorVal_intern_8>(pool); // A
 #ifdef SUPPORT_HDR
       } else {
-        if (p>0 && !planes[0]) planes[0] = make_unique<Plane<ColorVal_intern_16u>>(width, height, 0, scale); // R,Y
-        if (p>1 && !planes[1]) planes[1] = make_unique<Plane<ColorVal_intern_32>>(width, height, 0, scale); // G,I
-        if (p>2 && !planes[2]) planes[2] = make_unique<Plane<ColorVal_intern_32>>(width, height, 0, scale); // B,Q
-        if (p>3 && !planes[3]) planes[3] = make_unique<Plane<ColorVal_intern_16u>>(width, height, 0, scale); // A
+        if (p>0 && !planes[0]) planes[0] = new_plane<ColorVal_intern_16u>(pool); // R,Y
+        if (p>1 && !planes[1]) planes[1] = new_plane<ColorVal_intern_32>(pool); // G,I
+        if (p>2 && !planes[2]) planes[2] = new_plane<ColorVal_intern_32>(pool); // B,Q
+        if (p>3 && !planes[3]) planes[3] = new_plane<ColorVal_intern_16u>(pool); // A
 #endif
       }
-      if (p>4 && !planes[4]) planes[4] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale); // FRA
+      if (p>4 && !planes[4]) planes[4] = new_plane<ColorVal_intern_8>(pool); // FRA
       }
       catch (std::bad_alloc& ba) {
         e_printf("Error: could not allocate enough memory for image buffer.\n");
@@ -749,11 +1077,69 @@ public:
       return true;
     }
 
+    // makes plane p (after semi_init) a view onto memory of the library user: value (r,c) is source[r*stride + c*step],
+    // which has to stay valid and unchanged for as long as the plane (or a clone of it) has not been written to
+    template <typename source_t>
+    void set_view(int p, const source_t *source, size_t stride, size_t step) {
+      assert(p>=0 && p<num && p<4);
+      if (depth <= 8) {
+        if (p==1 || p==2) planes[p] = make_unique<ViewPlane<ColorVal_intern_16, source_t>>(width, height, source, stride, step); // G,I / B,Q
+        else              planes[p] = make_unique<ViewPlane<ColorVal_intern_8, source_t>>(width, height, source, stride, step);  // R,Y / A
+#ifdef SUPPORT_HDR
+      } else {
+        if (p==1 || p==2) planes[p] = make_unique<ViewPlane<ColorVal_intern_32, source_t>>(width, height, source, stride, step);
+        else              planes[p] = make_unique<ViewPlane<ColorVal_intern_16u, source_t>>(width, height, source, stride, step);
+#endif
+      }
+    }
+
+    // replaces the views of set_view that something has written to (so they made a copy) by that copy
+    void release_view_copies() {
+      for (int p=0; p<num; p++) {
+        if (!planes[p]) continue;
+        std::unique_ptr<GeneralPlane> owned = planes[p]->release_copy();
+        if (owned) planes[p] = std::move(owned);
+      }
+    }
+
+    // see advise_mapped_buffer; only the buffers of this image, so other images that are being encoded or decoded
+    // at the same time keep their own access pattern
+    void advise_mapped_planes(bool interlaced) const {
+        for (int p=0; p<5; p++) if (planes[p]) planes[p]->advise_mapped(interlaced);
+    }
+
+    // moves the buffers of this image to the pool (for real_init of another image) and clears it
+    void recycle(PlanePool &pool) {
+        for (int p=0; p<5; p++) pool.add(std::move(planes[p]));
+        clear();
+    }
+
     // Copy constructor is private to avoid mistakes.
-    // This function can be used if copies are necessary.
-    Image clone() const
+    // This function can be used if copies are necessary (the planes come from pool if it is given, like in real_init).
+    Image clone(PlanePool *pool = nullptr) const
     {
-      return *this;
+      Image copy;
+      copy.copy_from(*this, pool);
+      return copy;
+    }
+
+    // copies the w x h block of other at (other_r, other_c) to (r, c); both images have the same planes and scale 0
+    void copy_block(const Image& other, size_t other_r, size_t other_c, size_t r, size_t c, size_t w, size_t h) {
+      assert(other.num == num && other_r + h <= other.height && other_c + w <= other.width);
+      for (int p = 0; p < num; p++) {
+          if (planes[p]->copy_block(*other.planes[p], other_r, other_c, r, c, w, h)) continue;
+          for (size_t y = 0; y < h; y++)
+             for (size_t x = 0; x < w; x++)
+                 planes[p]->set(r + y, c + x, other.planes[p]->get(other_r + y, other_c + x));
+      }
+    }
+
+    // a new image with a copy of the w x h block at (r, c) (without the metadata)
+    Image crop(size_t r, size_t c, uint32_t w, uint32_t h) const {
+      Image block(w, h, minval, maxval, num);
+      block.alpha_zero_special = alpha_zero_special;
+      block.copy_block(*this, r, c, 0, 0, w, h);
+      return block;
     }
     void normalize_scale() {
 //      v_printf(3,"%ix%i -> ",width,height);
@@ -799,11 +1185,11 @@ public:
         planes[3].reset(nullptr);
         num=3;
     }
-    void make_invisible_rgb_black() {
+    void make_invisible_rgb_black(PlanePool *pool = nullptr) {
         if (num<4) return;
-        undo_make_constant_plane(0);
-        undo_make_constant_plane(1);
-        undo_make_constant_plane(2);
+        undo_make_constant_plane(0, pool);
+        undo_make_constant_plane(1, pool);
+        undo_make_constant_plane(2, pool);
         for (size_t r=0; r<height; r++)
            for (size_t c=0; c<width; c++)
               if (operator()(3,r,c) == 0) {
@@ -829,10 +1215,10 @@ public:
       planes[p].reset(nullptr);
       planes[p] = make_unique<ConstantPlane>(val);
     }
-    void undo_make_constant_plane(const int p) {
+    void undo_make_constant_plane(const int p, PlanePool *pool = nullptr) {
       if (p>3 || p<0 || !planes[p]) return;
       if (p==1 && planes[p]->bytes_per_pixel() == 1) {
-        std::unique_ptr<GeneralPlane> newp1 = make_unique<Plane<ColorVal_intern_16>>(width, height, 0, scale); // G,I
+        std::unique_ptr<GeneralPlane> newp1 = new_plane<ColorVal_intern_16>(pool); // G,I
         for (size_t r=0; r<SCALED(height); r++)
           for (size_t c=0; c<SCALED(width); c++)
             newp1->set(r,c,planes[p]->get(r,c));
@@ -844,16 +1230,16 @@ public:
       ColorVal val = operator()(p,0,0);
       planes[p].reset(nullptr);
       if (depth <= 8) {
-        if (p==0) planes[0] = make_unique<Plane<ColorVal_intern_8>>(width, height, val, scale); // R,Y
-        if (p==1) planes[1] = make_unique<Plane<ColorVal_intern_16>>(width, height, val, scale); // G,I
-        if (p==2) planes[2] = make_unique<Plane<ColorVal_intern_16>>(width, height, val, scale); // B,Q
-        if (p==3) planes[3] = make_unique<Plane<ColorVal_intern_8>>(width, height, val, scale); // A
+        if (p==0) planes[0] = new_plane<ColorVal_intern_8>(pool, val); // R,Y
+        if (p==1) planes[1] = new_plane<ColorVal_intern_16>(pool, val); // G,I
+        if (p==2) planes[2] = new_plane<ColorVal_intern_16>(pool, val); // B,Q
+        if (p==3) planes[3] = new_plane<ColorVal_intern_8>(pool, val); // A
 #ifdef SUPPORT_HDR
       } else {
-        if (p==0) planes[0] = make_unique<Plane<ColorVal_intern_16u>>(width, height, val, scale); // R,Y
-        if (p==1) planes[1] = make_unique<Plane<ColorVal_intern_32>>(width, height, val, scale); // G,I
-        if (p==2) planes[2] = make_unique<Plane<ColorVal_intern_32>>(width, height, val, scale); // B,Q
-        if (p==3) planes[3] = make_unique<Plane<ColorVal_intern_16u>>(width, height, val, scale); // A
+        if (p==0) planes[0] = new_plane<ColorVal_intern_16u>(pool, val); // R,Y
+        if (p==1) planes[1] = new_plane<ColorVal_intern_32>(pool, val); // G,I
+        if (p==2) planes[2] = new_plane<ColorVal_intern_32>(pool, val); // B,Q
+        if (p==3) planes[3] = new_plane<ColorVal_intern_16u>(pool, val); // A
 #endif
       }
     }
@@ -884,7 +1270,8 @@ public:
     void ensure_frame_lookbacks() {
         if (num < 5) {
             ensure_alpha();
-            planes[4] = make_unique<Plane<ColorVal_intern_8>>(width, height, 0, scale);
+            // a decoder calls this before real_init, which allocates the plane (from its pool)
+            if (planes[0]) planes[4] = new_plane<ColorVal_intern_8>(nullptr);
             num=5;
         }
     }
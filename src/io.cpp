@@ -18,12 +18,14 @@ limitations under the License.
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <atomic>
 #ifdef _WIN32
 #include <io.h>
 #else
 #include <unistd.h>
 #endif
 
+#include "config.h"
 #include "io.hpp"
 
 void e_printf(const char *format, ...) {
@@ -34,40 +36,44 @@ void e_printf(const char *format, ...) {
     va_end(args);
 }
 
-#ifdef DEBUG
-static int verbosity = 10;
-#else
-static int verbosity = 1;
-#endif
-static FILE * my_stdout = stdout;
+// per thread, so that encodes and decodes with different verbosities can run at the same time (see VerbosityScope)
+static thread_local int verbosity = DEFAULT_VERBOSITY;
+// process-wide, atomic because encoders and decoders on other threads read it while printing
+static std::atomic<FILE *> my_stdout(stdout);
 void increase_verbosity(int how_much) {
     verbosity += how_much;
 }
 
+void set_verbosity(int v) {
+    verbosity = v;
+}
+
 int get_verbosity() {
     return verbosity;
 }
 
 void v_printf(const int v, const char *format, ...) {
     if (verbosity < v) return;
+    FILE *out = my_stdout;
     va_list args;
     va_start(args, format);
-    vfprintf(my_stdout, format, args);
-    fflush(my_stdout);
+    vfprintf(out, format, args);
+    fflush(out);
     va_end(args);
 }
 
 void v_printf_tty(const int v, const char *format, ...) {
     if (verbosity < v) return;
+    FILE *out = my_stdout;
 #ifdef _WIN32
-    if(!_isatty(_fileno(my_stdout))) return;
+    if(!_isatty(_fileno(out))) return;
 #else
-    if(!isatty(fileno(my_stdout))) return;
+    if(!isatty(fileno(out))) return;
 #endif
     va_list args;
     va_start(args, format);
-    vfprintf(my_stdout, format, args);
-    fflush(my_stdout);
+    vfprintf(out, format, args);
+    fflush(out);
     va_end(args);
 }
 
@@ -23,9 +23,20 @@ void v_printf(const int v, const char *format, ...);
 void v_printf_tty(const int v, const char *format, ...);
 void redirect_stdout_to_stderr();
 
+// the verbosity applies to the calling thread only
 void increase_verbosity(int how_much=1);
+void set_verbosity(int v);
 int get_verbosity();
 
+// sets the verbosity of the calling thread for the lifetime of the object (e.g. to flif_options::verbosity for
+// the duration of an encode or decode), and restores the previous one afterwards
+class VerbosityScope {
+    int previous;
+public:
+    explicit VerbosityScope(int v) : previous(get_verbosity()) { set_verbosity(v); }
+    ~VerbosityScope() { set_verbosity(previous); }
+};
+
 template<class IO>
 bool ioget_int_8bit (IO& io, int* result)
 {
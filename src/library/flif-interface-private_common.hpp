@@ -50,6 +50,7 @@ struct FLIF_IMAGE
     void read_row_GRAY16(uint32_t row, void* buffer, size_t buffer_size_bytes);
     void write_row_PALETTE8(uint32_t row, const void* buffer, size_t buffer_size_bytes);
     void read_row_PALETTE8(uint32_t row, void* buffer, size_t buffer_size_bytes);
+    bool read_into(void* pixels, size_t stride, size_t buffer_size_bytes, int32_t format);
 
     Image image;
 };
@@ -19,8 +19,10 @@ limitations under the License.
 #pragma once
 
 #include <stdio.h>
+#include <thread>
 
 #include "flif-interface-private_common.hpp"
+#include "flif_dec.h"
 #include "../flif-dec.hpp"
 
 struct FLIF_DECODER
@@ -30,24 +32,44 @@ struct FLIF_DECODER
     int32_t decode_file(const char* filename);
     int32_t decode_filepointer(FILE *file, const char* filename);
     int32_t decode_memory(const void* buffer, size_t buffer_size_bytes);
+    int32_t decode_memory_into(const void* buffer, size_t buffer_size_bytes, void* pixels, size_t stride, size_t pixels_size_bytes, int32_t format);
+    int32_t feed(const void* buffer, size_t buffer_size_bytes);
+    int32_t end_feed();
     int32_t abort();
     size_t num_images();
     int32_t num_loops();
     FLIF_IMAGE* get_image(size_t index);
+    FLIF_IMAGE* release_image(size_t index); // like get_image, but the caller owns the result
+    void set_reuse_buffers(bool reuse);
+    void set_allocator(const PlaneAllocator *allocator); // nullptr: the allocator of set_plane_allocator
 
     flif_options options;
     void* callback;
     void* user_data;
     int32_t first_quality;
     ~FLIF_DECODER() {
+        if (stream) {
+            abort();
+            stream->end_input();
+            stream_thread.join();
+        }
         // get rid of palettes
         if (internal_images.size()) internal_images[0].clear();
         if (images.size()) images[0].clear();
     }
 
 private:
+    void recycle_images();
+    int32_t feed_status();
+
+    PlanePool plane_pool;
+    bool reuse_buffers;
     Images internal_images;
     Images images;
     std::vector<std::unique_ptr<FLIF_IMAGE>> requested_images;
     bool working;
+    // incremental decoding: the decoder runs on stream_thread and waits in stream for the bytes that are fed
+    std::unique_ptr<StreamReader> stream;
+    std::thread stream_thread;
+    bool stream_ok;
 };
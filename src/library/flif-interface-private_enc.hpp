@@ -30,6 +30,7 @@ struct FLIF_ENCODER
     void set_alpha_zero_flags();
     int32_t encode_file(const char* filename);
     int32_t encode_memory(void** buffer, size_t* buffer_size_bytes);
+    int32_t train_forest(ManiacForest &forest);
 
     flif_options options;
 
@@ -44,3 +45,8 @@ private:
     void set_options(flif_options &options);
     std::vector<Image> images;
 };
+
+struct FLIF_FOREST
+{
+    ManiacForest forest;
+};
@@ -18,9 +18,15 @@ limitations under the License.
 
 #pragma once
 #include "flif-interface-private_common.hpp"
+#include "flif-interface_rows.hpp"
 
 FLIF_IMAGE::FLIF_IMAGE() { }
 
+static PlaneAllocator to_plane_allocator(const FLIF_ALLOCATOR &allocator) {
+    PlaneAllocator result = {allocator.allocate, allocator.release, allocator.arena};
+    return result;
+}
+
 #pragma pack(push,1)
 struct FLIF_RGB {
 	uint8_t r, g, b;
@@ -36,6 +42,7 @@ struct FLIF_RGBA16 {
 void FLIF_IMAGE::write_row_RGBA8(uint32_t row, const void* buffer, size_t buffer_size_bytes) {
     if(buffer_size_bytes < image.cols() * sizeof(FLIF_RGBA))
         return;
+    if (write_row_RGBA8_planes(image, row, reinterpret_cast<const uint8_t*>(buffer))) return;
 
     const FLIF_RGBA* buffer_rgba = reinterpret_cast<const FLIF_RGBA*>(buffer);
 
@@ -78,6 +85,7 @@ void FLIF_IMAGE::write_row_GRAY8(uint32_t row, const void * buffer, size_t buffe
 {
 	if (buffer_size_bytes < image.cols() * sizeof(uint8_t))
 		return;
+	if (write_row_GRAY8_planes(image, row, reinterpret_cast<const uint8_t*>(buffer))) return;
 
 	const uint8_t* buffer_gray = reinterpret_cast<const uint8_t*>(buffer);
 
@@ -103,6 +111,9 @@ void FLIF_IMAGE::write_row_GRAY16(uint32_t row, const void * buffer, size_t buff
 {
 	if (buffer_size_bytes < image.cols() * sizeof(uint16_t))
 		return;
+#ifdef SUPPORT_HDR
+	if (write_row_GRAY16_planes(image, row, reinterpret_cast<const uint16_t*>(buffer))) return;
+#endif
 
 	const uint16_t* buffer_gray = reinterpret_cast<const uint16_t*>(buffer);
 
@@ -151,6 +162,7 @@ void FLIF_IMAGE::read_row_RGBA8(uint32_t row, void* buffer, size_t buffer_size_b
     ColorVal m=image.max(0);
     while (m > 0xFF) { rshift++; m = m >> 1; } // in case the image has bit depth higher than 8
     if ((m != 0) && m < 0xFF) mult = 0xFF / m;
+    if (read_row_RGBA8_planes(image, row, reinterpret_cast<uint8_t*>(buffer), rshift, mult)) return;
     if (image.palette) {
       assert(image.numPlanes() >= 3);
       // always color
@@ -205,6 +217,7 @@ void FLIF_IMAGE::read_row_GRAY8(uint32_t row, void* buffer, size_t buffer_size_b
     ColorVal m=image.max(0);
     while (m > 0xFF) { rshift++; m = m >> 1; } // in case the image has bit depth higher than 8
     if ((m != 0) && m < 0xFF) mult = 0xFF / m;
+    if (read_row_GRAY8_planes(image, row, buffer_gray, rshift, mult)) return;
 
     for (size_t c = 0; c < (size_t) image.cols(); c++) {
             buffer_gray[c] = ((image(0, row, c) >> rshift) * mult) & 0xFF;
@@ -217,6 +230,9 @@ void FLIF_IMAGE::read_row_GRAY16(uint32_t row, void* buffer, size_t buffer_size_
     uint16_t* buffer_gray = reinterpret_cast<uint16_t*>(buffer);
     int rshift = 0;
     int mult = 1;
+#ifdef SUPPORT_HDR
+    if (read_row_GRAY16_planes(image, row, buffer_gray)) return;
+#endif
  
     for (size_t c = 0; c < (size_t) image.cols(); c++) {
             buffer_gray[c] = ((image(0, row, c) >> rshift) * mult);
@@ -238,6 +254,9 @@ void FLIF_IMAGE::read_row_PALETTE8(uint32_t row, void* buffer, size_t buffer_siz
 void FLIF_IMAGE::write_row_RGBA16(uint32_t row, const void* buffer, size_t buffer_size_bytes) {
     if(buffer_size_bytes < image.cols() * sizeof(FLIF_RGBA16))
         return;
+#ifdef SUPPORT_HDR
+    if (write_row_RGBA16_planes(image, row, reinterpret_cast<const uint16_t*>(buffer))) return;
+#endif
 
     const FLIF_RGBA16* buffer_rgba = reinterpret_cast<const FLIF_RGBA16*>(buffer);
 
@@ -265,6 +284,9 @@ void FLIF_IMAGE::read_row_RGBA16(uint32_t row, void* buffer, size_t buffer_size_
     ColorVal m=image.max(0);
     while (m > 0xFFFF) { rshift++; m = m >> 1; } // in the unlikely case that the image has bit depth higher than 16
     if ((m != 0) && m < 0xFFFF) mult = 0xFFFF / m;
+#ifdef SUPPORT_HDR
+    if (read_row_RGBA16_planes(image, row, reinterpret_cast<uint16_t*>(buffer), rshift, mult)) return;
+#endif
 
     if(image.numPlanes() >= 3) {
         // color
@@ -292,6 +314,122 @@ void FLIF_IMAGE::read_row_RGBA16(uint32_t row, void* buffer, size_t buffer_size_
     }
 }
 
+// copies one plane of a row into every step-th value of out, scaled like the read_row functions do
+template <typename out_t>
+struct plane_row_reader : public PlaneVisitor {
+    const size_t row, cols, step;
+    const int rshift, mult;
+    out_t *out;
+    plane_row_reader(size_t r, size_t w, out_t *o, size_t s, int rs, int m) : row(r), cols(w), step(s), rshift(rs), mult(m), out(o) {}
+    template <typename plane_t>
+    void read(const plane_t &plane) {
+        if (rshift == 0 && mult == 1) {
+            for (size_t c = 0; c < cols; c++) out[c * step] = plane.get(row, c);
+            return;
+        }
+        for (size_t c = 0; c < cols; c++) out[c * step] = (((ColorVal)plane.get(row, c)) >> rshift) * mult;
+    }
+    void visit(Plane<ColorVal_intern_8> &plane) override { read(plane); }
+    void visit(Plane<ColorVal_intern_16> &plane) override { read(plane); }
+#ifdef SUPPORT_HDR
+    void visit(Plane<ColorVal_intern_16u> &plane) override { read(plane); }
+    void visit(Plane<ColorVal_intern_32> &plane) override { read(plane); }
+#endif
+    bool visit_view(const GeneralPlane &plane) override { read(plane); return true; }
+};
+
+// the bytes per pixel of a FLIF_PIXEL_FORMAT, 0 if the format is unknown
+static size_t pixel_format_bytes(int32_t format) {
+    switch (format) {
+        case FLIF_PIXEL_RGBA8:
+        case FLIF_PIXEL_BGRA8:  return 4;
+        case FLIF_PIXEL_RGB8:   return 3;
+        case FLIF_PIXEL_GRAY8:  return 1;
+        case FLIF_PIXEL_RGBA16: return 8;
+        default: return 0;
+    }
+}
+
+// whether pixels (rows stride bytes apart, buffer_size_bytes in total) can hold the image in the given format
+static bool image_fits_into(const Image &image, size_t stride, size_t buffer_size_bytes, int32_t format) {
+    const size_t cols = image.cols(), rows = image.rows(), row_bytes = cols * pixel_format_bytes(format);
+    if (!row_bytes || stride < row_bytes) return false;
+    return !rows || buffer_size_bytes >= (rows - 1) * stride + row_bytes;
+}
+
+// writes the rows [begin, end) of the image to pixels (rows stride bytes apart, which image_fits_into has checked),
+// one plane at a time, with the same conversions as the read_row functions
+template <typename out_t>
+static void read_rows_into(Image &image, void* pixels, size_t stride, const int offsets[4], size_t channels, uint32_t begin, uint32_t end) {
+    const size_t cols = image.cols();
+    const int out_max = (out_t)~0;
+    int rshift = 0;
+    int mult = 1;
+    int m = image.max(0);
+    while (m > out_max) { rshift++; m = m >> 1; } // in case the image has a higher bit depth than the format
+    if ((m != 0) && m < out_max) mult = out_max / m;
+
+    const bool color = image.numPlanes() >= 3, alpha = image.numPlanes() >= 4;
+    for (size_t r = begin; r < end; r++) {
+        out_t *row = reinterpret_cast<out_t*>(static_cast<uint8_t*>(pixels) + r * stride);
+        for (size_t k = 0; k < channels; k++) {
+            out_t *out = row + offsets[k];
+            if (k == 3 && !alpha) {
+                for (size_t c = 0; c < cols; c++) out[c * channels] = out_max;  // fully opaque
+                continue;
+            }
+            if (image.palette) {
+                assert(image.numPlanes() >= 3);
+                for (size_t c = 0; c < cols; c++)
+                    out[c * channels] = ((image.palette_image->operator()(k, 0, image(1, r, c)) >> rshift) * mult);
+                continue;
+            }
+            GeneralPlane &plane = image.getPlane(color ? k : 0);
+            if (plane.is_constant()) {
+                const out_t value = (plane.get(0, 0) >> rshift) * mult;
+                for (size_t c = 0; c < cols; c++) out[c * channels] = value;
+                continue;
+            }
+            plane_row_reader<out_t> reader(r, cols, out, channels, rshift, mult);
+            plane.accept_visitor(reader);
+        }
+    }
+}
+
+// RGBA8 with the whole-row conversion of read_row_RGBA8, if it can handle this image (then it can handle every row)
+static bool read_rows_into_RGBA8_planes(Image &image, void* pixels, size_t stride, uint32_t begin, uint32_t end) {
+    int rshift = 0;
+    int mult = 1;
+    ColorVal m=image.max(0);
+    while (m > 0xFF) { rshift++; m = m >> 1; }
+    if ((m != 0) && m < 0xFF) mult = 0xFF / m;
+    for (size_t r = begin; r < end; r++) {
+        if (!read_row_RGBA8_planes(image, r, static_cast<uint8_t*>(pixels) + r * stride, rshift, mult)) return false;
+    }
+    return true;
+}
+
+// writes the rows [begin, end) of the image to pixels in the given FLIF_PIXEL_FORMAT
+static void read_image_rows_into(Image &image, void* pixels, size_t stride, int32_t format, uint32_t begin, uint32_t end) {
+    static const int rgba[4] = {0, 1, 2, 3}, bgra[4] = {2, 1, 0, 3};
+    if (begin >= end) return;
+    switch (format) {
+        case FLIF_PIXEL_RGBA8:  if (!read_rows_into_RGBA8_planes(image, pixels, stride, begin, end))
+                                    read_rows_into<uint8_t>(image, pixels, stride, rgba, 4, begin, end);
+                                break;
+        case FLIF_PIXEL_RGB8:   read_rows_into<uint8_t>(image, pixels, stride, rgba, 3, begin, end); break;
+        case FLIF_PIXEL_BGRA8:  read_rows_into<uint8_t>(image, pixels, stride, bgra, 4, begin, end); break;
+        case FLIF_PIXEL_GRAY8:  read_rows_into<uint8_t>(image, pixels, stride, rgba, 1, begin, end); break;
+        case FLIF_PIXEL_RGBA16: read_rows_into<uint16_t>(image, pixels, stride, rgba, 4, begin, end); break;
+    }
+}
+
+bool FLIF_IMAGE::read_into(void* pixels, size_t stride, size_t buffer_size_bytes, int32_t format) {
+    if (!image_fits_into(image, stride, buffer_size_bytes, format)) return false;
+    read_image_rows_into(image, pixels, stride, format, 0, image.rows());
+    return true;
+}
+
 //=============================================================================
 
 /*!
@@ -484,6 +622,39 @@ FLIF_DLLIMPORT FLIF_IMAGE* FLIF_API flif_import_image_PALETTE(uint32_t width, ui
 	return 0;
 }
 
+FLIF_DLLEXPORT FLIF_IMAGE* FLIF_API flif_import_image_view(uint32_t width, uint32_t height, const void* pixels, size_t stride, int32_t format) {
+    try
+    {
+        static const int rgba[4] = {0, 1, 2, 3}, bgra[4] = {2, 1, 0, 3};
+        const int *offsets = rgba;
+        int number_components = 4, number_planes = 4;
+        size_t component_size = 1;
+        switch (format) {
+            case FLIF_PIXEL_RGBA8: break;
+            case FLIF_PIXEL_RGB8: number_components = number_planes = 3; break;
+            case FLIF_PIXEL_BGRA8: offsets = bgra; break;
+            case FLIF_PIXEL_GRAY8: number_components = number_planes = 1; break;
+#ifdef SUPPORT_HDR
+            case FLIF_PIXEL_RGBA16: component_size = 2; break;
+#endif
+            default: return 0;
+        }
+        if (width == 0 || height == 0 || stride < width*number_components*component_size || stride % component_size)
+            return 0;
+        std::unique_ptr<FLIF_IMAGE> image(new FLIF_IMAGE());
+        if (!image->image.semi_init(width, height, 0, (component_size == 1 ? 255 : 65535), number_planes)) return 0;
+        for (int p = 0; p < number_planes; p++) {
+            if (component_size == 1)
+                image->image.set_view(p, static_cast<const uint8_t*>(pixels) + offsets[p], stride, number_components);
+            else
+                image->image.set_view(p, static_cast<const uint16_t*>(pixels) + offsets[p], stride / 2, number_components);
+        }
+        return image.release();
+    }
+    catch (...) {}
+    return 0;
+}
+
 FLIF_DLLEXPORT void FLIF_API flif_destroy_image(FLIF_IMAGE* image) {
     // delete should never let exceptions out
     delete image;
@@ -699,8 +870,35 @@ FLIF_DLLEXPORT void FLIF_API flif_image_read_row_RGBA16(FLIF_IMAGE* image, uint3
     catch(...) {}
 }
 
+FLIF_DLLEXPORT int32_t FLIF_API flif_image_read_into(FLIF_IMAGE* image, void* pixels, size_t stride, size_t buffer_size_bytes, int32_t format) {
+    try
+    {
+        return image->read_into(pixels, stride, buffer_size_bytes, format);
+    }
+    catch(...) {}
+    return 0;
+}
+
 FLIF_DLLEXPORT void FLIF_API flif_free_memory(void* buffer) {
     delete [] reinterpret_cast<uint8_t*>(buffer);
 }
 
+FLIF_DLLEXPORT void FLIF_API flif_set_allocator(const FLIF_ALLOCATOR* allocator) {
+    if (!allocator) {
+        set_plane_allocator(nullptr);
+        return;
+    }
+    PlaneAllocator plane_allocator = to_plane_allocator(*allocator);
+    set_plane_allocator(&plane_allocator);
+}
+
+FLIF_DLLEXPORT int32_t FLIF_API flif_set_out_of_core(size_t ram_budget_bytes, const char* directory) {
+    try
+    {
+        return set_mapped_plane_allocator(ram_budget_bytes, directory) ? 1 : 0;
+    }
+    catch(...) {}
+    return 0;
+}
+
 } // extern "C"
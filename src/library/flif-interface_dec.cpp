@@ -21,18 +21,24 @@ limitations under the License.
 #include "flif-interface-private_dec.hpp"
 #include "flif-interface_common.cpp"
 
+#include <algorithm>
 #include <functional>
+#include <atomic>
+#include <thread>
 
 FLIF_DECODER::FLIF_DECODER()
 : options(FLIF_DEFAULT_OPTIONS)
 , callback(NULL)
 , user_data(NULL)
 , first_quality(0)
+, reuse_buffers(false)
 , working(false)
-{ options.crc_check = 0; options.keep_palette = 1; }
+, stream_ok(false)
+{ options.crc_check = 0; options.keep_palette = 1; options.plane_pool = &plane_pool; }
 
 
 int32_t FLIF_DECODER::decode_file(const char* filename) {
+    if (stream) return 0; // an incremental decode is going on (see feed)
     FILE *file = fopen(filename,"rb");
     if(!file)
         return 0;
@@ -41,6 +47,8 @@ int32_t FLIF_DECODER::decode_file(const char* filename) {
 }
 
 int32_t FLIF_DECODER::decode_filepointer(FILE *file, const char *filename) {
+    if (stream) return 0;
+    recycle_images();
     internal_images.clear();
     images.clear();
 
@@ -52,9 +60,10 @@ int32_t FLIF_DECODER::decode_filepointer(FILE *file, const char *filename) {
          true, // exif
          true, // xmp
     };
-    if(!flif_decode(fio, internal_images, reinterpret_cast<callback_t>(callback), user_data, first_quality, images, options, md_default, 0))
-        { working = false; return 0; }
+    bool ok = flif_decode(fio, internal_images, reinterpret_cast<callback_t>(callback), user_data, first_quality, images, options, md_default, 0);
     working = false;
+    plane_pool.clear();
+    if (!ok) return 0;
 
     images.clear();
     for (Image& image : internal_images) images.emplace_back(std::move(image));
@@ -63,6 +72,8 @@ int32_t FLIF_DECODER::decode_filepointer(FILE *file, const char *filename) {
 }
 
 int32_t FLIF_DECODER::decode_memory(const void* buffer, size_t buffer_size_bytes) {
+    if (stream) return 0;
+    recycle_images();
     internal_images.clear();
     images.clear();
 
@@ -74,18 +85,123 @@ int32_t FLIF_DECODER::decode_memory(const void* buffer, size_t buffer_size_bytes
 		true, // exif
 		true, // xmp
     };
-    if(!flif_decode(reader, internal_images, reinterpret_cast<callback_t>(callback), user_data, first_quality, images, options, md_default, 0))
-        { working = false; return 0; }
+    bool ok = flif_decode(reader, internal_images, reinterpret_cast<callback_t>(callback), user_data, first_quality, images, options, md_default, 0);
     working = false;
+    plane_pool.clear();
+    if (!ok) return 0;
 
     images.clear();
     for (Image& image : internal_images) images.emplace_back(std::move(image));
     return 1;
 }
 
+// packs the rows of the decoded image into the caller's pixels while the decoder finishes them
+class PixelsRowOutput : public RowOutput {
+    void* pixels;
+    const size_t stride, size_bytes;
+    const int32_t format;
+public:
+    bool checked = false, fits = false;
+    PixelsRowOutput(void* p, size_t s, size_t size, int32_t f) : pixels(p), stride(s), size_bytes(size), format(f) {}
+    void rows(Image &image, uint32_t begin, uint32_t end) override {
+        if (!checked) { fits = image_fits_into(image, stride, size_bytes, format); checked = true; }
+        if (fits) read_image_rows_into(image, pixels, stride, format, begin, end);
+    }
+};
+
+int32_t FLIF_DECODER::decode_memory_into(const void* buffer, size_t buffer_size_bytes, void* pixels, size_t stride, size_t pixels_size_bytes, int32_t format) {
+    if (stream) return 0;
+    PixelsRowOutput output(pixels, stride, pixels_size_bytes, format);
+    options.row_output = &output;
+    int32_t decoded;
+    try {
+        decoded = decode_memory(buffer, buffer_size_bytes);
+    } catch (...) {
+        options.row_output = nullptr;
+        throw;
+    }
+    options.row_output = nullptr;
+    bool ok = decoded && !images.empty() && output.fits;
+    // the pixels are where the caller wants them, so the buffers can go right away (or back to plane_pool)
+    recycle_images();
+    images.clear();
+    internal_images.clear();
+    return ok;
+}
+
+// The first feed starts decoding on a thread of its own, which reads from stream: when the decoder needs bytes that
+// haven't been fed yet, it waits right there (in the middle of the range coder if need be) until they are fed.
+// Every feed returns once the decoder has used all bytes so far, so progressive callbacks happen during the feed calls.
+// The decode keeps the options and callback of the first feed, whatever the caller sets in between.
+int32_t FLIF_DECODER::feed(const void* buffer, size_t buffer_size_bytes) {
+    if (!stream) {
+        recycle_images();
+        internal_images.clear();
+        images.clear();
+        stream.reset(new StreamReader());
+        working = true;
+        flif_options stream_options = options;
+        callback_t stream_callback = reinterpret_cast<callback_t>(callback);
+        void *stream_user_data = user_data;
+        int32_t stream_first_quality = first_quality;
+        stream_thread = std::thread([this, stream_options, stream_callback, stream_user_data, stream_first_quality]() mutable {
+            metadata_options md_default = {
+                true, // icc
+                true, // exif
+                true, // xmp
+            };
+            try {
+                stream_ok = flif_decode(*stream, internal_images, stream_callback, stream_user_data, stream_first_quality, images, stream_options, md_default, 0);
+            } catch (...) {
+                stream_ok = false;
+            }
+            stream->done_reading();
+        });
+    }
+    stream->add(reinterpret_cast<const uint8_t*>(buffer), buffer_size_bytes);
+    return feed_status();
+}
+
+int32_t FLIF_DECODER::end_feed() {
+    if (!stream) return FLIF_FEED_ERROR;
+    stream->end_input();
+    return feed_status();
+}
+
+int32_t FLIF_DECODER::feed_status() {
+    if (stream->wait_until_idle()) return FLIF_FEED_NEED_MORE;
+    stream_thread.join();
+    stream.reset();
+    working = false;
+    plane_pool.clear();
+    if (!stream_ok) return FLIF_FEED_ERROR;
+
+    images.clear();
+    for (Image& image : internal_images) images.emplace_back(std::move(image));
+    return FLIF_FEED_DONE;
+}
+
+// with buffer reuse, the buffers of the previous decode (including the images returned by get_image) go to plane_pool
+void FLIF_DECODER::recycle_images() {
+    if (!reuse_buffers) return;
+    for (Image& image : internal_images) image.recycle(plane_pool);
+    for (Image& image : images) image.recycle(plane_pool);
+    for (std::unique_ptr<FLIF_IMAGE>& image : requested_images) if (image) image->image.recycle(plane_pool);
+}
+
+void FLIF_DECODER::set_reuse_buffers(bool reuse) {
+    reuse_buffers = reuse;
+}
+
+void FLIF_DECODER::set_allocator(const PlaneAllocator *allocator) {
+    plane_pool.set_allocator(allocator);
+}
+
 int32_t FLIF_DECODER::abort() {
       if (working) {
         if (images.size() > 0) images[0].abort_decoding();
+        // a decoder that waits for more input gets the end of it instead
+        if (stream) stream->end_input();
         return 1;
       } else return 0;
 }
@@ -104,11 +220,36 @@ FLIF_IMAGE* FLIF_DECODER::get_image(size_t index) {
     if(index >= requested_images.size()) requested_images.resize(images.size());
     if (!requested_images[index].get()) requested_images[index].reset( new FLIF_IMAGE());
     if (images[index].rows() || images[index].metadata.size() > 0) {
+        // a progressive preview replaces the previous one, whose buffers can be used for the next preview
+        if (working) requested_images[index]->image.recycle(plane_pool);
         requested_images[index]->image = std::move(images[index]); // moves and invalidates images[index]
     }
     return requested_images[index].get();
 }
 
+FLIF_IMAGE* FLIF_DECODER::release_image(size_t index) {
+    if (!get_image(index)) return 0;
+    return requested_images[index].release();
+}
+
+// decodes one item of flif_decode_batch into images (all frames); returns false if it could not be decoded
+static bool decode_batch_item(const FLIF_BATCH_ITEM &item, std::vector<std::unique_ptr<FLIF_IMAGE>> &images) {
+    FLIF_DECODER decoder;
+    if (item.scale) decoder.options.scale = item.scale;
+    if (item.quality) decoder.options.quality = item.quality;
+    if (item.fit_width && item.fit_height) {
+        decoder.options.resize_width = item.fit_width;
+        decoder.options.resize_height = item.fit_height;
+        decoder.options.fit = 1;
+    }
+    int32_t ok = 0;
+    if (item.buffer) ok = decoder.decode_memory(item.buffer, item.buffer_size_bytes);
+    else if (item.filename) ok = decoder.decode_file(item.filename);
+    if (!ok) return false;
+    for (size_t i = 0; i < decoder.num_images(); i++) images.emplace_back(decoder.release_image(i));
+    return true;
+}
+
 
 //=============================================================================
 
@@ -184,6 +325,27 @@ FLIF_DLLEXPORT void FLIF_API flif_decoder_set_fit(FLIF_DECODER* decoder, uint32_
     decoder->options.fit = 1;
 }
 
+FLIF_DLLEXPORT void FLIF_API flif_decoder_set_threads(FLIF_DECODER* decoder, int32_t threads) {
+    decoder->options.threads = (threads < 1 ? 1 : threads);
+}
+
+FLIF_DLLEXPORT void FLIF_API flif_decoder_set_verbosity(FLIF_DECODER* decoder, int32_t verbosity) {
+    decoder->options.verbosity = verbosity;
+}
+
+FLIF_DLLEXPORT void FLIF_API flif_decoder_set_reuse_buffers(FLIF_DECODER* decoder, int32_t reuse) {
+    decoder->set_reuse_buffers(reuse);
+}
+
+FLIF_DLLEXPORT void FLIF_API flif_decoder_set_allocator(FLIF_DECODER* decoder, const FLIF_ALLOCATOR* allocator) {
+    if (!allocator) {
+        decoder->set_allocator(nullptr);
+        return;
+    }
+    PlaneAllocator plane_allocator = to_plane_allocator(*allocator);
+    decoder->set_allocator(&plane_allocator);
+}
+
 FLIF_DLLEXPORT void FLIF_API flif_decoder_set_callback(FLIF_DECODER* decoder, callback_t callback, void *user_data) {
     try
     {
@@ -240,6 +402,34 @@ FLIF_DLLEXPORT int32_t FLIF_API flif_decoder_decode_memory(FLIF_DECODER* decoder
     return 0;
 }
 
+FLIF_DLLEXPORT int32_t FLIF_API flif_decoder_feed(FLIF_DECODER* decoder, const void* buffer, size_t buffer_size_bytes) {
+    try
+    {
+        return decoder->feed(buffer, buffer_size_bytes);
+    }
+    catch(...) {}
+    return FLIF_FEED_ERROR;
+}
+
+FLIF_DLLEXPORT int32_t FLIF_API flif_decoder_end_feed(FLIF_DECODER* decoder) {
+    try
+    {
+        return decoder->end_feed();
+    }
+    catch(...) {}
+    return FLIF_FEED_ERROR;
+}
+
+FLIF_DLLEXPORT int32_t FLIF_API flif_decoder_decode_memory_into(FLIF_DECODER* decoder, const void* buffer, size_t buffer_size_bytes,
+                                                                void* pixels, size_t stride, size_t pixels_size_bytes, int32_t format) {
+    try
+    {
+        return decoder->decode_memory_into(buffer, buffer_size_bytes, pixels, stride, pixels_size_bytes, format);
+    }
+    catch(...) {}
+    return 0;
+}
+
 FLIF_DLLEXPORT size_t FLIF_API flif_decoder_num_images(FLIF_DECODER* decoder) {
     try
     {
@@ -277,6 +467,44 @@ FLIF_DLLEXPORT void FLIF_API flif_decoder_generate_preview(void *context) {
 }
 
 
+/*!
+* Items are handed out one at a time from a shared counter, so a thread that gets small images just takes more of them.
+* \return the number of items that were decoded successfully
+*/
+FLIF_DLLEXPORT size_t FLIF_API flif_decode_batch(const FLIF_BATCH_ITEM* items, size_t num_items, int32_t threads, batch_callback_t callback, void *user_data) {
+    std::atomic<size_t> next_item(0);
+    std::atomic<size_t> decoded(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next_item++) < num_items) {
+            try
+            {
+                std::vector<std::unique_ptr<FLIF_IMAGE>> images;
+                bool ok = false;
+                try { ok = decode_batch_item(items[i], images); } catch(...) {}
+                if (!ok) images.clear();
+                else decoded++;
+                if (!callback) continue;
+                std::vector<FLIF_IMAGE*> released;
+                released.reserve(images.size());
+                for (std::unique_ptr<FLIF_IMAGE> &image : images) released.push_back(image.release());
+                callback(i, ok, released.data(), released.size(), user_data);
+            }
+            catch(...) {}
+        }
+    };
+    if (threads <= 0) threads = std::thread::hardware_concurrency();
+    std::vector<std::thread> pool;
+    try
+    {
+        for (size_t t = 1; t < std::min((size_t)threads, num_items); t++) pool.emplace_back(worker);
+    }
+    catch(...) {} // could not start more threads, decode with the ones we have
+    worker();
+    for (std::thread &t : pool) t.join();
+    return decoded;
+}
+
 FLIF_DLLEXPORT FLIF_INFO* FLIF_API flif_read_info_from_memory(const void* buffer, size_t buffer_size_bytes) {
     try
     {
@@ -358,5 +586,43 @@ FLIF_DLLEXPORT size_t FLIF_API flif_info_num_images(FLIF_INFO* info) {
     return 0;
 }
 
+FLIF_DLLEXPORT size_t FLIF_API flif_info_num_zoomlevel_offsets(FLIF_INFO* info) {
+    try
+    {
+        return info->zoomlevel_offsets.size();
+    }
+    catch(...) {}
+    return 0;
+}
+
+FLIF_DLLEXPORT int32_t FLIF_API flif_info_get_zoomlevel_offset(FLIF_INFO* info, size_t i, int32_t* plane, int32_t* zoomlevel, uint64_t* offset) {
+    try
+    {
+        if (i >= info->zoomlevel_offsets.size()) return 0;
+        const ZoomlevelOffset &step = info->zoomlevel_offsets[i];
+        if (plane) *plane = step.plane;
+        if (zoomlevel) *zoomlevel = step.zoomlevel;
+        if (offset) *offset = step.end;
+        return 1;
+    }
+    catch(...) {}
+    return 0;
+}
+
+FLIF_DLLEXPORT uint64_t FLIF_API flif_info_get_bytes_for_scale(FLIF_INFO* info, uint32_t scale) {
+    try
+    {
+        const std::vector<ZoomlevelOffset> &steps = info->zoomlevel_offsets;
+        if (steps.empty()) return 0;
+        // the decoder stops at the first step of a zoomlevel that is finer than the scale
+        for (size_t i = 1; i < steps.size(); i++) {
+            if ((1u << (steps[i].zoomlevel / 2)) < scale) return steps[i-1].end;
+        }
+        return steps.back().end;
+    }
+    catch(...) {}
+    return 0;
+}
+
 
 } // extern "C"
@@ -48,7 +48,8 @@ void FLIF_ENCODER::transformations(std::vector<std::string> &desc) {
     uint64_t nb_pixels = (uint64_t)images[0].rows() * images[0].cols();
     if (options.method.o == Optional::undefined) {
         // no method specified, pick one heuristically
-        if (nb_pixels * images.size() < 10000) options.method.encoding=flifEncoding::nonInterlaced; // if the image is small, not much point in doing interlacing
+        if (options.plane_streams) options.method.encoding=flifEncoding::nonInterlaced; // plane streams imply non-interlaced
+        else if (nb_pixels * images.size() < 10000) options.method.encoding=flifEncoding::nonInterlaced; // if the image is small, not much point in doing interlacing
         else options.method.encoding=flifEncoding::interlaced; // default method: interlacing
     }
     if (images[0].palette) {
@@ -111,6 +112,25 @@ int32_t FLIF_ENCODER::encode_memory(void** buffer, size_t* buffer_size_bytes) {
     return 1;
 }
 
+/*!
+* \return non-zero if the function succeeded
+*/
+int32_t FLIF_ENCODER::train_forest(ManiacForest &forest) {
+    if (forest.trained()) return 0;
+    BlobIO io; // only the learned trees are needed, not the encoded image
+
+    std::vector<std::string> desc;
+    transformations(desc);
+
+    flif_options train_options = options;
+    train_options.forest = &forest;
+    train_options.train_forest = 1;
+    if(!flif_encode(io, images, desc, train_options))
+        return 0;
+
+    return 1;
+}
+
 //=============================================================================
 
 /*!
@@ -152,6 +172,10 @@ FLIF_DLLEXPORT void FLIF_API flif_encoder_set_learn_repeat(FLIF_ENCODER* encoder
     if (learn_repeats < 100) encoder->options.learn_repeats = learn_repeats;
 }
 
+FLIF_DLLEXPORT void FLIF_API flif_encoder_set_learn_sample(FLIF_ENCODER* encoder, uint32_t learn_sample) {
+    if (learn_sample >= 1 && learn_sample <= 64) encoder->options.learn_sample = learn_sample;
+}
+
 FLIF_DLLEXPORT void FLIF_API flif_encoder_set_auto_color_buckets(FLIF_ENCODER* encoder, uint32_t acb) {
     encoder->options.acb = acb;
 }
@@ -207,6 +231,37 @@ FLIF_DLLEXPORT void FLIF_API flif_encoder_set_chance_cutoff(FLIF_ENCODER* encode
 FLIF_DLLEXPORT void FLIF_API flif_encoder_set_chance_alpha(FLIF_ENCODER* encoder, int32_t alpha) {
     encoder->options.alpha = alpha;
 }
+FLIF_DLLEXPORT void FLIF_API flif_encoder_set_rans(FLIF_ENCODER* encoder, uint32_t rans) {
+    encoder->options.rans = rans;
+}
+FLIF_DLLEXPORT void FLIF_API flif_encoder_set_threads(FLIF_ENCODER* encoder, int32_t threads) {
+    encoder->options.threads = (threads < 1 ? 1 : threads);
+}
+FLIF_DLLEXPORT void FLIF_API flif_encoder_set_verbosity(FLIF_ENCODER* encoder, int32_t verbosity) {
+    encoder->options.verbosity = verbosity;
+}
+FLIF_DLLEXPORT void FLIF_API flif_encoder_set_tile_size(FLIF_ENCODER* encoder, int32_t tile_size) {
+    encoder->options.tile_size = (tile_size < 0 ? 0 : tile_size);
+}
+FLIF_DLLEXPORT void FLIF_API flif_encoder_set_plane_streams(FLIF_ENCODER* encoder, uint32_t plane_streams) {
+    encoder->options.plane_streams = plane_streams;
+}
+FLIF_DLLEXPORT void FLIF_API flif_encoder_set_zoomlevel_index(FLIF_ENCODER* encoder, uint32_t zoomlevel_index) {
+    encoder->options.zoomlevel_index = zoomlevel_index;
+}
+
+FLIF_DLLEXPORT int32_t FLIF_API flif_encoder_set_forest(FLIF_ENCODER* encoder, FLIF_FOREST* forest) {
+    try {
+        if (forest) {
+            forest->forest.finish();
+            if (!forest->forest.trained()) return 0;
+        }
+        encoder->options.forest = (forest ? &forest->forest : nullptr);
+        return 1;
+    }
+    catch(...) {}
+    return 0;
+}
 
 FLIF_DLLEXPORT void FLIF_API flif_encoder_add_image(FLIF_ENCODER* encoder, FLIF_IMAGE* image) {
     try { encoder->add_image(image); }
@@ -241,6 +296,57 @@ FLIF_DLLEXPORT int32_t FLIF_API flif_encoder_encode_memory(FLIF_ENCODER* encoder
     return 0;
 }
 
+FLIF_DLLEXPORT FLIF_FOREST* FLIF_API flif_create_forest() {
+    try
+    {
+        std::unique_ptr<FLIF_FOREST> forest(new FLIF_FOREST());
+        return forest.release();
+    }
+    catch(...) {}
+    return 0;
+}
+
+FLIF_DLLEXPORT void FLIF_API flif_destroy_forest(FLIF_FOREST* forest) {
+    // delete should never let exceptions out
+    delete forest;
+}
+
+/*!
+* \return non-zero if the function succeeded
+*/
+FLIF_DLLEXPORT int32_t FLIF_API flif_forest_load(FLIF_FOREST* forest, const char* filename) {
+    try
+    {
+        return forest->forest.load(filename);
+    }
+    catch(...) {}
+    return 0;
+}
+
+/*!
+* \return non-zero if the function succeeded
+*/
+FLIF_DLLEXPORT int32_t FLIF_API flif_forest_save(FLIF_FOREST* forest, const char* filename) {
+    try
+    {
+        return forest->forest.save(filename);
+    }
+    catch(...) {}
+    return 0;
+}
+
+/*!
+* \return non-zero if the function succeeded
+*/
+FLIF_DLLEXPORT int32_t FLIF_API flif_encoder_train_forest(FLIF_ENCODER* encoder, FLIF_FOREST* forest) {
+    try
+    {
+        return encoder->train_forest(forest->forest);
+    }
+    catch(...) {}
+    return 0;
+}
+
 
 } // extern "C"
 
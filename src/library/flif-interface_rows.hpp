@@ -0,0 +1,253 @@
+/*
+FLIF - Free Lossless Image Format
+
+Copyright 2010-2016, Jon Sneyers & Pieter Wuille
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "../image/image.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLIF_ROWS_SSE2
+#endif
+
+// Whole-row conversions between interleaved pixel buffers and the Plane<pixel_t> buffers of an image, for the
+// read_row/write_row functions of FLIF_IMAGE. They handle the plane layouts of Image::init and of decoded images
+// (and return false for anything else, e.g. views or constant color planes, which the per-pixel code then handles).
+
+// plane p if it is a Plane<pixel_t> with the size of the image, nullptr otherwise
+template <typename pixel_t>
+static inline Plane<pixel_t>* typed_plane(Image &image, int p) {
+    if (image.getscale() != 0) return nullptr;
+    return dynamic_cast<Plane<pixel_t>*>(&image.getPlane(p));
+}
+
+// alpha of a decoded image: a Plane<pixel_t> (*plane) or a constant (*value); false if it is neither
+template <typename pixel_t>
+static inline bool alpha_plane(Image &image, const pixel_t* &plane, pixel_t &value, uint32_t row) {
+    plane = nullptr;
+    if (image.numPlanes() < 4) return true;
+    GeneralPlane &alpha = image.getPlane(3);
+    if (alpha.is_constant()) {
+        value = alpha.get(0, 0);
+        return true;
+    }
+    Plane<pixel_t> *typed = typed_plane<pixel_t>(image, 3);
+    if (!typed) return false;
+    plane = typed->row_data(row);
+    return true;
+}
+
+static void interleave_RGBA8(const uint8_t *r, const int16_t *g, const int16_t *b, const uint8_t *a, uint8_t alpha, uint8_t *out, size_t n) {
+    size_t c = 0;
+#ifdef FLIF_ROWS_SSE2
+    const __m128i opaque = _mm_set1_epi8((char)alpha);
+    for (; c + 16 <= n; c += 16) {
+        const __m128i R = _mm_loadu_si128((const __m128i*)(r + c));
+        const __m128i G = _mm_packus_epi16(_mm_loadu_si128((const __m128i*)(g + c)), _mm_loadu_si128((const __m128i*)(g + c + 8)));
+        const __m128i B = _mm_packus_epi16(_mm_loadu_si128((const __m128i*)(b + c)), _mm_loadu_si128((const __m128i*)(b + c + 8)));
+        const __m128i A = (a ? _mm_loadu_si128((const __m128i*)(a + c)) : opaque);
+        const __m128i RG_lo = _mm_unpacklo_epi8(R, G), RG_hi = _mm_unpackhi_epi8(R, G);
+        const __m128i BA_lo = _mm_unpacklo_epi8(B, A), BA_hi = _mm_unpackhi_epi8(B, A);
+        _mm_storeu_si128((__m128i*)(out + 4*c), _mm_unpacklo_epi16(RG_lo, BA_lo));
+        _mm_storeu_si128((__m128i*)(out + 4*c + 16), _mm_unpackhi_epi16(RG_lo, BA_lo));
+        _mm_storeu_si128((__m128i*)(out + 4*c + 32), _mm_unpacklo_epi16(RG_hi, BA_hi));
+        _mm_storeu_si128((__m128i*)(out + 4*c + 48), _mm_unpackhi_epi16(RG_hi, BA_hi));
+    }
+#endif
+    for (; c < n; c++) {
+        out[4*c] = r[c];
+        out[4*c+1] = g[c];
+        out[4*c+2] = b[c];
+        out[4*c+3] = (a ? a[c] : alpha);
+    }
+}
+
+static void deinterleave_RGBA8(const uint8_t *in, uint8_t *r, int16_t *g, int16_t *b, uint8_t *a, size_t n) {
+    size_t c = 0;
+#ifdef FLIF_ROWS_SSE2
+    const __m128i low_byte = _mm_set1_epi32(0xFF);
+    for (; c + 16 <= n; c += 16) {
+        __m128i p[4], R[4], G[4], B[4], A[4];
+        for (int i = 0; i < 4; i++) {
+            p[i] = _mm_loadu_si128((const __m128i*)(in + 4*c + 16*i)); // 4 pixels, one per 32-bit lane
+            R[i] = _mm_and_si128(p[i], low_byte);
+            G[i] = _mm_and_si128(_mm_srli_epi32(p[i], 8), low_byte);
+            B[i] = _mm_and_si128(_mm_srli_epi32(p[i], 16), low_byte);
+            A[i] = _mm_srli_epi32(p[i], 24);
+        }
+        _mm_storeu_si128((__m128i*)(r + c), _mm_packus_epi16(_mm_packs_epi32(R[0], R[1]), _mm_packs_epi32(R[2], R[3])));
+        _mm_storeu_si128((__m128i*)(g + c), _mm_packs_epi32(G[0], G[1]));
+        _mm_storeu_si128((__m128i*)(g + c + 8), _mm_packs_epi32(G[2], G[3]));
+        _mm_storeu_si128((__m128i*)(b + c), _mm_packs_epi32(B[0], B[1]));
+        _mm_storeu_si128((__m128i*)(b + c + 8), _mm_packs_epi32(B[2], B[3]));
+        if (a) _mm_storeu_si128((__m128i*)(a + c), _mm_packus_epi16(_mm_packs_epi32(A[0], A[1]), _mm_packs_epi32(A[2], A[3])));
+    }
+#endif
+    for (; c < n; c++) {
+        r[c] = in[4*c];
+        g[c] = in[4*c+1];
+        b[c] = in[4*c+2];
+        if (a) a[c] = in[4*c+3];
+    }
+}
+
+#ifdef SUPPORT_HDR
+static void interleave_RGBA16(const uint16_t *r, const int32_t *g, const int32_t *b, const uint16_t *a, uint16_t alpha, uint16_t *out, size_t n) {
+    size_t c = 0;
+#ifdef FLIF_ROWS_SSE2
+    // SSE2 has no unsigned saturating 32 to 16 bit pack, so pack signed around 0x8000 instead
+    const __m128i bias32 = _mm_set1_epi32(0x8000), bias16 = _mm_set1_epi16((short)0x8000);
+    const __m128i opaque = _mm_set1_epi16((short)alpha);
+    for (; c + 8 <= n; c += 8) {
+        const __m128i R = _mm_loadu_si128((const __m128i*)(r + c));
+        const __m128i G = _mm_xor_si128(bias16, _mm_packs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(g + c)), bias32),
+                                                                _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(g + c + 4)), bias32)));
+        const __m128i B = _mm_xor_si128(bias16, _mm_packs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(b + c)), bias32),
+                                                                _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(b + c + 4)), bias32)));
+        const __m128i A = (a ? _mm_loadu_si128((const __m128i*)(a + c)) : opaque);
+        const __m128i RG_lo = _mm_unpacklo_epi16(R, G), RG_hi = _mm_unpackhi_epi16(R, G);
+        const __m128i BA_lo = _mm_unpacklo_epi16(B, A), BA_hi = _mm_unpackhi_epi16(B, A);
+        _mm_storeu_si128((__m128i*)(out + 4*c), _mm_unpacklo_epi32(RG_lo, BA_lo));
+        _mm_storeu_si128((__m128i*)(out + 4*c + 8), _mm_unpackhi_epi32(RG_lo, BA_lo));
+        _mm_storeu_si128((__m128i*)(out + 4*c + 16), _mm_unpacklo_epi32(RG_hi, BA_hi));
+        _mm_storeu_si128((__m128i*)(out + 4*c + 24), _mm_unpackhi_epi32(RG_hi, BA_hi));
+    }
+#endif
+    for (; c < n; c++) {
+        out[4*c] = r[c];
+        out[4*c+1] = g[c];
+        out[4*c+2] = b[c];
+        out[4*c+3] = (a ? a[c] : alpha);
+    }
+}
+#endif
+
+// palette images (of at most 256 colors): a lookup table with the RGBA8 colors of the palette, where indices outside of
+// the palette get its first color
+template <typename index_t>
+static void expand_palette_RGBA8(Image &image, const index_t *index, uint8_t *out, size_t n, int rshift, int mult) {
+    uint8_t colors[256][4] = {};
+    const Image &palette = *image.palette_image;
+    const size_t size = palette.cols();
+    for (size_t i = 0; i < size; i++) {
+        for (int k = 0; k < 3; k++) colors[i][k] = ((palette(k, 0, i) >> rshift) * mult) & 0xFF;
+        colors[i][3] = (image.numPlanes() >= 4 ? ((palette(3, 0, i) >> rshift) * mult) & 0xFF : 0xFF);
+    }
+    for (size_t c = 0; c < n; c++) {
+        const ColorVal i = index[c];
+        memcpy(out + 4*c, colors[i >= 0 && i < (ColorVal)size ? i : 0], 4);
+    }
+}
+
+static bool read_row_RGBA8_planes(Image &image, uint32_t row, uint8_t *out, int rshift, int mult) {
+    const size_t cols = image.cols();
+    if (image.palette) {
+        if (!image.palette_image || image.palette_image->cols() > 256 || image.numPlanes() < 3
+            || image.palette_image->numPlanes() < image.numPlanes()) return false;
+        if (Plane<ColorVal_intern_8> *index = typed_plane<ColorVal_intern_8>(image, 1))
+            expand_palette_RGBA8(image, index->row_data(row), out, cols, rshift, mult);
+        else if (Plane<ColorVal_intern_16> *index = typed_plane<ColorVal_intern_16>(image, 1))
+            expand_palette_RGBA8(image, index->row_data(row), out, cols, rshift, mult);
+        else return false;
+        return true;
+    }
+    if (rshift != 0 || mult != 1 || image.numPlanes() < 3) return false;
+    Plane<ColorVal_intern_8> *r = typed_plane<ColorVal_intern_8>(image, 0);
+    Plane<ColorVal_intern_16> *g = typed_plane<ColorVal_intern_16>(image, 1);
+    Plane<ColorVal_intern_16> *b = typed_plane<ColorVal_intern_16>(image, 2);
+    const ColorVal_intern_8 *a;
+    ColorVal_intern_8 alpha = 0xFF;
+    if (!r || !g || !b || !alpha_plane(image, a, alpha, row)) return false;
+    interleave_RGBA8(r->row_data(row), g->row_data(row), b->row_data(row), a, alpha, out, cols);
+    return true;
+}
+
+static bool write_row_RGBA8_planes(Image &image, uint32_t row, const uint8_t *in) {
+    if (image.palette || image.numPlanes() < 3) return false;
+    Plane<ColorVal_intern_8> *r = typed_plane<ColorVal_intern_8>(image, 0);
+    Plane<ColorVal_intern_16> *g = typed_plane<ColorVal_intern_16>(image, 1);
+    Plane<ColorVal_intern_16> *b = typed_plane<ColorVal_intern_16>(image, 2);
+    Plane<ColorVal_intern_8> *a = (image.numPlanes() >= 4 ? typed_plane<ColorVal_intern_8>(image, 3) : nullptr);
+    if (!r || !g || !b || (image.numPlanes() >= 4 && !a)) return false;
+    deinterleave_RGBA8(in, r->row_data(row), g->row_data(row), b->row_data(row), (a ? a->row_data(row) : nullptr), image.cols());
+    return true;
+}
+
+static bool read_row_GRAY8_planes(Image &image, uint32_t row, uint8_t *out, int rshift, int mult) {
+    Plane<ColorVal_intern_8> *y = typed_plane<ColorVal_intern_8>(image, 0);
+    if (rshift != 0 || mult != 1 || !y) return false;
+    memcpy(out, y->row_data(row), image.cols());
+    return true;
+}
+
+static bool write_row_GRAY8_planes(Image &image, uint32_t row, const uint8_t *in) {
+    Plane<ColorVal_intern_8> *y = typed_plane<ColorVal_intern_8>(image, 0);
+    if (image.numPlanes() != 1 || !y) return false;
+    memcpy(y->row_data(row), in, image.cols());
+    return true;
+}
+
+#ifdef SUPPORT_HDR
+static bool read_row_GRAY16_planes(Image &image, uint32_t row, uint16_t *out) {
+    const size_t cols = image.cols();
+    if (Plane<ColorVal_intern_16u> *y = typed_plane<ColorVal_intern_16u>(image, 0)) {
+        memcpy(out, y->row_data(row), cols * sizeof(uint16_t));
+    } else if (Plane<ColorVal_intern_8> *y = typed_plane<ColorVal_intern_8>(image, 0)) {
+        const ColorVal_intern_8 *in = y->row_data(row);
+        for (size_t c = 0; c < cols; c++) out[c] = in[c];
+    } else return false;
+    return true;
+}
+
+static bool write_row_GRAY16_planes(Image &image, uint32_t row, const uint16_t *in) {
+    Plane<ColorVal_intern_16u> *y = typed_plane<ColorVal_intern_16u>(image, 0);
+    if (image.numPlanes() != 1 || !y) return false;
+    memcpy(y->row_data(row), in, image.cols() * sizeof(uint16_t));
+    return true;
+}
+
+static bool read_row_RGBA16_planes(Image &image, uint32_t row, uint16_t *out, int rshift, int mult) {
+    if (rshift != 0 || mult != 1 || image.palette || image.numPlanes() < 3) return false;
+    Plane<ColorVal_intern_16u> *r = typed_plane<ColorVal_intern_16u>(image, 0);
+    Plane<ColorVal_intern_32> *g = typed_plane<ColorVal_intern_32>(image, 1);
+    Plane<ColorVal_intern_32> *b = typed_plane<ColorVal_intern_32>(image, 2);
+    const ColorVal_intern_16u *a;
+    ColorVal_intern_16u alpha = 0xFFFF;
+    if (!r || !g || !b || !alpha_plane(image, a, alpha, row)) return false;
+    interleave_RGBA16(r->row_data(row), g->row_data(row), b->row_data(row), a, alpha, out, image.cols());
+    return true;
+}
+
+static bool write_row_RGBA16_planes(Image &image, uint32_t row, const uint16_t *in) {
+    if (image.palette || image.numPlanes() < 3) return false;
+    Plane<ColorVal_intern_16u> *r = typed_plane<ColorVal_intern_16u>(image, 0);
+    Plane<ColorVal_intern_32> *g = typed_plane<ColorVal_intern_32>(image, 1);
+    Plane<ColorVal_intern_32> *b = typed_plane<ColorVal_intern_32>(image, 2);
+    Plane<ColorVal_intern_16u> *a = (image.numPlanes() >= 4 ? typed_plane<ColorVal_intern_16u>(image, 3) : nullptr);
+    if (!r || !g || !b || (image.numPlanes() >= 4 && !a)) return false;
+    ColorVal_intern_16u *R = r->row_data(row), *A = (a ? a->row_data(row) : nullptr);
+    ColorVal_intern_32 *G = g->row_data(row), *B = b->row_data(row);
+    for (size_t c = 0; c < image.cols(); c++) {
+        R[c] = in[4*c];
+        G[c] = in[4*c+1];
+        B[c] = in[4*c+2];
+        if (A) A[c] = in[4*c+3];
+    }
+    return true;
+}
+#endif
@@ -55,6 +55,11 @@ extern "C" {
     FLIF_DLLIMPORT FLIF_IMAGE* FLIF_API flif_import_image_GRAY(uint32_t width, uint32_t height, const void* gray, uint32_t gray_stride);
     FLIF_DLLIMPORT FLIF_IMAGE* FLIF_API flif_import_image_GRAY16(uint32_t width, uint32_t height, const void* gray, uint32_t gray_stride);
     FLIF_DLLIMPORT FLIF_IMAGE* FLIF_API flif_import_image_PALETTE(uint32_t width, uint32_t height, const void* gray, uint32_t gray_stride);
+    // Like the flif_import_image functions, but without copying the pixels (one of the FLIF_PIXEL_FORMATs, with rows `stride`
+    // bytes apart): the image reads them from the given memory until something (e.g. a color transform of the encoder)
+    // changes a channel, which then gets a copy of its own. The memory has to stay valid and unchanged until the image,
+    // and every encoder it was added to, is destroyed.
+    FLIF_DLLIMPORT FLIF_IMAGE* FLIF_API flif_import_image_view(uint32_t width, uint32_t height, const void* pixels, size_t stride, int32_t format);
     FLIF_DLLIMPORT void FLIF_API flif_destroy_image(FLIF_IMAGE* image);
 
     FLIF_DLLIMPORT uint32_t FLIF_API flif_image_get_width(FLIF_IMAGE* image);
@@ -86,8 +91,43 @@ extern "C" {
     FLIF_DLLIMPORT void FLIF_API flif_image_write_row_RGBA16(FLIF_IMAGE* image, uint32_t row, const void* buffer, size_t buffer_size_bytes);
     FLIF_DLLIMPORT void FLIF_API flif_image_read_row_RGBA16(FLIF_IMAGE* image, uint32_t row, void* buffer, size_t buffer_size_bytes);
 
+    // Pixel formats for reading a whole image at once; the components are in the order of the name (BGRA8 is blue first).
+    // Gray images are expanded to RGB, palette images to their colors and images without alpha get opaque alpha.
+    typedef enum FLIF_PIXEL_FORMAT
+    {
+        FLIF_PIXEL_RGBA8 = 0,
+        FLIF_PIXEL_RGB8 = 1,
+        FLIF_PIXEL_BGRA8 = 2,
+        FLIF_PIXEL_GRAY8 = 3,       // like flif_image_read_row_GRAY8: the first channel
+        FLIF_PIXEL_RGBA16 = 4
+    } FLIF_PIXEL_FORMAT;
+
+    // Writes the whole image to pixels in one go (faster than reading it row by row), with rows `stride` bytes apart.
+    // Returns 0 if the format is unknown or if the rows don't fit in stride or in buffer_size_bytes.
+    FLIF_DLLIMPORT int32_t FLIF_API flif_image_read_into(FLIF_IMAGE* image, void* pixels, size_t stride, size_t buffer_size_bytes, int32_t format);
+
     FLIF_DLLIMPORT void FLIF_API flif_free_memory(void* buffer);
 
+    // Custom memory management for image buffers, which is where nearly all of the memory of FLIF goes.
+    // allocate has to return size bytes aligned to alignment (a power of two, at least 64), or NULL if it can't;
+    // release gets a buffer back together with the size it was allocated with. arena is passed to both as is.
+    typedef struct FLIF_ALLOCATOR
+    {
+        void* (*allocate)(size_t size, size_t alignment, void* arena);
+        void (*release)(void* ptr, size_t size, void* arena);
+        void* arena;
+    } FLIF_ALLOCATOR;
+
+    // Sets the allocator for all image buffers that are allocated from now on (NULL = the default allocator).
+    // A buffer is always released with the allocator it came from, even if the allocator is changed in the meantime.
+    FLIF_DLLIMPORT void FLIF_API flif_set_allocator(const FLIF_ALLOCATOR* allocator);
+
+    // Out-of-core images: keeps at most ram_budget_bytes of image buffers in RAM (in total), and the buffers of any
+    // further images in memory-mapped temporary files in directory (NULL = $TMPDIR or /tmp), so images that do not fit
+    // in RAM can still be encoded and decoded. Like flif_set_allocator, it applies to the buffers allocated from now on;
+    // flif_set_allocator(NULL) turns it off again. Returns 0 if this platform does not support it.
+    FLIF_DLLIMPORT int32_t FLIF_API flif_set_out_of_core(size_t ram_budget_bytes, const char* directory);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -47,6 +47,37 @@ extern "C" {
     */
     FLIF_DLLIMPORT int32_t FLIF_API flif_decoder_decode_filepointer(FLIF_DECODER* decoder, FILE *filepointer, const char *filename);
 
+    /*
+    * Decode a FLIF blob in memory straight into pixels, in one of the FLIF_PIXEL_FORMATs with rows `stride` bytes apart
+    * (like flif_image_read_into, for the first frame). The buffer has to fit the decoded image, whose size can be known
+    * beforehand from flif_read_info_from_memory and the scale/resize/fit options. The decoder does not keep the image
+    * (flif_decoder_num_images returns 0 afterwards). Returns 0 if decoding failed or the image did not fit.
+    * The rows are converted while the last color transforms are undone, band by band, rather than in a pass of their own.
+    */
+    FLIF_DLLIMPORT int32_t FLIF_API flif_decoder_decode_memory_into(FLIF_DECODER* decoder, const void* buffer, size_t buffer_size_bytes,
+                                                                    void* pixels, size_t stride, size_t pixels_size_bytes, int32_t format);
+
+    /*
+    * Incremental decoding, for data that arrives in pieces (e.g. from the network): feed the bytes as they come in.
+    * The first feed starts a decode (with the options and callback the decoder has at that moment; setting them again
+    * doesn't affect it, and the other decode functions fail until it is over); every feed returns once the decoder
+    * has used all bytes fed so far, and says whether it needs more. The decoder suspends where it runs out of input and
+    * continues from there, so nothing is decoded twice; progressive callbacks (flif_decoder_set_callback) are made
+    * during the feed calls, as the zoomlevels come in. If the input ends before the decoder is done (e.g. a partial
+    * file), call flif_decoder_end_feed to decode what is there. Once FLIF_FEED_DONE or FLIF_FEED_ERROR is returned,
+    * the decode is over (the images are available as with flif_decoder_decode_memory), and the next feed starts a new one.
+    */
+    typedef enum FLIF_FEED_STATUS
+    {
+        FLIF_FEED_ERROR = 0,
+        FLIF_FEED_DONE = 1,
+        FLIF_FEED_NEED_MORE = 2
+    } FLIF_FEED_STATUS;
+
+    FLIF_DLLIMPORT int32_t FLIF_API flif_decoder_feed(FLIF_DECODER* decoder, const void* buffer, size_t buffer_size_bytes);
+    // no more input will be fed: finishes the decode with the bytes that were fed
+    FLIF_DLLIMPORT int32_t FLIF_API flif_decoder_end_feed(FLIF_DECODER* decoder);
+
     // returns the number of frames (1 if it is not an animation)
     FLIF_DLLIMPORT size_t FLIF_API flif_decoder_num_images(FLIF_DECODER* decoder);
     // only relevant for animations: returns the loop count (0 = loop forever)
@@ -67,6 +98,15 @@ extern "C" {
     FLIF_DLLIMPORT void FLIF_API flif_decoder_set_scale(FLIF_DECODER* decoder, uint32_t scale); // valid scales: 1,2,4,8,16,...
     FLIF_DLLIMPORT void FLIF_API flif_decoder_set_resize(FLIF_DECODER* decoder, uint32_t width, uint32_t height);
     FLIF_DLLIMPORT void FLIF_API flif_decoder_set_fit(FLIF_DECODER* decoder, uint32_t width, uint32_t height);
+    FLIF_DLLIMPORT void FLIF_API flif_decoder_set_threads(FLIF_DECODER* decoder, int32_t threads); // default: 1, for the tiles of tiled images and plane streams
+    FLIF_DLLIMPORT void FLIF_API flif_decoder_set_verbosity(FLIF_DECODER* decoder, int32_t verbosity); // default: 1 (warnings), 0 = silent, higher = more messages (to stdout)
+    // default: no (0). With buffer reuse, a decode reuses the image buffers of the previous decode with this decoder when
+    // they have the right size (useful when decoding many images of the same size one after the other); the images
+    // returned by flif_decoder_get_image are then only valid until the next decode.
+    FLIF_DLLIMPORT void FLIF_API flif_decoder_set_reuse_buffers(FLIF_DECODER* decoder, int32_t reuse);
+    // default: the allocator of flif_set_allocator. Allocates the buffers of the decoded images of this decoder with the
+    // given allocator instead (e.g. to limit or account the memory used per decoder); the allocator is copied.
+    FLIF_DLLIMPORT void FLIF_API flif_decoder_set_allocator(FLIF_DECODER* decoder, const FLIF_ALLOCATOR* allocator);
 
     // Progressive decoding: set a callback function. The callback will be called after a certain quality is reached,
     // and it should return the desired next quality that should be reached before it will be called again.
@@ -76,6 +116,30 @@ extern "C" {
     FLIF_DLLIMPORT void FLIF_API flif_decoder_set_callback(FLIF_DECODER* decoder, callback_t callback, void *user_data);
     FLIF_DLLIMPORT void FLIF_API flif_decoder_set_first_callback_quality(FLIF_DECODER* decoder, int32_t quality); // valid quality: 0-10000
 
+    // Batch decoding: decodes many FLIF files or blobs on a pool of threads (e.g. for galleries and thumbnails).
+    // Every item is either a blob in memory (buffer != NULL) or a file (filename), with its own decode options;
+    // a zero-initialized item field means the default (full quality, full scale, no fit).
+    typedef struct FLIF_BATCH_ITEM
+    {
+        const void* buffer;         // blob to decode, or NULL to decode filename
+        size_t buffer_size_bytes;
+        const char* filename;
+        uint32_t scale;             // like flif_decoder_set_scale, 0 = 1
+        int32_t quality;            // like flif_decoder_set_quality, 0 = 100
+        uint32_t fit_width;         // like flif_decoder_set_fit, if both are non-zero
+        uint32_t fit_height;
+    } FLIF_BATCH_ITEM;
+
+    // Called once for every item (in no particular order) as soon as it is decoded, from one of the decoding threads;
+    // several calls can run at the same time. `success` is zero if the item could not be decoded (and then num_images is 0).
+    // The callback takes ownership of the images (all frames of an animation) and has to release each of them
+    // with flif_destroy_image(); the `images` array itself is only valid during the call.
+    typedef void (*batch_callback_t)(size_t index, int32_t success, FLIF_IMAGE** images, size_t num_images, void *user_data);
+
+    // Decodes num_items items on `threads` threads (0 = one per CPU core), including the calling one, and returns when
+    // all of them are done. Returns the number of items that were decoded successfully.
+    FLIF_DLLIMPORT size_t FLIF_API flif_decode_batch(const FLIF_BATCH_ITEM* items, size_t num_items, int32_t threads, batch_callback_t callback, void *user_data);
+
     // Reads the header of a FLIF file and packages it as a FLIF_INFO struct.
     // May return a null pointer if the file is not in the right format.
     // The caller takes ownership of the return value and must call flif_destroy_info().
@@ -94,6 +158,18 @@ extern "C" {
     // get the number of animation frames
     FLIF_DLLIMPORT size_t   FLIF_API flif_info_num_images(FLIF_INFO* info);
 
+    // Interlaced images encoded with a zoomlevel index (flif_encoder_set_zoomlevel_index) record where every
+    // plane/zoomlevel step of the pixel data ends, so a partial file can be fetched (e.g. with an HTTP range request)
+    // once the header is known.
+    // get the number of steps in the index (0 if the file has none)
+    FLIF_DLLIMPORT size_t   FLIF_API flif_info_num_zoomlevel_offsets(FLIF_INFO* info);
+    // get step i: its plane, its zoomlevel and the number of bytes (from the start of the file) that a decoder needs
+    // to decode everything up to and including it; returns 0 if there is no such step
+    FLIF_DLLIMPORT int32_t  FLIF_API flif_info_get_zoomlevel_offset(FLIF_INFO* info, size_t i, int32_t* plane, int32_t* zoomlevel, uint64_t* offset);
+    // get the number of bytes of the file that are needed to decode it at scale 1:scale (see flif_decoder_set_scale),
+    // or 0 if the file has no zoomlevel index
+    FLIF_DLLIMPORT uint64_t FLIF_API flif_info_get_bytes_for_scale(FLIF_INFO* info, uint32_t scale);
+
 
 #ifdef __cplusplus
 }
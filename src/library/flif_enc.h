@@ -50,6 +50,7 @@ extern "C" {
     // encoder options (these are all optional, the defaults should be fine)
     FLIF_DLLIMPORT void FLIF_API flif_encoder_set_interlaced(FLIF_ENCODER* encoder, uint32_t interlaced);      // 0 = -N, 1 = -I (default: -I)
     FLIF_DLLIMPORT void FLIF_API flif_encoder_set_learn_repeat(FLIF_ENCODER* encoder, uint32_t learn_repeats); // default: 2 (-R)
+    FLIF_DLLIMPORT void FLIF_API flif_encoder_set_learn_sample(FLIF_ENCODER* encoder, uint32_t learn_sample);  // default: 1 (-l), learn from one in N bands of rows
     FLIF_DLLIMPORT void FLIF_API flif_encoder_set_auto_color_buckets(FLIF_ENCODER* encoder, uint32_t acb);     // 0 = -B, 1 = default
     FLIF_DLLIMPORT void FLIF_API flif_encoder_set_palette_size(FLIF_ENCODER* encoder, int32_t palette_size);   // default: 512  (max palette size)
     FLIF_DLLIMPORT void FLIF_API flif_encoder_set_lookback(FLIF_ENCODER* encoder, int32_t lookback);           // default: 1 (-L)
@@ -66,10 +67,43 @@ extern "C" {
     FLIF_DLLIMPORT void FLIF_API flif_encoder_set_channel_compact(FLIF_ENCODER* encoder, uint32_t plc); // 0 = -C, 1 = default
     FLIF_DLLIMPORT void FLIF_API flif_encoder_set_ycocg(FLIF_ENCODER* encoder, uint32_t ycocg);         // 0 = -Y, 1 = default
     FLIF_DLLIMPORT void FLIF_API flif_encoder_set_frame_shape(FLIF_ENCODER* encoder, uint32_t frs);     // 0 = -S, 1 = default
+    FLIF_DLLIMPORT void FLIF_API flif_encoder_set_rans(FLIF_ENCODER* encoder, uint32_t rans);           // 0 = default (range coder), 1 = rANS (-a)
+    FLIF_DLLIMPORT void FLIF_API flif_encoder_set_threads(FLIF_ENCODER* encoder, int32_t threads);      // default: 1 (-j), does not change the output
+    FLIF_DLLIMPORT void FLIF_API flif_encoder_set_verbosity(FLIF_ENCODER* encoder, int32_t verbosity);  // default: 1 (warnings), 0 = silent, higher = more messages (-v)
+    // default: 0 (one stream for the whole image). Larger still images are encoded as independent tiles of
+    // tile_size x tile_size pixels (-g), which are encoded and decoded in parallel; older decoders can't decode them.
+    FLIF_DLLIMPORT void FLIF_API flif_encoder_set_tile_size(FLIF_ENCODER* encoder, int32_t tile_size);
+    // 0 = default, 1 = every plane in a range coder stream of its own (-z), so the planes are decoded in parallel.
+    // Implies non-interlaced: encoding fails after flif_encoder_set_interlaced(encoder, 1). Older decoders can't decode them.
+    FLIF_DLLIMPORT void FLIF_API flif_encoder_set_plane_streams(FLIF_ENCODER* encoder, uint32_t plane_streams);
+
+    // 0 = default, 1 = add a zoomlevel index (-u): the byte offset at which every plane/zoomlevel step is complete, so
+    // a partial file for a given scale can be fetched (see flif_info_get_bytes_for_scale). Only for interlaced images.
+    FLIF_DLLIMPORT void FLIF_API flif_encoder_set_zoomlevel_index(FLIF_ENCODER* encoder, uint32_t zoomlevel_index);
 
     //set amount of quality loss, 0 for no loss, 100 for maximum loss, negative values indicate adaptive lossy (second image should be the saliency map)
     FLIF_DLLIMPORT void FLIF_API flif_encoder_set_lossy(FLIF_ENCODER* encoder, int32_t loss);           // default: 0 (lossless)
 
+    // MANIAC trees learned from a set of similar images (-y), to encode other images without learning new trees (-x)
+    typedef struct FLIF_FOREST FLIF_FOREST;
+
+    FLIF_DLLIMPORT FLIF_FOREST* FLIF_API flif_create_forest();
+    FLIF_DLLIMPORT void FLIF_API flif_destroy_forest(FLIF_FOREST* forest);
+
+    // load a forest file; non-zero if the function succeeded
+    FLIF_DLLIMPORT int32_t FLIF_API flif_forest_load(FLIF_FOREST* forest, const char* filename);
+
+    // finish training and save the forest to a file; non-zero if the function succeeded
+    FLIF_DLLIMPORT int32_t FLIF_API flif_forest_save(FLIF_FOREST* forest, const char* filename);
+
+    // learn from the image(s) of the encoder instead of encoding them (use a new encoder for every training image);
+    // the encoder options should be the same as those that will be used with the forest
+    FLIF_DLLIMPORT int32_t FLIF_API flif_encoder_train_forest(FLIF_ENCODER* encoder, FLIF_FOREST* forest);
+
+    // encode with the trees of the forest (finishes its training); the forest must outlive the encoder, NULL to learn trees again;
+    // non-zero if the function succeeded, zero (and the encoder is unchanged) if the forest has not been trained
+    FLIF_DLLIMPORT int32_t FLIF_API flif_encoder_set_forest(FLIF_ENCODER* encoder, FLIF_FOREST* forest);
+
 
 
 #ifdef __cplusplus
@@ -23,6 +23,9 @@ limitations under the License.
 #include <stdint.h>
 #include <string>
 #include <sstream>
+#include <map>
+#include <memory>
+#include <mutex>
 
 struct Log4kTable {
     uint16_t data[4097];
@@ -140,7 +143,7 @@ public:
     typedef typename BitChance::Table SubTable;
     SubTable subTable[N];
 
-    explicit MultiscaleBitChanceTable(int cut = 8) {
+    explicit MultiscaleBitChanceTable(int cut = 8, uint32_t /* alpha: the scales have fixed alphas */ = 0) {
         for (int i= 0; i<N; i++) {
             subTable[i].init(cut, MULTISCALE_ALPHAS[i]);
         }
@@ -213,3 +216,23 @@ public:
 };
 
 #endif
+
+/* Chance tables only depend on (cut, alpha) and never change once built, so all coders share them.
+   The tables for the default parameters are kept for the lifetime of the process, other ones as long as some coder uses them. */
+template <typename Table> std::shared_ptr<const Table> shared_chance_table(int cut, uint32_t alpha) {
+    static const std::shared_ptr<const Table> default_table = std::make_shared<const Table>(2, 0xFFFFFFFF / 19);
+    static const std::shared_ptr<const Table> default_final_table = std::make_shared<const Table>(4, 0xFFFFFFFF / 20);
+    if (cut == 2 && alpha == 0xFFFFFFFF / 19) return default_table;
+    if (cut == 4 && alpha == 0xFFFFFFFF / 20) return default_final_table;
+
+    static std::mutex cache_mutex;
+    static std::map<std::pair<int, uint32_t>, std::weak_ptr<const Table>> cache;
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    std::weak_ptr<const Table> &entry = cache[std::make_pair(cut, alpha)];
+    std::shared_ptr<const Table> table = entry.lock();
+    if (!table) {
+        table = std::make_shared<const Table>(cut, alpha);
+        entry = table;
+    }
+    return table;
+}
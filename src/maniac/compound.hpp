@@ -19,6 +19,8 @@ limitations under the License.
 #pragma once
 
 #include <vector>
+#include <algorithm>
+#include <memory>
 #include <math.h>
 #include <stdint.h>
 #include "symbol.hpp"
@@ -52,6 +54,98 @@ public:
     Tree() : std::vector<PropertyDecisionNode>(1, PropertyDecisionNode()) {}
 };
 
+// Decode-side copy of a MANIAC tree. Every node is 8 bytes (property and splitval packed together, the two
+// children are always next to each other), so the walk only touches the fields it needs.
+// A decoded inner node first acts as a leaf for `count` more lookups before it actually splits; such nodes are
+// marked LAZY and their bookkeeping is kept in a separate vector, away from the nodes that are walked.
+class FinalTree {
+private:
+    static const int LEAF = 0xFF;
+    static const int LAZY = 0xFE;
+
+    struct Node {
+        int32_t split;      // (splitval << 8) | property, or LEAF / LAZY in the low byte
+        uint32_t child;     // inner node: left child (> splitval), child+1 is the right child (<= splitval)
+                            // leaf: leaf index, lazy node: index in lazy
+    };
+    struct LazyNode {
+        int count;
+        uint32_t leaf;
+        int32_t split;      // what the node becomes when it splits
+        uint32_t child;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<LazyNode> lazy;
+    uint32_t used;
+
+    void set_leaf(uint32_t pos, uint32_t leaf) {
+        if ((nodes[pos].split & 0xFF) == LEAF) nodes[pos].child = leaf;
+        else lazy[nodes[pos].child].leaf = leaf;
+    }
+
+    template <typename Leaf> ATTRIBUTE_COLD Leaf &find_lazy_leaf(uint32_t pos, const Properties &properties, std::vector<Leaf> &leaves) {
+        LazyNode &l = lazy[nodes[pos].child];
+        if (l.count > 0) {
+            l.count--;
+            return leaves[l.leaf];
+        }
+        // split: the left branch keeps the leaf, the right branch gets a copy of it
+        uint32_t old_leaf = l.leaf;
+        uint32_t new_leaf = leaves.size();
+        Leaf copy = leaves[old_leaf];
+        leaves.push_back(copy);
+        nodes[pos].split = l.split;
+        nodes[pos].child = l.child;
+        set_leaf(l.child, old_leaf);
+        set_leaf(l.child+1, new_leaf);
+        return leaves[properties[l.split & 0xFF] > (l.split >> 8) ? old_leaf : new_leaf];
+    }
+
+public:
+    explicit FinalTree(const Tree &tree) : nodes(tree.size()), used(0) {
+        for (uint32_t pos = 0; pos < tree.size(); pos++) {
+            const PropertyDecisionNode &n = tree[pos];
+            if (n.property == -1) {
+                nodes[pos].split = LEAF;
+                nodes[pos].child = n.leafID;
+                continue;
+            }
+            // property values are at most a few times the 16-bit color range, so they fit in 24 bits
+            assert(n.splitval >= -(1 << 23) && n.splitval < (1 << 23));
+            assert(n.property < LAZY);
+            assert(n.property < 32);
+            used |= 1u << n.property;
+            int32_t split = n.splitval * 256 + n.property;
+            if (n.count < 0) {
+                nodes[pos].split = split;
+                nodes[pos].child = n.childID;
+            } else {
+                nodes[pos].split = LAZY;
+                nodes[pos].child = lazy.size();
+                lazy.push_back(LazyNode{n.count, n.leafID, split, n.childID});
+            }
+        }
+        set_leaf(0, 0);
+    }
+
+    // Bitmask of the properties that are tested somewhere in the tree; the other ones don't have to be computed.
+    uint32_t used_properties() const {
+        return used;
+    }
+
+    // Returns the leaf for the given properties. A split appends a copy of the parent leaf to leaves.
+    template <typename Leaf> ATTRIBUTE_HOT Leaf inline &find_leaf(const Properties &properties, std::vector<Leaf> &leaves) {
+        uint32_t pos = 0;
+        int p;
+        while ((p = nodes[pos].split & 0xFF) < LAZY) {
+            pos = nodes[pos].child + (properties[p] <= (nodes[pos].split >> 8));
+        }
+        if (p == LEAF) return leaves[nodes[pos].child];
+        return find_lazy_leaf(pos, properties, leaves);
+    }
+};
+
 // leaf nodes when tree is known
 template <typename BitChance, int bits> class FinalCompoundSymbolChances {
 public:
@@ -98,19 +192,19 @@ template <typename BitChance, typename RAC, int bits> class FinalCompoundSymbolC
 private:
     typedef typename FinalCompoundSymbolBitCoder<BitChance, RAC, bits>::Table Table;
     RAC &rac;
-    const Table table;
+    std::shared_ptr<const Table> table;
 
 public:
 
-    FinalCompoundSymbolCoder(RAC& racIn, int cut = 2, int alpha = 0xFFFFFFFF / 19) : rac(racIn), table(cut,alpha) {}
+    FinalCompoundSymbolCoder(RAC& racIn, int cut = 2, int alpha = 0xFFFFFFFF / 19) : rac(racIn), table(shared_chance_table<Table>(cut,alpha)) {}
 
     int read_int(FinalCompoundSymbolChances<BitChance, bits> &chancesIn, int min, int max) {
-        FinalCompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, rac, chancesIn);
+        FinalCompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, rac, chancesIn);
         int val = reader<bits>(bitCoder, min, max);
         return val;
     }
     int read_int(FinalCompoundSymbolChances<BitChance, bits> &chancesIn, int nbits) {
-        FinalCompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, rac, chancesIn);
+        FinalCompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, rac, chancesIn);
         int val = reader(bitCoder, nbits);
         return val;
     }
@@ -129,63 +223,33 @@ private:
     //Ranges range;
     unsigned int nb_properties;
     std::vector<FinalCompoundSymbolChances<BitChance,bits> > leaf_node;
-    Tree &inner_node;
-
-    FinalCompoundSymbolChances<BitChance,bits> inline &find_leaf(const Properties &properties) ATTRIBUTE_HOT {
-        Tree::size_type pos = 0;
-        while(inner_node[pos].property != -1) {
-            if (inner_node[pos].count < 0) {
-                if (properties[inner_node[pos].property] > inner_node[pos].splitval) {
-                  pos = inner_node[pos].childID;
-                } else {
-                  pos = inner_node[pos].childID+1;
-                }
-            } else if (inner_node[pos].count > 0) {
-                assert(inner_node[pos].leafID >= 0);
-                assert((unsigned int)inner_node[pos].leafID < leaf_node.size());
-                inner_node[pos].count--;
-                break;
-            } else if (inner_node[pos].count == 0) {
-                inner_node[pos].count--;
-                FinalCompoundSymbolChances<BitChance,bits> &result = leaf_node[inner_node[pos].leafID];
-                uint32_t old_leaf = inner_node[pos].leafID;
-                uint32_t new_leaf = leaf_node.size();
-                FinalCompoundSymbolChances<BitChance,bits> resultCopy = result;
-                leaf_node.push_back(resultCopy);
-                inner_node[inner_node[pos].childID].leafID = old_leaf;
-                inner_node[inner_node[pos].childID+1].leafID = new_leaf;
-                if (properties[inner_node[pos].property] > inner_node[pos].splitval) {
-                  return leaf_node[old_leaf];
-                } else {
-                  return leaf_node[new_leaf];
-                }
-            }
-        }
-        return leaf_node[inner_node[pos].leafID];
-    }
+    FinalTree tree;
 
 public:
-    FinalPropertySymbolCoder(RAC& racIn, Ranges &rangeIn, Tree &treeIn, int FLIF_UNUSED(ignored_split_threshold) = 0, int cut = 4, int alpha = 0xFFFFFFFF / 20) :
+    FinalPropertySymbolCoder(RAC& racIn, Ranges &rangeIn, const Tree &treeIn, int FLIF_UNUSED(ignored_split_threshold) = 0, int cut = 4, int alpha = 0xFFFFFFFF / 20) :
         coder(racIn, cut, alpha),
 //        range(rangeIn),
         nb_properties(rangeIn.size()),
         leaf_node(1,FinalCompoundSymbolChances<BitChance,bits>()),
-        inner_node(treeIn) 
+        tree(treeIn)
     {
-        inner_node[0].leafID = 0;
+    }
+
+    uint32_t used_properties() const {
+        return tree.used_properties();
     }
 
     int read_int(const Properties &properties, int min, int max) ATTRIBUTE_HOT {
         if (min == max) { return min; }
         assert(properties.size() == nb_properties);
-        FinalCompoundSymbolChances<BitChance,bits> &chances = find_leaf(properties);
+        FinalCompoundSymbolChances<BitChance,bits> &chances = tree.find_leaf(properties, leaf_node);
         return coder.read_int(chances, min, max);
     }
 
 
     int read_int(const Properties &properties, int nbits) {
         assert(properties.size() == nb_properties);
-        FinalCompoundSymbolChances<BitChance,bits> &chances = find_leaf(properties);
+        FinalCompoundSymbolChances<BitChance,bits> &chances = tree.find_leaf(properties, leaf_node);
         return coder.read_int(chances, nbits);
     }
 
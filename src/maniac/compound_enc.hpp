@@ -19,12 +19,41 @@
 #pragma once
 
 // leaf nodes during tree construction phase
+// Next to the real chances, a leaf has two virtual contexts per property (for property values above and at most the
+// running average). There are many leaves, so they are kept small: the virtual contexts of all properties share one
+// block, which only has the exponent and mantissa chances for the magnitudes the leaf has coded so far. The block
+// grows when a larger magnitude arrives; the chances it adds are still at their initial values, so nothing changes.
 template <typename BitChance, int bits> class CompoundSymbolChances final : public FinalCompoundSymbolChances<BitChance, bits> {
+    struct VirtualStats {
+        uint64_t size;      // estimated code length when using the virtual contexts of the property
+        int64_t propSum;    // sum of the property values, for the running average
+    };
+
+    std::unique_ptr<VirtualStats[]> stats;
+    std::unique_ptr<BitChance[]> virtChances;  // per property: the context for values above the average, then the other
+    uint8_t nb_properties;
+    uint8_t magnitude_bits;                  // the virtual contexts cover magnitudes below 2^magnitude_bits
+
+    static int exp_count(int mb) { return 2 * std::min(mb, bits-1); }
+    static int row_size(int mb) { return 2 + exp_count(mb) + mb; }
+
+    static void init_row(BitChance *row, int mb) {
+        row[0].set_12bit(ZERO_CHANCE);
+        row[1].set_12bit(SIGN_CHANCE);
+        for (int i = 0; i < exp_count(mb); i++) row[2+i].set_12bit(EXP_CHANCES[i/2]);
+        for (int i = 0; i < mb; i++) row[2+exp_count(mb)+i].set_12bit(MANT_CHANCES[i]);
+    }
+
+    void copy_from(const CompoundSymbolChances &other) {
+        const int n = 2 * nb_properties * row_size(magnitude_bits);
+        stats.reset(new VirtualStats[nb_properties]);
+        std::copy(&other.stats[0], &other.stats[0] + nb_properties, &stats[0]);
+        virtChances.reset(new BitChance[n]);
+        std::copy(&other.virtChances[0], &other.virtChances[0] + n, &virtChances[0]);
+    }
+
 public:
-    std::vector<std::pair<SymbolChance<BitChance, bits>,SymbolChance<BitChance, bits> > > virtChances;
     uint64_t realSize;
-    std::vector<uint64_t> virtSize;
-    std::vector<int64_t> virtPropSum;
     int32_t count;
     int8_t best_property;
 
@@ -32,20 +61,74 @@ public:
         best_property = -1;
         realSize = 0;
         count = 0;
-        virtPropSum.assign(virtPropSum.size(),0);
-        virtSize.assign(virtSize.size(),0);
+        for (int j = 0; j < nb_properties; j++) stats[j] = VirtualStats{0, 0};
     }
 
     CompoundSymbolChances(int nProp) :
         FinalCompoundSymbolChances<BitChance, bits>(),
-        virtChances(nProp,std::make_pair(SymbolChance<BitChance, bits>(), SymbolChance<BitChance,bits>())),
+        stats(new VirtualStats[nProp]),
+        virtChances(new BitChance[2 * nProp * row_size(0)]),
+        nb_properties(nProp),
+        magnitude_bits(0),
         realSize(0),
-        virtSize(nProp),
-        virtPropSum(nProp),
         count(0),
         best_property(-1)
-    { }
+    {
+        assert(nProp < 256);
+        resetCounters();
+        for (int r = 0; r < 2 * nProp; r++) init_row(&virtChances[r * row_size(0)], 0);
+    }
+    CompoundSymbolChances(const CompoundSymbolChances &other) :
+        FinalCompoundSymbolChances<BitChance, bits>(other),
+        nb_properties(other.nb_properties),
+        magnitude_bits(other.magnitude_bits),
+        realSize(other.realSize),
+        count(other.count),
+        best_property(other.best_property)
+    {
+        copy_from(other);
+    }
+    CompoundSymbolChances(CompoundSymbolChances &&other) noexcept = default;
+
+    int nb_virtual() const { return nb_properties; }
+    uint64_t &virtSize(int property) { return stats[property].size; }
+    int64_t &virtPropSum(int property) { return stats[property].propSum; }
+
+    // position of a bit in the virtual contexts
+    int offset(SymbolChanceBitType type, int i) const {
+        switch (type) {
+        default:
+        case BIT_ZERO: return 0;
+        case BIT_SIGN: return 1;
+        case BIT_EXP: assert(i < exp_count(magnitude_bits)); return 2 + i;
+        case BIT_MANT: assert(i < magnitude_bits); return 2 + exp_count(magnitude_bits) + i;
+        }
+    }
+    BitChance &virt(int property, bool above, int offset) {
+        return virtChances[(2 * property + (above ? 0 : 1)) * row_size(magnitude_bits) + offset];
+    }
 
+    // makes the virtual contexts cover magnitudes below 2^mb
+    void cover(int mb) {
+        if (mb <= magnitude_bits) return;
+        if (mb > bits) mb = bits;
+        const int old_size = row_size(magnitude_bits), old_exp = exp_count(magnitude_bits);
+        const int new_size = row_size(mb), new_exp = exp_count(mb);
+        std::unique_ptr<BitChance[]> grown(new BitChance[2 * nb_properties * new_size]);
+        for (int r = 0; r < 2 * nb_properties; r++) {
+            const BitChance *from = &virtChances[r * old_size];
+            BitChance *to = &grown[r * new_size];
+            init_row(to, mb);
+            std::copy(from, from + 2 + old_exp, to);
+            std::copy(from + 2 + old_exp, from + old_size, to + 2 + new_exp);
+        }
+        virtChances = std::move(grown);
+        magnitude_bits = mb;
+    }
+    // the writer only uses the exponents up to that of |value|, and the mantissa bits below it
+    void cover_value(int value) {
+        if (value) cover(maniac::util::ilog2(abs(value)) + 1);
+    }
 };
 
 template <typename BitChance, typename RAC, int bits>
@@ -73,13 +156,14 @@ private:
 
         int8_t best_property = -1;
         uint64_t best_size = chances.realSize;
-        for (unsigned int j=0; j<chances.virtChances.size(); j++) {
-            BitChance& virt = (select)[j] ? chances.virtChances[j].first.bit(type,i)
-                              : chances.virtChances[j].second.bit(type,i);
-            virt.estim(bit, chances.virtSize[j]);
+        const int offset = chances.offset(type, i);
+        for (int j=0; j<chances.nb_virtual(); j++) {
+            BitChance& virt = chances.virt(j, select[j], offset);
+            uint64_t &virtSize = chances.virtSize(j);
+            virt.estim(bit, virtSize);
             virt.put(bit, table);
-            if (chances.virtSize[j] < best_size) {
-                best_size = chances.virtSize[j];
+            if (virtSize < best_size) {
+                best_size = virtSize;
                 best_property = j;
             }
         }
@@ -88,8 +172,7 @@ private:
     BitChance inline & bestChance(SymbolChanceBitType type, int i = 0) {
         signed short int p = chances.best_property;
         return (p == -1 ? chances.realChances.bit(type,i)
-                : ((select)[p] ? chances.virtChances[p].first.bit(type,i)
-                   : chances.virtChances[p].second.bit(type,i) ));
+                : chances.virt(p, select[p], chances.offset(type, i)));
     }
 
 public:
@@ -112,13 +195,13 @@ public:
 
 template <typename BitChance, typename RAC, int bits>
 void FinalCompoundSymbolCoder<BitChance,RAC,bits>::write_int(FinalCompoundSymbolChances<BitChance, bits>& chancesIn, int min, int max, int val) {
-        FinalCompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, rac, chancesIn);
+        FinalCompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, rac, chancesIn);
         writer<bits>(bitCoder, min, max, val);
     }
 
 template <typename BitChance, typename RAC, int bits>
 void FinalCompoundSymbolCoder<BitChance,RAC,bits>::write_int(FinalCompoundSymbolChances<BitChance, bits>& chancesIn, int nbits, int val) {
-        FinalCompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, rac, chancesIn);
+        FinalCompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, rac, chancesIn);
         writer(bitCoder, nbits, val);
     }
 
@@ -128,31 +211,35 @@ template <typename BitChance, typename RAC, int bits> class CompoundSymbolCoder
 private:
     typedef typename CompoundSymbolBitCoder<BitChance, RAC, bits>::Table Table;
     RAC &rac;
-    const Table table;
+    std::shared_ptr<const Table> table;
 
 public:
 
-    CompoundSymbolCoder(RAC& racIn, int cut = 2, int alpha = 0xFFFFFFFF / 19) : rac(racIn), table(cut,alpha) {}
+    CompoundSymbolCoder(RAC& racIn, int cut = 2, int alpha = 0xFFFFFFFF / 19) : rac(racIn), table(shared_chance_table<Table>(cut,alpha)) {}
 
     int read_int(CompoundSymbolChances<BitChance, bits> &chancesIn, std::vector<bool> &selectIn, int min, int max) {
         if (min == max) { return min; }
-        CompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, rac, chancesIn, selectIn);
+        chancesIn.cover(maniac::util::ilog2(std::max(-min, max)) + 1);
+        CompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, rac, chancesIn, selectIn);
         return reader<bits>(bitCoder, min, max);
     }
 
     void write_int(CompoundSymbolChances<BitChance, bits>& chancesIn, std::vector<bool> &selectIn, int min, int max, int val) {
         if (min == max) { assert(val==min); return; }
-        CompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, rac, chancesIn, selectIn);
+        chancesIn.cover_value(val);
+        CompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, rac, chancesIn, selectIn);
         writer<bits>(bitCoder, min, max, val);
     }
 
     int read_int(CompoundSymbolChances<BitChance, bits> &chancesIn, std::vector<bool> &selectIn, int nbits) {
-        CompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, rac, chancesIn, selectIn);
+        chancesIn.cover(nbits + 1);
+        CompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, rac, chancesIn, selectIn);
         return reader(bitCoder, nbits);
     }
 
     void write_int(CompoundSymbolChances<BitChance, bits>& chancesIn, std::vector<bool> &selectIn, int nbits, int val) {
-        CompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, rac, chancesIn, selectIn);
+        chancesIn.cover(nbits + 1);
+        CompoundSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, rac, chancesIn, selectIn);
         writer(bitCoder, nbits, val);
     }
 };
@@ -163,14 +250,14 @@ template <typename BitChance, typename RAC, int bits>
 void FinalPropertySymbolCoder<BitChance,RAC,bits>::write_int(const Properties &properties, int min, int max, int val) {
         if (min == max) { assert(val==min); return; }
         assert(properties.size() == nb_properties);
-        FinalCompoundSymbolChances<BitChance,bits> &chances = find_leaf(properties);
+        FinalCompoundSymbolChances<BitChance,bits> &chances = tree.find_leaf(properties, leaf_node);
         coder.write_int(chances, min, max, val);
     }
 
 template <typename BitChance, typename RAC, int bits>
 void FinalPropertySymbolCoder<BitChance,RAC,bits>::write_int(const Properties &properties, int nbits, int val) {
         assert(properties.size() == nb_properties);
-        FinalCompoundSymbolChances<BitChance,bits> &chances = find_leaf(properties);
+        FinalCompoundSymbolChances<BitChance,bits> &chances = tree.find_leaf(properties, leaf_node);
         coder.write_int(chances, nbits, val);
     }
 
@@ -212,11 +299,11 @@ private:
 
         // split leaf node if some virtual context is performing (significantly) better
         if(result.best_property != -1
-           && result.realSize > result.virtSize[result.best_property] + split_threshold
+           && result.realSize > result.virtSize(result.best_property) + split_threshold
            && current_ranges[result.best_property].first < current_ranges[result.best_property].second) {
 
           int8_t p = result.best_property;
-          PropertyVal splitval = div_down(result.virtPropSum[p],result.count);
+          PropertyVal splitval = div_down(result.virtPropSum(p),result.count);
           if (splitval >= current_ranges[result.best_property].second)
              splitval = current_ranges[result.best_property].second-1; // == does happen because of rounding and running average
 
@@ -249,8 +336,8 @@ private:
         for(unsigned int i=0; i<nb_properties; i++) {
             assert(properties[i] >= range[i].first);
             assert(properties[i] <= range[i].second);
-            chances.virtPropSum[i] += properties[i];
-            PropertyVal splitval = div_down(chances.virtPropSum[i],chances.count);
+            chances.virtPropSum(i) += properties[i];
+            PropertyVal splitval = div_down(chances.virtPropSum(i),chances.count);
             selection[i] = (properties[i] > splitval);
         }
     }
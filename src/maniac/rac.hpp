@@ -22,6 +22,7 @@ limitations under the License.
 #include <stdio.h>
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 #include <assert.h>
 #include "../config.h"
@@ -59,12 +60,26 @@ private:
 #endif
     rac_t range;
     rac_t low;
+    // local window on the input, refilled from io in blocks instead of one get_c() per byte
+    uint8_t buffer[RAC_INPUT_BUFFER_SIZE];
+    const uint8_t *next_byte;
+    const uint8_t *end_byte;
+    bool eos;
 private:
-    rac_t read_catch_eof() {
-        rac_t c = io.get_c();
-        // no reason to branch here to catch end-of-stream, just return garbage (0xFF I guess) if a premature EOS happens
-        //if(c == io.EOS) return 0;
-        return c;
+    rac_t refill() {
+        size_t n = io.read_block(buffer, RAC_INPUT_BUFFER_SIZE);
+        next_byte = buffer;
+        end_byte = buffer + n;
+        if (n == 0) {
+            eos = true;
+            // no reason to branch here to catch end-of-stream, just return garbage (0xFF I guess) if a premature EOS happens
+            return io.EOS;
+        }
+        return *next_byte++;
+    }
+    rac_t inline read_catch_eof() {
+        if (next_byte < end_byte) return *next_byte++;
+        return refill();
     }
     void inline input() {
         if (range <= Config::MIN_RANGE) {
@@ -96,7 +111,7 @@ private:
         }
     }
 public:
-    explicit RacInput(IO& ioin) : io(ioin), range(Config::BASE_RANGE), low(0) {
+    explicit RacInput(IO& ioin) : io(ioin), range(Config::BASE_RANGE), low(0), next_byte(buffer), end_byte(buffer), eos(false) {
 #ifdef STATS
         samples = 0;
 #endif
@@ -114,6 +129,29 @@ public:
     }
 #endif
 
+    // true if the range coder tried to read beyond the end of the input
+    bool isEOF() const {
+        return eos;
+    }
+
+    // position in the input of the next byte the range coder will consume (bytes still in the window don't count)
+    long ftell() const {
+        long pos = io.ftell();
+        if (pos < 0) return pos;
+        return pos - (end_byte - next_byte);
+    }
+
+    // the bytes read from io that the range coder hasn't consumed (at the end of a stream closed with
+    // RacOutput::close(), this is where whatever follows the stream starts, see ResumeReader)
+    IO& source() const { return io; }
+    const uint8_t *read_ahead() const { return next_byte; }
+    size_t read_ahead_size() const { return end_byte - next_byte; }
+
+    // right after construction: everything the range coder has read from io so far, including the bytes it started
+    // with (for input that isn't a range coder stream after all, and can't be read again by seeking back)
+    const uint8_t *window() const { return buffer; }
+    size_t window_size() const { return end_byte - buffer; }
+
     bool inline read_12bit_chance(uint16_t b12) ATTRIBUTE_HOT {
         return get(Config::chance_12bit_chance(b12, range));
     }
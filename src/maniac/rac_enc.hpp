@@ -77,6 +77,14 @@ public:
         put(range >> 1, bit);
     }
 
+    // how many bytes of the stream (counted from its start) a RacInput needs to read every symbol written so far:
+    // the generated bytes, including those that still wait for a possible carry, and the bytes of low it starts with
+    long bytes_needed() const {
+        long needed = io.ftell() + (delayed_byte >= 0 ? 1 : 0) + delayed_count;
+        for (rac_t r = Config::BASE_RANGE; r > 1; r >>= 8) needed++;
+        return needed;
+    }
+
     void inline flush() {
         low += (Config::MIN_RANGE - 1);
         // is this the correct way to reliably flush?
@@ -90,6 +98,23 @@ public:
           output();
         io.flush();
     }
+
+    // end the stream such that a RacInput has read exactly the written bytes after the last symbol,
+    // so something else can follow (flush() leaves the decoder a few bytes ahead, which is fine at the end of a file)
+    void close() {
+        // the decoder keeps MAX_RANGE_BITS of code in low: output the current low, which is inside the final interval
+        for (rac_t r = Config::BASE_RANGE; r > 1; r >>= 8) {
+            range = Config::MIN_RANGE - 1;
+            output();
+        }
+        // low can't grow anymore, so the pending bytes can't get a carry
+        io.fputc(delayed_byte);
+        while (delayed_count) {
+            io.fputc(0xFF);
+            delayed_count--;
+        }
+        delayed_byte = -1;
+    }
 };
 
 
@@ -0,0 +1,124 @@
+/*
+FLIF - Free Lossless Image Format
+
+Copyright 2010-2016, Jon Sneyers & Pieter Wuille
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+#include "../config.h"
+#include "../compiler-specific.hpp"
+
+/* Binary rANS coder, an alternative to the range coder with the same interface (12-bit chances).
+
+   The symbols are split in blocks of RANS_BLOCK_SIZE binary decisions. Every block is coded
+   with two interleaved rANS states (decision i of a block uses state i%2), so consecutive
+   decisions don't depend on each other's renormalization. A block starts with the initial
+   value of both states (4 bytes each, little endian), followed by the renormalization bytes.
+   A decoder knows where a block ends because it knows how many decisions it has read. */
+
+// rANS states are kept in [RANS_L, RANS_L << 8)
+#define RANS_L (1u << 23)
+#define RANS_PROB_BITS 12
+
+template <typename IO> class RansInput {
+protected:
+    IO& io;
+private:
+    uint32_t state[2];
+    int current;
+    uint32_t left;
+    uint8_t buffer[RAC_INPUT_BUFFER_SIZE];
+    const uint8_t *next_byte;
+    const uint8_t *end_byte;
+    bool eos;
+private:
+    uint32_t refill() {
+        size_t n = io.read_block(buffer, RAC_INPUT_BUFFER_SIZE);
+        next_byte = buffer;
+        end_byte = buffer + n;
+        if (n == 0) {
+            eos = true;
+            // garbage after a premature end of the stream, but nonzero so renormalization terminates
+            return 0xFF;
+        }
+        return *next_byte++;
+    }
+    uint32_t inline read_catch_eof() {
+        if (next_byte < end_byte) return *next_byte++;
+        return refill();
+    }
+    void start_block() {
+        for (int i = 0; i < 2; i++) {
+            uint32_t x = 0;
+            for (int b = 0; b < 32; b += 8) x |= read_catch_eof() << b;
+            state[i] = x;
+        }
+        current = 0;
+        left = RANS_BLOCK_SIZE;
+    }
+    bool inline get(uint32_t chance) {
+        assert(chance > 0);
+        assert(chance < (1u << RANS_PROB_BITS));
+        if (left == 0) start_block();
+        left--;
+        uint32_t &x = state[current];
+        current ^= 1;
+        uint32_t s = x & ((1u << RANS_PROB_BITS) - 1);
+        bool bit = s < chance;
+        // a 1 bit has slots [0,chance), a 0 bit has slots [chance,4096)
+        if (bit) x = chance * (x >> RANS_PROB_BITS) + s;
+        else x = ((1u << RANS_PROB_BITS) - chance) * (x >> RANS_PROB_BITS) + s - chance;
+        while (x < RANS_L) x = (x << 8) | read_catch_eof();
+        return bit;
+    }
+public:
+    explicit RansInput(IO& ioin) : io(ioin), current(0), left(0), next_byte(buffer), end_byte(buffer), eos(false) {
+        state[0] = state[1] = RANS_L;
+    }
+
+    // true if the decoder tried to read beyond the end of the input
+    bool isEOF() const {
+        return eos;
+    }
+
+    // position in the input of the next byte the decoder will consume
+    long ftell() const {
+        long pos = io.ftell();
+        if (pos < 0) return pos;
+        return pos - (end_byte - next_byte);
+    }
+
+    // the bytes read from io that the decoder hasn't consumed (after the last decision of a stream, this is where
+    // whatever follows the stream starts, like with RacInput::read_ahead)
+    IO& source() const { return io; }
+    const uint8_t *read_ahead() const { return next_byte; }
+    size_t read_ahead_size() const { return end_byte - next_byte; }
+
+    bool inline read_12bit_chance(uint16_t b12) ATTRIBUTE_HOT {
+        return get(b12);
+    }
+
+    bool inline read_bit() {
+        return get(1u << (RANS_PROB_BITS - 1));
+    }
+};
+
+#ifdef HAS_ENCODER
+#include "rans_enc.hpp"
+#endif
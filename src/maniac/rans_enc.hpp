@@ -0,0 +1,83 @@
+/*
+ FLIF encoder - Free Lossless Image Format
+ Copyright (C) 2010-2015  Jon Sneyers & Pieter Wuille, LGPL v3+
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+// rANS has to encode in reverse, so the decisions of a block are collected first
+template <typename IO> class RansOutput {
+protected:
+    IO& io;
+private:
+    // (chance << 1) | bit
+    std::vector<uint16_t> symbols;
+    std::vector<uint8_t> bytes;
+
+    void encode_block() {
+        if (symbols.empty()) return;
+        // a decision costs at most RANS_PROB_BITS bits, so at most 2 renormalization bytes
+        bytes.resize(symbols.size() * 2 + 8);
+        uint8_t *end = bytes.data() + bytes.size();
+        uint8_t *ptr = end;
+        uint32_t state[2] = {RANS_L, RANS_L};
+        for (size_t i = symbols.size(); i-- > 0; ) {
+            uint32_t &x = state[i & 1];
+            uint32_t chance = symbols[i] >> 1;
+            bool bit = symbols[i] & 1;
+            uint32_t freq = (bit ? chance : (1u << RANS_PROB_BITS) - chance);
+            uint32_t start = (bit ? 0 : chance);
+            uint32_t x_max = ((RANS_L >> RANS_PROB_BITS) << 8) * freq;
+            while (x >= x_max) {
+                *--ptr = x & 0xFF;
+                x >>= 8;
+            }
+            x = ((x / freq) << RANS_PROB_BITS) + (x % freq) + start;
+        }
+        for (int i = 1; i >= 0; i--) {
+            ptr -= 4;
+            for (int b = 0; b < 4; b++) ptr[b] = (state[i] >> (8*b)) & 0xFF;
+        }
+        assert(ptr >= bytes.data());
+        while (ptr < end) io.fputc(*ptr++);
+        symbols.clear();
+    }
+    void inline put(uint32_t chance, bool bit) {
+        assert(chance > 0);
+        assert(chance < (1u << RANS_PROB_BITS));
+        symbols.push_back((chance << 1) | bit);
+        if (symbols.size() == RANS_BLOCK_SIZE) encode_block();
+    }
+public:
+    RansOutput(IO& ioin) : io(ioin) {
+        symbols.reserve(RANS_BLOCK_SIZE);
+    }
+
+    void inline write_12bit_chance(uint16_t b12, bool bit) {
+        put(b12, bit);
+    }
+
+    void inline write_bit(bool bit) {
+        put(1u << (RANS_PROB_BITS - 1), bit);
+    }
+
+    void flush() {
+        encode_block();
+        io.flush();
+    }
+};
@@ -250,11 +250,11 @@ template <typename BitChance, typename RAC, int bits> class SimpleSymbolCoder {
 
 private:
     SymbolChance<BitChance,bits> ctx;
-    const Table table;
+    std::shared_ptr<const Table> table;
     RAC &rac;
 
 public:
-    SimpleSymbolCoder(RAC& racIn, int cut = 2, int alpha = 0xFFFFFFFF / 19) :  table(cut,alpha), rac(racIn) {
+    SimpleSymbolCoder(RAC& racIn, int cut = 2, int alpha = 0xFFFFFFFF / 19) :  table(shared_chance_table<Table>(cut,alpha)), rac(racIn) {
     }
 
 #ifdef HAS_ENCODER
@@ -271,7 +271,7 @@ public:
 #endif
 
     int read_int(int min, int max) {
-        SimpleSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, ctx, rac);
+        SimpleSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, ctx, rac);
         return reader<bits, SimpleSymbolBitCoder<BitChance, RAC, bits>>(bitCoder, min, max);
     }
     int read_int2(int min, int max) {
@@ -284,7 +284,7 @@ public:
     }
     int read_int(int nbits) {
         assert (nbits <= bits);
-        SimpleSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, ctx, rac);
+        SimpleSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, ctx, rac);
         return reader(bitCoder, nbits);
     }
 };
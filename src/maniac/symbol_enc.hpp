@@ -120,12 +120,12 @@ void SimpleSymbolBitCoder<BitChance,RAC,bits>::write(bool bit, SymbolChanceBitTy
 
 template <typename BitChance, typename RAC, int bits>
 void SimpleSymbolCoder<BitChance,RAC,bits>::write_int(int min, int max, int value) {
-        SimpleSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, ctx, rac);
+        SimpleSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, ctx, rac);
         writer<bits, SimpleSymbolBitCoder<BitChance, RAC, bits> >(bitCoder, min, max, value);
 }
 template <typename BitChance, typename RAC, int bits>
 void SimpleSymbolCoder<BitChance,RAC,bits>::write_int(int nbits, int value) {
         assert (nbits <= bits);
-        SimpleSymbolBitCoder<BitChance, RAC, bits> bitCoder(table, ctx, rac);
+        SimpleSymbolBitCoder<BitChance, RAC, bits> bitCoder(*table, ctx, rac);
         writer(bitCoder, nbits, value);
 }
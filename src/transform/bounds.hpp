@@ -71,6 +71,7 @@ protected:
     std::vector<std::pair<ColorVal, ColorVal> > bounds;
 
     bool undo_redo_during_decode() override { return false; }
+    bool undo_by_rows() const override { return true; } // nothing to undo
 
     const ColorRanges *meta(Images&, const ColorRanges *srcRanges) override {
         if (srcRanges->isStatic()) {
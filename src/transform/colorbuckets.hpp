@@ -39,8 +39,11 @@ const unsigned int max_per_colorbucket[] = {MAX_PER_BUCKET_0, MAX_PER_BUCKET_1,
 #define CB1 4
 
 
-static int totaldiscretecolors=0;
-static int totalcontinuousbuckets=0;
+// number of discrete colors and continuous buckets of one ColorBuckets (used by the encoder to decide whether to use it)
+struct ColorBucketTotals {
+    int discretecolors = 0;
+    int continuousbuckets = 0;
+};
 
 typedef int16_t ColorValCB; // not doing this transform for high-bit-depth images anyway
 
@@ -57,7 +60,7 @@ public:
         max = -10000; // -infinity    (set to empty interval to start with)
         discrete = true;
     }
-    void addColor(const ColorVal c, const unsigned int max_per_bucket) {
+    void addColor(const ColorVal c, const unsigned int max_per_bucket, ColorBucketTotals &totals) {
         if (c<min) min=c;
         if (c>max) max=c;
         if (discrete) {
@@ -68,12 +71,12 @@ public:
           }
           if (values.size() < max_per_bucket) {
                 values.insert(values.begin()+pos, c);
-                totaldiscretecolors++;
+                totals.discretecolors++;
           } else {
-                totaldiscretecolors -= max_per_bucket;
+                totals.discretecolors -= max_per_bucket;
                 values.clear();
                 discrete=false;
-                totalcontinuousbuckets++;
+                totals.continuousbuckets++;
           }
         }
     }
@@ -136,25 +139,25 @@ public:
                 }
         }
     }
-    void simplify_lossless() {
+    void simplify_lossless(ColorBucketTotals &totals) {
         if (discrete) {
                 if ((int)values.size() == max-min+1) {
                         discrete=false;  // bucket actually contains a continuous range
-                        totaldiscretecolors -= values.size();
-                        totalcontinuousbuckets++;
+                        totals.discretecolors -= values.size();
+                        totals.continuousbuckets++;
                         values.clear();
                 }
         }
     }
-    void simplify(int percent) {
+    void simplify(int percent, ColorBucketTotals &totals) {
         if (empty()) return;
-        simplify_lossless();
+        simplify_lossless(totals);
         if (discrete) {
                 // heuristic: turn discrete bucket into a continuous one if it is dense enough
                 if ((int)values.size()-2 > (max-min-1)*percent/100) {
                         discrete=false; // more than <percent> of the ]min,max[ values are present
-                        totaldiscretecolors -= values.size();
-                        totalcontinuousbuckets++;
+                        totals.discretecolors -= values.size();
+                        totals.continuousbuckets++;
                         values.clear();
                 }
         }
@@ -207,6 +210,7 @@ public:
     ColorBucket bucket3;
     ColorBucket empty_bucket;
     const ColorRanges *ranges;
+    ColorBucketTotals totals;
     explicit ColorBuckets(const ColorRanges *r) : bucket0(), min0(r->min(0)), min1(r->min(1)),
                                          bucket1((r->max(0) - min0)/CB0a +1),
                                          bucket2((r->max(0) - min0)/CB0b +1, std::vector<ColorBucket>((r->max(1) - min1)/CB1 +1)),
@@ -236,7 +240,7 @@ public:
     }
     void addColor(const std::vector<ColorVal> &pixel) {
         for (unsigned int p=0; p < pixel.size(); p++) {
-                findBucket(p, pixel).addColor(pixel[p],max_per_colorbucket[p]);
+                findBucket(p, pixel).addColor(pixel[p],max_per_colorbucket[p],totals);
         }
     }
 
@@ -333,6 +337,7 @@ protected:
     bool really_used;
 
     bool undo_redo_during_decode() override { return false; }
+    bool undo_by_rows() const override { return true; } // nothing to undo
 
     const ColorRanges* meta(Images&, const ColorRanges *srcRanges) override {
 //        cb->print();
@@ -553,36 +558,37 @@ protected:
                     ColorVal v = image(p,r,c);
                     pixel[p] = v;
                   }
-                  if (image.alpha_zero_special && p>3 && pixel[3]==0) { cb->findBucket(3, pixel).addColor(0,max_per_colorbucket[3]); continue;}
+                  if (image.alpha_zero_special && p>3 && pixel[3]==0) { cb->findBucket(3, pixel).addColor(0,max_per_colorbucket[3],cb->totals); continue;}
                   cb->addColor(pixel);
                 }
             }
 
-            cb->bucket0.simplify_lossless();
-            cb->bucket3.simplify_lossless();
-            for (auto& b : cb->bucket1) b.simplify_lossless();
-            for (auto& bv : cb->bucket2) for (auto& b : bv) b.simplify_lossless();
+            ColorBucketTotals &totals = cb->totals;
+            cb->bucket0.simplify_lossless(totals);
+            cb->bucket3.simplify_lossless(totals);
+            for (auto& b : cb->bucket1) b.simplify_lossless(totals);
+            for (auto& bv : cb->bucket2) for (auto& b : bv) b.simplify_lossless(totals);
 
 
         // TODO: IMPROVE THESE HEURISTICS!
         // TAKE IMAGE SIZE INTO ACCOUNT!
         // CONSIDER RELATIVE AREA OF BUCKETS / BOUNDS!
 
-//            printf("Filled color buckets with %i discrete colors + %i continous buckets\n",totaldiscretecolors,totalcontinuousbuckets);
+//            printf("Filled color buckets with %i discrete colors + %i continous buckets\n",totals.discretecolors,totals.continuousbuckets);
 
             int64_t total_pixels = (int64_t) images.size() * images[0].rows() * images[0].cols();
-            v_printf(7,", [D=%i,C=%i,P=%i]",totaldiscretecolors,totalcontinuousbuckets,(int) (total_pixels/100));
+            v_printf(7,", [D=%i,C=%i,P=%i]",totals.discretecolors,totals.continuousbuckets,(int) (total_pixels/100));
             if (total_pixels > 5000000) total_pixels = 5000000; // let's discourage using ColorBuckets just because the image is big
-            if (totaldiscretecolors < total_pixels/200 && totalcontinuousbuckets < total_pixels/50) return true;
-            if (totaldiscretecolors < total_pixels/100 && totalcontinuousbuckets < total_pixels/200) return true;
-            if (totaldiscretecolors < total_pixels/40 && totalcontinuousbuckets < total_pixels/500) return true;
+            if (totals.discretecolors < total_pixels/200 && totals.continuousbuckets < total_pixels/50) return true;
+            if (totals.discretecolors < total_pixels/100 && totals.continuousbuckets < total_pixels/200) return true;
+            if (totals.discretecolors < total_pixels/40 && totals.continuousbuckets < total_pixels/500) return true;
 
             // simplify buckets
             for (int factor = 95; factor >= 35; factor -= 10) {
-                for (auto& b : cb->bucket1) b.simplify(factor);
-                for (auto& bv : cb->bucket2) for (auto& b : bv) b.simplify(factor-20);
-                v_printf(8,"->[D=%i,C=%i]",totaldiscretecolors,totalcontinuousbuckets);
-                if (totaldiscretecolors < total_pixels/200 && totalcontinuousbuckets < total_pixels/100) return true;
+                for (auto& b : cb->bucket1) b.simplify(factor, totals);
+                for (auto& bv : cb->bucket2) for (auto& b : bv) b.simplify(factor-20, totals);
+                v_printf(8,"->[D=%i,C=%i]",totals.discretecolors,totals.continuousbuckets);
+                if (totals.discretecolors < total_pixels/200 && totals.continuousbuckets < total_pixels/100) return true;
             }
             return false;
     }
@@ -53,4 +53,5 @@ std::unique_ptr<Transform<IO>> create_transform(const std::string &desc) {
 
 template std::unique_ptr<Transform<FileIO>> create_transform(const std::string &desc);
 template std::unique_ptr<Transform<BlobReader>> create_transform(const std::string &desc);
+template std::unique_ptr<Transform<StreamReader>> create_transform(const std::string &desc);
 template std::unique_ptr<Transform<BlobIO>> create_transform(const std::string &desc);
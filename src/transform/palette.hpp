@@ -58,6 +58,27 @@ protected:
     bool ordered_palette;
     bool has_alpha;
 
+    void undo_rows(Image& image, uint32_t begin, uint32_t end, uint32_t strideCol, uint32_t strideRow) const {
+          image.undo_make_constant_plane(0);
+          image.undo_make_constant_plane(1);
+          image.undo_make_constant_plane(2);
+
+          const uint32_t scaledCols = image.scaledCols();
+
+          for (uint32_t r=begin; r<end; r+=strideRow) {
+            for (uint32_t c=0; c<scaledCols; c+=strideCol) {
+                int P=image(1,r,c);
+                if (P < 0 || P >= (int) Palette_vector.size()) P = 0; // might happen on invisible pixels with predictor -H1
+                assert(P < (int) Palette_vector.size());
+                assert(P >= 0);
+                const Color &value = Palette_vector[P];
+                image.set(0,r,c, std::get<0>(value));
+                image.set(1,r,c, std::get<1>(value));
+                image.set(2,r,c, std::get<2>(value));
+            }
+          }
+    }
+
 public:
     // if the image also has alpha, this transform is not a 'real' palette transform
     // (in the sense of PNG)
@@ -87,25 +108,14 @@ public:
     void invData(Images& images, uint32_t strideCol, uint32_t strideRow) const override {
 //        v_printf(5,"invData Palette\n");
         for (Image& image : images) {
-          image.undo_make_constant_plane(0);
-          image.undo_make_constant_plane(1);
-          image.undo_make_constant_plane(2);
-
-          const uint32_t scaledRows = image.scaledRows();
-          const uint32_t scaledCols = image.scaledCols();
-
-          for (uint32_t r=0; r<scaledRows; r+=strideRow) {
-            for (uint32_t c=0; c<scaledCols; c+=strideCol) {
-                int P=image(1,r,c);
-                if (P < 0 || P >= (int) Palette_vector.size()) P = 0; // might happen on invisible pixels with predictor -H1
-                assert(P < (int) Palette_vector.size());
-                assert(P >= 0);
-                const Color &value = Palette_vector[P];
-                image.set(0,r,c, std::get<0>(value));
-                image.set(1,r,c, std::get<1>(value));
-                image.set(2,r,c, std::get<2>(value));
-            }
-          }
+          undo_rows(image, 0, image.scaledRows(), strideCol, strideRow);
+          image.palette=false;
+        }
+    }
+    bool undo_by_rows() const override { return true; }
+    void invDataRows(Images& images, uint32_t begin, uint32_t end) const override {
+        for (Image& image : images) {
+          undo_rows(image, begin, end, 1, 1);
           image.palette=false;
         }
     }
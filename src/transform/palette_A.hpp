@@ -65,6 +65,27 @@ protected:
     bool ordered_palette;
     bool already_has_palette;
 
+    void undo_rows(Image& image, uint32_t begin, uint32_t end, uint32_t strideCol, uint32_t strideRow) const {
+          image.undo_make_constant_plane(0);
+          image.undo_make_constant_plane(1);
+          image.undo_make_constant_plane(2);
+          image.undo_make_constant_plane(3);
+
+          const uint32_t scaledCols = image.scaledCols();
+
+          for (uint32_t r=begin; r<end; r+=strideRow) {
+            for (uint32_t c=0; c<scaledCols; c+=strideCol) {
+                int P=image(1,r,c);
+                assert(P < (int) Palette_vector.size());
+                const Color &value = Palette_vector[P];
+                image.set(0,r,c, std::get<1>(value));
+                image.set(1,r,c, std::get<2>(value));
+                image.set(2,r,c, std::get<3>(value));
+                image.set(3,r,c, std::get<0>(value));
+            }
+          }
+    }
+
 public:
     bool is_palette_transform() const override { return true; }
 
@@ -91,25 +112,14 @@ public:
 
     void invData(Images& images, uint32_t strideCol, uint32_t strideRow) const override {
         for (Image& image : images) {
-          image.undo_make_constant_plane(0);
-          image.undo_make_constant_plane(1);
-          image.undo_make_constant_plane(2);
-          image.undo_make_constant_plane(3);
-
-          const uint32_t scaledRows = image.scaledRows();
-          const uint32_t scaledCols = image.scaledCols();
-
-          for (uint32_t r=0; r<scaledRows; r+=strideRow) {
-            for (uint32_t c=0; c<scaledCols; c+=strideCol) {
-                int P=image(1,r,c);
-                assert(P < (int) Palette_vector.size());
-                const Color &value = Palette_vector[P];
-                image.set(0,r,c, std::get<1>(value));
-                image.set(1,r,c, std::get<2>(value));
-                image.set(2,r,c, std::get<3>(value));
-                image.set(3,r,c, std::get<0>(value));
-            }
-          }
+          undo_rows(image, 0, image.scaledRows(), strideCol, strideRow);
+          image.palette=false;
+        }
+    }
+    bool undo_by_rows() const override { return true; }
+    void invDataRows(Images& images, uint32_t begin, uint32_t end) const override {
+        for (Image& image : images) {
+          undo_rows(image, begin, end, 1, 1);
           image.palette=false;
         }
     }
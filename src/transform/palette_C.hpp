@@ -49,6 +49,27 @@ protected:
     std::vector<ColorVal> CPalette_vector[4];
     std::vector<ColorVal> CPalette_inv_vector[4];
 
+    void undo_rows(Image& image, uint32_t begin, uint32_t end) const {
+         const uint32_t scaledCols = image.scaledCols();
+
+         for (int p=0; p<image.numPlanes(); p++) {
+          const std::vector<ColorVal> &palette = CPalette_vector[p];
+          auto palette_size = palette.size();
+//          const int stretch = (palette_size > 64 ? 0 : 2);
+          image.undo_make_constant_plane(p);
+          GeneralPlane &plane = image.getPlane(p);
+          for (uint32_t r=begin; r<end; r ++) {
+            for (uint32_t c=0; c<scaledCols; c ++) {
+                int P=plane.get(r,c);
+//                image.set(p,r,c, palette[image(p,r,c) >> stretch]);
+                if (P < 0 || P >= (int) palette_size) P = 0; // might happen on invisible pixels with predictor -H1
+                assert(P < (int) palette_size);
+                plane.set(r,c, palette[P]);
+            }
+          }
+         }
+    }
+
 public:
     bool init(const ColorRanges *srcRanges) override {
         if (srcRanges->numPlanes()>4) return false; // FRA should always be done after CC, this is just to catch bad input
@@ -69,28 +90,11 @@ public:
     }
 
     void invData(Images& images, FLIF_UNUSED(uint32_t strideCol), FLIF_UNUSED(uint32_t strideRow)) const override {
-        for (Image& image : images) {
-
-         const uint32_t scaledRows = image.scaledRows();
-         const uint32_t scaledCols = image.scaledCols();
-
-         for (int p=0; p<image.numPlanes(); p++) {
-          auto palette = CPalette_vector[p];
-          auto palette_size = palette.size();
-//          const int stretch = (palette_size > 64 ? 0 : 2);
-          image.undo_make_constant_plane(p);
-          GeneralPlane &plane = image.getPlane(p);
-          for (uint32_t r=0; r<scaledRows; r ++) {
-            for (uint32_t c=0; c<scaledCols; c ++) {
-                int P=plane.get(r,c);
-//                image.set(p,r,c, palette[image(p,r,c) >> stretch]);
-                if (P < 0 || P >= (int) palette_size) P = 0; // might happen on invisible pixels with predictor -H1
-                assert(P < (int) palette_size);
-                plane.set(r,c, palette[P]);
-            }
-          }
-         }
-        }
+        for (Image& image : images) undo_rows(image, 0, image.scaledRows());
+    }
+    bool undo_by_rows() const override { return true; }
+    void invDataRows(Images& images, uint32_t begin, uint32_t end) const override {
+        for (Image& image : images) undo_rows(image, begin, end);
     }
 
 #if HAS_ENCODER
@@ -135,6 +139,10 @@ public:
         for (Image& image : images) {
          for (int p=0; p<image.numPlanes(); p++) {
 //          const int stretch = (CPalette_vector[p].size()>64 ? 0 : 2);
+          // a plane whose values are 0..n already keeps them (so an imported view does not have to copy it)
+          bool identity = true;
+          for (size_t i=0; i<CPalette_vector[p].size(); i++) if (CPalette_vector[p][i] != (ColorVal)i) identity = false;
+          if (identity) continue;
           for (uint32_t r=0; r<image.rows(); r++) {
             for (uint32_t c=0; c<image.cols(); c++) {
                 ColorVal P = CPalette_inv_vector[p][image(p,r,c)];
@@ -97,10 +97,11 @@ public:
         for (uint32_t r=0; r<image.rows(); r++) {
             for (uint32_t c=0; c<image.cols(); c++) {
                 for (int p=0; p<ranges->numPlanes(); p++) pixel[p] = image(p,r,c);
-                image.set(0,r,c, pixel[permutation[0]]);
-                if (!subtract) { for (int p=1; p<ranges->numPlanes(); p++) image.set(p,r,c, pixel[permutation[p]]); }
+                // planes that keep their values are left alone (so an imported view does not have to copy them)
+                if (permutation[0] != 0) image.set(0,r,c, pixel[permutation[0]]);
+                if (!subtract) { for (int p=1; p<ranges->numPlanes(); p++) if (permutation[p] != p) image.set(p,r,c, pixel[permutation[p]]); }
                 else { for (int p=1; p<3 && p<ranges->numPlanes(); p++) image.set(p,r,c, pixel[permutation[p]] - pixel[permutation[0]]);
-                       for (int p=3; p<ranges->numPlanes(); p++) image.set(p,r,c, pixel[permutation[p]]); }
+                       for (int p=3; p<ranges->numPlanes(); p++) if (permutation[p] != p) image.set(p,r,c, pixel[permutation[p]]); }
             }
         }
     }
@@ -135,14 +136,21 @@ public:
     }
 #define CLAMP(x,l,u) (x>u?u:(x<l?l:x))
     void invData(Images& images, uint32_t strideCol, uint32_t strideRow) const override {
-        ColorVal pixel[5];
-        for (Image& image : images) {
+        for (Image& image : images) undo_rows(image, 0, image.scaledRows(), strideCol, strideRow);
+    }
 
-          const uint32_t scaledRows = image.scaledRows();
+    bool undo_by_rows() const override { return true; }
+    void invDataRows(Images& images, uint32_t begin, uint32_t end) const override {
+        for (Image& image : images) undo_rows(image, begin, end, 1, 1);
+    }
+
+private:
+    void undo_rows(Image& image, uint32_t begin, uint32_t end, uint32_t strideCol, uint32_t strideRow) const {
+          ColorVal pixel[5];
           const uint32_t scaledCols = image.scaledCols();
 
           for (int p=0; p<ranges->numPlanes(); p++) image.undo_make_constant_plane(p);
-          for (uint32_t r=0; r<scaledRows; r+=strideRow) {
+          for (uint32_t r=begin; r<end; r+=strideRow) {
             for (uint32_t c=0; c<scaledCols; c+=strideCol) {
                 for (int p=0; p<ranges->numPlanes(); p++) pixel[p] = image(p,r,c);
                 for (int p=0; p<ranges->numPlanes(); p++) image.set(permutation[p],r,c, pixel[p]);
@@ -152,7 +160,6 @@ public:
                        for (int p=3; p<ranges->numPlanes(); p++) image.set(permutation[p],r,c, pixel[p]); }
             }
           }
-        }
     }
 };
 
@@ -51,4 +51,8 @@ public:
     const ColorRanges virtual *meta(Images&, const ColorRanges *srcRanges) { return new DupColorRanges(srcRanges); }
     void virtual invData(Images&, FLIF_UNUSED(uint32_t strideCol)=1, FLIF_UNUSED(uint32_t strideRow)=1) const {}
     bool virtual is_palette_transform() const { return false; }
+    // true if the transform is undone pixel by pixel, so a fully decoded image can be undone in bands of rows
+    bool virtual undo_by_rows() const { return false; }
+    // undoes the transform on the rows [begin, end) of fully decoded images (only called if undo_by_rows)
+    void virtual invDataRows(Images&, FLIF_UNUSED(uint32_t begin), FLIF_UNUSED(uint32_t end)) const {}
 };
@@ -104,17 +104,25 @@ public:
     }
 #endif
     void invData(Images& images, uint32_t strideCol, uint32_t strideRow) const override {
-        ColorVal R,G,B,Y,C1,C2;
-        const ColorVal max[3] = {ranges->max(0), ranges->max(1), ranges->max(2)};
-        for (Image& image : images) {
+        for (Image& image : images) undo_rows(image, 0, image.scaledRows(), strideCol, strideRow);
+    }
+
+    bool undo_by_rows() const override { return true; }
+    void invDataRows(Images& images, uint32_t begin, uint32_t end) const override {
+        for (Image& image : images) undo_rows(image, begin, end, 1, 1);
+    }
+
+private:
+    void undo_rows(Image& image, uint32_t begin, uint32_t end, uint32_t strideCol, uint32_t strideRow) const {
+          ColorVal R,G,B,Y,C1,C2;
+          const ColorVal max[3] = {ranges->max(0), ranges->max(1), ranges->max(2)};
           image.undo_make_constant_plane(0);
           image.undo_make_constant_plane(1);
           image.undo_make_constant_plane(2);
 
-          const uint32_t scaledRows = image.scaledRows();
           const uint32_t scaledCols = image.scaledCols();
 
-          for (uint32_t r=0; r<scaledRows; r+=strideRow) {
+          for (uint32_t r=begin; r<end; r+=strideRow) {
             for (uint32_t c=0; c<scaledCols; c+=strideCol) {
                 Y=image(0,r,c);
                 C1=image(1,r,c);
@@ -132,7 +140,6 @@ public:
                 image.set(2,r,c, B);
             }
           }
-        }
     }
 };
 
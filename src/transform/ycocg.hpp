@@ -226,13 +226,21 @@ public:
     }
 #endif
     void invData(Images& images, uint32_t strideCol, uint32_t strideRow) const override {
-        const ColorVal max[3] = {ranges->max(0), ranges->max(1), ranges->max(2)};
-        for (Image& image : images) {
+        for (Image& image : images) undo_rows(image, 0, image.scaledRows(), strideCol, strideRow);
+    }
+
+    bool undo_by_rows() const override { return true; }
+    void invDataRows(Images& images, uint32_t begin, uint32_t end) const override {
+        for (Image& image : images) undo_rows(image, begin, end, 1, 1);
+    }
+
+private:
+    void undo_rows(Image& image, uint32_t begin, uint32_t end, uint32_t strideCol, uint32_t strideRow) const {
+          const ColorVal max[3] = {ranges->max(0), ranges->max(1), ranges->max(2)};
           image.undo_make_constant_plane(0);
           image.undo_make_constant_plane(1);
           image.undo_make_constant_plane(2);
 
-          const uint32_t scaledRows = image.scaledRows();
           const uint32_t scaledCols = image.scaledCols();
 
 #ifdef USE_SIMD
@@ -242,7 +250,10 @@ public:
             Plane<ColorVal_intern_16>& p1 = static_cast<Plane<ColorVal_intern_16>&>(image.getPlane(1));
             Plane<ColorVal_intern_16>& p2 = static_cast<Plane<ColorVal_intern_16>&>(image.getPlane(2));
             EightColorVals R,G,B,Y,Co,Cg;
-            for (uint32_t pos=0; pos < scaledRows*scaledCols; pos += 8) {
+            // whole groups of eight values: a group that straddles two bands belongs to the first one
+            const size_t first = ((size_t)begin * scaledCols + 7) & ~(size_t)7;
+            const size_t last = (end >= image.scaledRows() ? p0.values() : ((size_t)end * scaledCols + 7) & ~(size_t)7);
+            for (size_t pos=first; pos < last; pos += 8) {
                 Y = p0.get8(pos);
                 Co = p1.get8(pos);
                 Cg = p2.get8(pos);
@@ -262,7 +273,7 @@ public:
           // general code, without SIMD
           {
           ColorVal R,G,B,Y,Co,Cg;
-          for (uint32_t r=0; r<scaledRows; r+=strideRow) {
+          for (uint32_t r=begin; r<end; r+=strideRow) {
             for (uint32_t c=0; c<scaledCols; c+=strideCol) {
                 Y=image(0,r,c);
                 Co=image(1,r,c);
@@ -296,7 +307,6 @@ public:
             }
           }
           }
-        }
     }
 };
 
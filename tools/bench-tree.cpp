@@ -0,0 +1,182 @@
+/*
+ Microbenchmark for MANIAC tree lookups during decoding.
+
+ Decodes the given FLIF files while recording every decoded tree and the property vectors that are looked up in it,
+ then replays those lookups with the old walk over std::vector<PropertyDecisionNode> (which updates the lazy split
+ counters in the tree itself) and with FinalTree. Both have to find the same leaves.
+
+ Build in src/ with "make bench-tree", then run "./bench-tree photo.flif..." (use large photos: they have deep trees).
+*/
+
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+
+// the decoder is compiled into this file, so it can be instantiated for BenchIO below
+#include "../src/maniac/compound.hpp"
+#include "../src/flif_config.h"
+#include "../src/fileio.hpp"
+
+class BenchIO : public BlobReader {
+public:
+    BenchIO(const uint8_t* data, size_t size) : BlobReader(data, size) {}
+};
+
+struct Recording {
+    Tree tree;
+    int nb_properties;
+    std::vector<PropertyVal> properties;    // nb_properties values per lookup
+};
+static std::vector<std::unique_ptr<Recording>> recordings;
+static size_t recorded_values = 0;
+static const size_t max_recorded_values = 1 << 27;
+
+// the coder used when decoding from a BenchIO: decodes like FinalPropertySymbolCoder, but also records the lookups
+template <typename BitChance, int bits> class FinalPropertySymbolCoder<BitChance, RacIn<BenchIO>, bits> {
+private:
+    FinalCompoundSymbolCoder<BitChance, RacIn<BenchIO>, bits> coder;
+    std::vector<FinalCompoundSymbolChances<BitChance,bits> > leaf_node;
+    FinalTree tree;
+    Recording *recording;
+
+    FinalCompoundSymbolChances<BitChance,bits> &find_leaf(const Properties &properties) {
+        if (recording && recorded_values < max_recorded_values) {
+            recording->properties.insert(recording->properties.end(), properties.begin(), properties.end());
+            recorded_values += properties.size();
+        }
+        return tree.find_leaf(properties, leaf_node);
+    }
+
+public:
+    FinalPropertySymbolCoder(RacIn<BenchIO>& racIn, Ranges &rangeIn, const Tree &treeIn, int = 0, int cut = 4, int alpha = 0xFFFFFFFF / 20) :
+        coder(racIn, cut, alpha), leaf_node(1), tree(treeIn), recording(NULL) {
+        if (treeIn.size() > 1) {
+            recordings.emplace_back(new Recording());
+            recording = recordings.back().get();
+            recording->tree = treeIn;
+            recording->nb_properties = rangeIn.size();
+        }
+    }
+
+    uint32_t used_properties() const {
+        return tree.used_properties();
+    }
+
+    int read_int(const Properties &properties, int min, int max) {
+        if (min == max) { return min; }
+        return coder.read_int(find_leaf(properties), min, max);
+    }
+    int read_int(const Properties &properties, int nbits) {
+        return coder.read_int(find_leaf(properties), nbits);
+    }
+};
+
+#include "../src/flif-dec.cpp"
+#include "../src/transform/factory.cpp"
+
+template bool flif_decode(BenchIO& io, Images &images, callback_t callback, void *user_data, int, Images &partial_images, flif_options &, metadata_options &, FLIF_INFO* info);
+template std::unique_ptr<Transform<BenchIO>> create_transform(const std::string &desc);
+
+// the walk FinalPropertySymbolCoder used to do, returning leaf indices
+static uint32_t legacy_find_leaf(Tree &inner_node, uint32_t &nb_leaves, const Properties &properties) {
+    Tree::size_type pos = 0;
+    while(inner_node[pos].property != -1) {
+        if (inner_node[pos].count < 0) {
+            if (properties[inner_node[pos].property] > inner_node[pos].splitval) {
+              pos = inner_node[pos].childID;
+            } else {
+              pos = inner_node[pos].childID+1;
+            }
+        } else if (inner_node[pos].count > 0) {
+            inner_node[pos].count--;
+            break;
+        } else if (inner_node[pos].count == 0) {
+            inner_node[pos].count--;
+            uint32_t old_leaf = inner_node[pos].leafID;
+            uint32_t new_leaf = nb_leaves++;
+            inner_node[inner_node[pos].childID].leafID = old_leaf;
+            inner_node[inner_node[pos].childID+1].leafID = new_leaf;
+            if (properties[inner_node[pos].property] > inner_node[pos].splitval) {
+              return old_leaf;
+            } else {
+              return new_leaf;
+            }
+        }
+    }
+    return inner_node[pos].leafID;
+}
+
+struct Leaf {
+    uint32_t dummy;
+};
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: %s file.flif...\n", argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        FILE *f = fopen(argv[i], "rb");
+        if (!f) { printf("Could not open %s\n", argv[i]); return 1; }
+        std::vector<uint8_t> data;
+        uint8_t buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+        fclose(f);
+        BenchIO io(data.data(), data.size());
+        Images images;
+        flif_options options = FLIF_DEFAULT_OPTIONS;
+        metadata_options md = {false, false, false};
+        if (!flif_decode(io, images, options, md)) { printf("Could not decode %s\n", argv[i]); return 1; }
+    }
+
+    size_t lookups = 0, nodes = 0;
+    for (auto &r : recordings) {
+        lookups += r->properties.size() / r->nb_properties;
+        nodes += r->tree.size();
+    }
+    printf("%u trees, %u nodes, %u lookups\n", (unsigned int) recordings.size(), (unsigned int) nodes, (unsigned int) lookups);
+    if (!lookups) return 1;
+
+    const int repeats = 5;
+    double best_legacy = 1e30, best_final = 1e30;
+    for (int rep = 0; rep < repeats; rep++) {
+        uint64_t checksum_legacy = 0, checksum_final = 0;
+        double time_legacy = 0, time_final = 0;
+        for (auto &r : recordings) {
+            const size_t count = r->properties.size() / r->nb_properties;
+            Properties properties(r->nb_properties);
+            std::vector<uint32_t> found(count);
+
+            Tree tree = r->tree;
+            uint32_t nb_leaves = 1;
+            tree[0].leafID = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t l = 0; l < count; l++) {
+                std::copy(&r->properties[l * r->nb_properties], &r->properties[l * r->nb_properties] + r->nb_properties, properties.begin());
+                found[l] = legacy_find_leaf(tree, nb_leaves, properties);
+            }
+            time_legacy += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            for (size_t l = 0; l < count; l++) checksum_legacy += found[l] * (l + 1);
+
+            FinalTree final_tree(r->tree);
+            std::vector<Leaf> leaves(1);
+            start = std::chrono::steady_clock::now();
+            for (size_t l = 0; l < count; l++) {
+                std::copy(&r->properties[l * r->nb_properties], &r->properties[l * r->nb_properties] + r->nb_properties, properties.begin());
+                found[l] = &final_tree.find_leaf(properties, leaves) - leaves.data();
+            }
+            time_final += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            for (size_t l = 0; l < count; l++) checksum_final += found[l] * (l + 1);
+        }
+        if (checksum_legacy != checksum_final) {
+            printf("Error: FinalTree found different leaves than the old walk\n");
+            return 1;
+        }
+        if (time_legacy < best_legacy) best_legacy = time_legacy;
+        if (time_final < best_final) best_final = time_final;
+    }
+    printf("vector<PropertyDecisionNode>: %7.2f M lookups/s\n", lookups / best_legacy / 1e6);
+    printf("FinalTree:                    %7.2f M lookups/s\n", lookups / best_final / 1e6);
+    return 0;
+}
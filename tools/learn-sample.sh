@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# Size/time trade-off of sampled MANIAC learning (-l N).
+# Usage: learn-sample.sh path/to/flif "extra encode options" image...
+# Prints one line per image and -l value: pixels, compressed size, size relative to -l1, encode time.
+
+FLIF=$1
+FLAGS=$2
+shift 2
+SAMPLES="1 2 4 8 16"
+OUT=$(mktemp --suffix=.flif)
+
+printf "%-40s %10s %4s %10s %8s %8s\n" image pixels -l bytes size time
+for image in "$@"; do
+    base=""
+    for n in $SAMPLES; do
+        start=$(date +%s%N)
+        $FLIF -e -o $FLAGS -l $n "$image" "$OUT" || exit 1
+        end=$(date +%s%N)
+        size=$(stat -c %s "$OUT")
+        if [ -z "$base" ]; then
+            base=$size
+            pixels=$($FLIF -i "$OUT" | grep -o '[0-9]*x[0-9]*' | head -1 | awk -Fx '{print $1*$2}')
+        fi
+        printf "%-40s %10s %4s %10s %7.2f%% %7.2fs\n" "$(basename "$image")" "$pixels" $n $size \
+            $(awk "BEGIN {print 100*$size/$base}") $(awk "BEGIN {print ($end-$start)/1e9}")
+    done
+done
+rm -f "$OUT"
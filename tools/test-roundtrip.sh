@@ -20,3 +20,26 @@ runtest() {
 runtest -I
 
 runtest -N
+
+runtest "-I --rans"
+
+runtest "-N --rans"
+
+runtest "-z --rans -j 4" "-j 4"
+
+runtest "-I -j 4"
+
+runtest "-N -j 4"
+
+runtest "-I -l 4"
+
+runtest "-N -l 4"
+
+rm -f ${OUTF}.forest
+$FLIF -I -y ${OUTF}.forest "${IN}"
+runtest "-I -x ${OUTF}.forest"
+
+rm -f ${OUTF}.forest
+$FLIF -N -y ${OUTF}.forest "${IN}"
+runtest "-N -x ${OUTF}.forest"
+rm -f ${OUTF}.forest
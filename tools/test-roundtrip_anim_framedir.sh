@@ -43,4 +43,5 @@ runtest -I
 runtest -NL0
 runtest -SP0
 runtest -L50
+runtest "-I --rans"
 
@@ -0,0 +1,236 @@
+/*
+ Decodes the same FLIF blob on several threads at once, with and without progressive callbacks,
+ and checks that every thread gets the same image and the same sequence of callback qualities
+ as a decode on its own. Then does the same with flif_decode_batch.
+ Build it with -fsanitize=thread (make test-threads.tsan) to check for data races.
+*/
+#include <flif.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define WIDTH 256
+#define HEIGHT 256
+#define THREADS 8
+#define ROUNDS 4
+#define MAX_CALLBACKS 64
+#define BATCH_ITEMS 32
+
+typedef struct progress_log
+{
+    uint32_t qualities[MAX_CALLBACKS];
+    int count;
+} progress_log;
+
+typedef struct thread_data
+{
+    const void* blob;
+    size_t blob_size;
+    const uint8_t* reference;
+    const progress_log* reference_log;
+    int result;
+} thread_data;
+
+static void fill_dummy_image(FLIF_IMAGE* image)
+{
+    uint8_t row[WIDTH * 4];
+    uint32_t x, y;
+    for(y = 0; y < HEIGHT; ++y)
+    {
+        for(x = 0; x < WIDTH; ++x)
+        {
+            row[4*x + 0] = (uint8_t)x;
+            row[4*x + 1] = (uint8_t)(x * y);
+            row[4*x + 2] = (uint8_t)(y + (x >> 3));
+            row[4*x + 3] = (uint8_t)(x + y < 32 ? 0 : 255);
+        }
+        flif_image_write_row_RGBA8(image, y, row, sizeof(row));
+    }
+}
+
+static uint32_t log_progress(uint32_t quality, int64_t bytes_read, uint8_t decode_over, void *user_data, void *context)
+{
+    (void)bytes_read; (void)decode_over; (void)context;
+    progress_log* log = (progress_log*)user_data;
+    if(log->count < MAX_CALLBACKS) log->qualities[log->count] = quality;
+    log->count++;
+    return quality + 1000;
+}
+
+// decodes the blob into pixels (WIDTH*HEIGHT RGBA8); with a log, the decode is progressive and the callbacks are logged
+static int decode(const void* blob, size_t blob_size, uint8_t* pixels, progress_log* log)
+{
+    int result = 1;
+    FLIF_DECODER* d = flif_create_decoder();
+    if(!d) return 1;
+    if(log)
+    {
+        memset(log, 0, sizeof(*log));
+        flif_decoder_set_callback(d, log_progress, log);
+        flif_decoder_set_first_callback_quality(d, 500);
+    }
+    if(flif_decoder_decode_memory(d, blob, blob_size))
+    {
+        FLIF_IMAGE* im = flif_decoder_get_image(d, 0);
+        if(im && flif_image_get_width(im) == WIDTH && flif_image_get_height(im) == HEIGHT)
+        {
+            uint32_t y;
+            for(y = 0; y < HEIGHT; ++y)
+                flif_image_read_row_RGBA8(im, y, pixels + y * WIDTH * 4, WIDTH * 4);
+            result = 0;
+        }
+    }
+    flif_destroy_decoder(d);
+    return result;
+}
+
+static void* decode_thread(void* arg)
+{
+    thread_data* data = (thread_data*)arg;
+    uint8_t* pixels = (uint8_t*)malloc(WIDTH * HEIGHT * 4);
+    progress_log log;
+    int round;
+    if(!pixels) { data->result = 1; return 0; }
+    for(round = 0; round < ROUNDS; ++round)
+    {
+        int progressive = round & 1;
+        memset(pixels, 0, WIDTH * HEIGHT * 4);
+        if(decode(data->blob, data->blob_size, pixels, progressive ? &log : 0))
+        {
+            printf("Error: decoding failed\n");
+            data->result = 1;
+        }
+        else if(memcmp(pixels, data->reference, WIDTH * HEIGHT * 4))
+        {
+            printf("Error: image differs from the reference decode\n");
+            data->result = 1;
+        }
+        else if(progressive && (log.count != data->reference_log->count
+                                || memcmp(log.qualities, data->reference_log->qualities, sizeof(log.qualities))))
+        {
+            printf("Error: progressive callbacks differ from the reference decode\n");
+            data->result = 1;
+        }
+    }
+    free(pixels);
+    return 0;
+}
+
+typedef struct batch_result
+{
+    const uint8_t* reference;
+    int done[BATCH_ITEMS];
+    int result[BATCH_ITEMS];
+} batch_result;
+
+// even items are decoded at full size and compared to the reference, odd ones are decoded at scale 1:2
+static void check_batch_item(size_t index, int32_t success, FLIF_IMAGE** images, size_t num_images, void *user_data)
+{
+    batch_result* batch = (batch_result*)user_data;
+    uint32_t width = (index & 1 ? WIDTH / 2 : WIDTH), height = (index & 1 ? HEIGHT / 2 : HEIGHT);
+    size_t i;
+    batch->done[index]++;
+    if(!success || num_images != 1
+       || flif_image_get_width(images[0]) != width || flif_image_get_height(images[0]) != height)
+    {
+        batch->result[index] = 1;
+    }
+    else if(!(index & 1))
+    {
+        uint8_t row[WIDTH * 4];
+        uint32_t y;
+        for(y = 0; y < HEIGHT; ++y)
+        {
+            flif_image_read_row_RGBA8(images[0], y, row, sizeof(row));
+            if(memcmp(row, batch->reference + y * WIDTH * 4, sizeof(row))) batch->result[index] = 1;
+        }
+    }
+    for(i = 0; i < num_images; ++i) flif_destroy_image(images[i]);
+}
+
+int main(void)
+{
+    int result = 0;
+    void* blob = 0;
+    size_t blob_size = 0;
+
+    FLIF_IMAGE* im = flif_create_image(WIDTH, HEIGHT);
+    FLIF_ENCODER* e = flif_create_encoder();
+    if(!im || !e)
+    {
+        printf("Error: creating the image or encoder failed\n");
+        return 1;
+    }
+    fill_dummy_image(im);
+    flif_encoder_set_interlaced(e, 1);
+    flif_encoder_add_image(e, im);
+    if(!flif_encoder_encode_memory(e, &blob, &blob_size))
+    {
+        printf("Error: encoding blob failed\n");
+        return 1;
+    }
+    flif_destroy_encoder(e);
+    flif_destroy_image(im);
+
+    static uint8_t reference[WIDTH * HEIGHT * 4];
+    progress_log reference_log;
+    if(decode(blob, blob_size, reference, &reference_log) || reference_log.count < 2)
+    {
+        printf("Error: reference decode failed\n");
+        result = 1;
+    }
+    else
+    {
+        pthread_t threads[THREADS];
+        thread_data data[THREADS];
+        int t;
+        for(t = 0; t < THREADS; ++t)
+        {
+            data[t].blob = blob;
+            data[t].blob_size = blob_size;
+            data[t].reference = reference;
+            data[t].reference_log = &reference_log;
+            data[t].result = 0;
+            if(pthread_create(&threads[t], 0, decode_thread, &data[t]))
+            {
+                printf("Error: could not start thread\n");
+                return 1;
+            }
+        }
+        for(t = 0; t < THREADS; ++t)
+        {
+            pthread_join(threads[t], 0);
+            if(data[t].result) result = 1;
+        }
+
+        FLIF_BATCH_ITEM items[BATCH_ITEMS];
+        static batch_result batch;
+        size_t i;
+        memset(items, 0, sizeof(items));
+        batch.reference = reference;
+        for(i = 0; i < BATCH_ITEMS; ++i)
+        {
+            items[i].buffer = blob;
+            items[i].buffer_size_bytes = blob_size;
+            if(i & 1) items[i].scale = 2;
+        }
+        if(flif_decode_batch(items, BATCH_ITEMS, THREADS, check_batch_item, &batch) != BATCH_ITEMS)
+        {
+            printf("Error: batch decode failed\n");
+            result = 1;
+        }
+        for(i = 0; i < BATCH_ITEMS; ++i)
+        {
+            if(batch.done[i] != 1 || batch.result[i])
+            {
+                printf("Error: batch item %i was not decoded correctly\n", (int)i);
+                result = 1;
+            }
+        }
+    }
+
+    flif_free_memory(blob);
+    if(result == 0) printf("%i threads decoded the same image %i times each, batch decoded %i items\n", THREADS, ROUNDS, BATCH_ITEMS);
+    return result;
+}
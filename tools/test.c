@@ -9,6 +9,7 @@
 #include <flif.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #pragma pack(push,1)
 typedef struct RGBA
@@ -192,6 +193,44 @@ int compare_file_and_blob(const void* blob, size_t blob_size, const char* filena
     return result;
 }
 
+typedef struct counting_arena
+{
+    size_t allocations;
+    size_t bytes;
+    int misaligned;
+} counting_arena;
+
+/* an allocator that counts the buffers and bytes in use; it keeps the malloc pointer just before the aligned buffer */
+void* counting_allocate(size_t size, size_t alignment, void* arena)
+{
+    counting_arena* counts = (counting_arena*)arena;
+    char* raw = (char*)malloc(size + alignment + sizeof(void*));
+    char* ptr;
+    if(!raw) return 0;
+    ptr = raw + sizeof(void*);
+    ptr += (alignment - (uintptr_t)ptr % alignment) % alignment;
+    ((void**)ptr)[-1] = raw;
+    if(alignment < 64 || (uintptr_t)ptr % 64) counts->misaligned = 1;
+    counts->allocations++;
+    counts->bytes += size;
+    return ptr;
+}
+
+void counting_release(void* ptr, size_t size, void* arena)
+{
+    counting_arena* counts = (counting_arena*)arena;
+    counts->bytes -= size;
+    free(((void**)ptr)[-1]);
+}
+
+/* a progressive callback that counts the previews it makes */
+uint32_t count_previews(uint32_t quality, int64_t bytes_read, uint8_t decode_over, void* user_data, void* context)
+{
+    flif_decoder_generate_preview(context);
+    ++*(int*)user_data;
+    return quality + 1000;
+}
+
 int main(int argc, char** argv)
 {
     if (argc < 2)
@@ -245,6 +284,7 @@ int main(int argc, char** argv)
             flif_encoder_set_auto_color_buckets(e, 1);
             flif_encoder_set_palette_size(e, 512);
             flif_encoder_set_lookback(e, 1);
+            flif_encoder_set_threads(e, 4);
 
             flif_encoder_add_image(e, im);
             if(!flif_encoder_encode_memory(e, &blob, &blob_size))
@@ -311,6 +351,633 @@ int main(int argc, char** argv)
             d = 0;
         }
 
+        // decode the blob a few times with one decoder that reuses its buffers
+        d = flif_create_decoder();
+        if(d)
+        {
+            flif_decoder_set_reuse_buffers(d, 1);
+            int i;
+            for(i = 0; i < 3; ++i)
+            {
+                if(!flif_decoder_decode_memory(d, blob, blob_size))
+                {
+                    printf("Error: decoding memory with buffer reuse failed\n");
+                    result = 1;
+                }
+
+                FLIF_IMAGE* decoded = flif_decoder_get_image(d, 0);
+                if(decoded == 0)
+                {
+                    printf("Error: No decoded image found\n");
+                    result = 1;
+                }
+                else if(compare_images(im, decoded) != 0)
+                {
+                    result = 1;
+                }
+            }
+
+            flif_destroy_decoder(d);
+            d = 0;
+        }
+
+        // decode the blob with a decoder that allocates its image buffers with a counting allocator
+        d = flif_create_decoder();
+        if(d)
+        {
+            counting_arena arena = {0, 0, 0};
+            FLIF_ALLOCATOR allocator = {counting_allocate, counting_release, &arena};
+            flif_decoder_set_allocator(d, &allocator);
+            if(!flif_decoder_decode_memory(d, blob, blob_size))
+            {
+                printf("Error: decoding memory with a custom allocator failed\n");
+                result = 1;
+            }
+
+            FLIF_IMAGE* decoded = flif_decoder_get_image(d, 0);
+            if(decoded == 0)
+            {
+                printf("Error: No decoded image found\n");
+                result = 1;
+            }
+            else if(compare_images(im, decoded) != 0)
+            {
+                result = 1;
+            }
+
+            flif_destroy_decoder(d);
+            d = 0;
+
+            if(arena.allocations == 0 || arena.bytes != 0 || arena.misaligned)
+            {
+                printf("Error: image buffers were not allocated and released with the custom allocator\n");
+                result = 1;
+            }
+        }
+
+        // the same with progressive previews and downscaling, whose copies of the image also have to use the allocator
+        // of the decoder (counted separately from the default allocator, which should not be used at all)
+        d = flif_create_decoder();
+        if(d)
+        {
+            counting_arena arena = {0, 0, 0};
+            counting_arena default_arena = {0, 0, 0};
+            FLIF_ALLOCATOR allocator = {counting_allocate, counting_release, &arena};
+            FLIF_ALLOCATOR default_allocator = {counting_allocate, counting_release, &default_arena};
+            int previews = 0;
+            flif_set_allocator(&default_allocator);
+            flif_decoder_set_allocator(d, &allocator);
+            flif_decoder_set_callback(d, count_previews, &previews);
+            flif_decoder_set_fit(d, 50, 40);
+            if(!flif_decoder_decode_memory(d, blob, blob_size) || previews == 0 || flif_decoder_get_image(d, 0) == 0)
+            {
+                printf("Error: progressive decoding with a custom allocator failed\n");
+                result = 1;
+            }
+            flif_destroy_decoder(d);
+            d = 0;
+            flif_set_allocator(NULL);
+
+            if(arena.allocations == 0 || arena.bytes != 0 || arena.misaligned || default_arena.allocations != 0)
+            {
+                printf("Error: preview buffers were not allocated and released with the custom allocator\n");
+                result = 1;
+            }
+        }
+
+        // feed the blob in small pieces as if it came from the network, then feed it without its last part and end the
+        // input there (most of this blob is header, with a large palette)
+        d = flif_create_decoder();
+        if(d)
+        {
+            int previews = 0;
+            size_t fed = 0;
+            int32_t status = FLIF_FEED_NEED_MORE;
+            flif_decoder_set_callback(d, count_previews, &previews);
+            while(status == FLIF_FEED_NEED_MORE && fed < blob_size)
+            {
+                size_t piece = blob_size - fed < 1000 ? blob_size - fed : 1000;
+                status = flif_decoder_feed(d, (const uint8_t*)blob + fed, piece);
+                fed += piece;
+            }
+            if(status != FLIF_FEED_DONE || fed != blob_size)
+            {
+                printf("Error: incremental decoding failed\n");
+                result = 1;
+            }
+            else
+            {
+                FLIF_IMAGE* decoded = flif_decoder_get_image(d, 0);
+                if(decoded == 0 || compare_images(im, decoded) != 0)
+                {
+                    printf("Error: incremental decoding differs\n");
+                    result = 1;
+                }
+                if(previews < 2)
+                {
+                    printf("Error: incremental decoding made no progressive previews\n");
+                    result = 1;
+                }
+            }
+
+            // while it is going on, other decodes are refused and changing the options doesn't affect it
+            flif_decoder_set_callback(d, 0, 0);
+            if(flif_decoder_feed(d, blob, blob_size / 2) != FLIF_FEED_NEED_MORE || flif_decoder_decode_memory(d, blob, blob_size) != 0)
+            {
+                printf("Error: decoding during incremental decoding was not refused\n");
+                result = 1;
+            }
+            flif_decoder_set_quality(d, 50);
+            if(flif_decoder_feed(d, (const uint8_t*)blob + blob_size / 2, blob_size - blob_size / 2) != FLIF_FEED_DONE
+               || flif_decoder_get_image(d, 0) == 0 || compare_images(im, flif_decoder_get_image(d, 0)) != 0)
+            {
+                printf("Error: incremental decoding used options that were set after it started\n");
+                result = 1;
+            }
+            flif_decoder_set_quality(d, 100);
+
+            flif_decoder_set_verbosity(d, 0); // no warning about the unexpected end
+            if(flif_decoder_feed(d, blob, blob_size - blob_size / 16) != FLIF_FEED_NEED_MORE || flif_decoder_end_feed(d) != FLIF_FEED_DONE
+               || flif_decoder_get_image(d, 0) == 0)
+            {
+                printf("Error: incremental decoding of a partial file failed\n");
+                result = 1;
+            }
+
+            flif_destroy_decoder(d);
+            d = 0;
+        }
+
+        // decode the blob straight into an RGBA8 buffer (with padded rows) and check it against the image rows;
+        // the BGRA8 copy of the image must have the same pixels with red and blue swapped
+        d = flif_create_decoder();
+        if(d)
+        {
+            size_t stride = WIDTH * 4 + 16;
+            uint8_t* pixels = (uint8_t*)malloc(stride * HEIGHT);
+            uint8_t* bgra = (uint8_t*)malloc(WIDTH * 4 * HEIGHT);
+            uint8_t* row = (uint8_t*)malloc(WIDTH * 4);
+            if(!pixels || !bgra || !row)
+            {
+                printf("Error: out of memory\n");
+                result = 1;
+            }
+            else if(!flif_decoder_decode_memory_into(d, blob, blob_size, pixels, stride, stride * HEIGHT, FLIF_PIXEL_RGBA8))
+            {
+                printf("Error: decoding memory into a pixel buffer failed\n");
+                result = 1;
+            }
+            else if(!flif_image_read_into(im, bgra, WIDTH * 4, WIDTH * 4 * HEIGHT, FLIF_PIXEL_BGRA8))
+            {
+                printf("Error: reading the image into a BGRA8 buffer failed\n");
+                result = 1;
+            }
+            else
+            {
+                const size_t bgra_index[4] = {2, 1, 0, 3};
+                size_t y, x;
+                for(y = 0; y < HEIGHT; ++y)
+                {
+                    flif_image_read_row_RGBA8(im, y, row, WIDTH * 4);
+                    for(x = 0; x < WIDTH * 4; ++x)
+                    {
+                        if(pixels[y * stride + x] != row[x] || bgra[y * WIDTH * 4 + x - x % 4 + bgra_index[x % 4]] != row[x])
+                        {
+                            printf("Error: pixel buffer differs from the image at row %i\n", (int)y);
+                            result = 1;
+                            break;
+                        }
+                    }
+                }
+            }
+            free(pixels);
+            free(bgra);
+            free(row);
+
+            flif_destroy_decoder(d);
+            d = 0;
+        }
+
+        // encode a view onto an RGBA8 copy of the image (imported without copying the pixels) with the same options,
+        // which has to give the same blob
+        {
+            uint8_t* rgba = (uint8_t*)malloc(WIDTH * 4 * HEIGHT);
+            FLIF_IMAGE* view = 0;
+            void* view_blob = 0;
+            size_t view_blob_size = 0;
+            if(rgba && flif_image_read_into(im, rgba, WIDTH * 4, WIDTH * 4 * HEIGHT, FLIF_PIXEL_RGBA8))
+                view = flif_import_image_view(WIDTH, HEIGHT, rgba, WIDTH * 4, FLIF_PIXEL_RGBA8);
+            e = flif_create_encoder();
+            if(!view || !e)
+            {
+                printf("Error: importing a view failed\n");
+                result = 1;
+            }
+            else
+            {
+                flif_encoder_set_interlaced(e, 1);
+                flif_encoder_set_learn_repeat(e, 3);
+                flif_encoder_set_auto_color_buckets(e, 1);
+                flif_encoder_set_palette_size(e, 512);
+                flif_encoder_set_lookback(e, 1);
+
+                flif_encoder_add_image(e, view);
+                if(!flif_encoder_encode_memory(e, &view_blob, &view_blob_size))
+                {
+                    printf("Error: encoding a view failed\n");
+                    result = 1;
+                }
+                else if(view_blob_size != blob_size || memcmp(view_blob, blob, blob_size))
+                {
+                    printf("Error: encoding a view gives a different blob\n");
+                    result = 1;
+                }
+            }
+            if(e) flif_destroy_encoder(e);
+            e = 0;
+
+            // planes that no transform changes (here the alpha plane, given some variation) stay views while they
+            // are encoded (and are read back from the input), which has to give the same blob as a copy of the pixels
+            int k;
+            void* plain_blobs[2] = {0, 0};
+            size_t plain_sizes[2] = {0, 0};
+            FLIF_IMAGE* plain = 0;
+            if(view)
+            {
+                for(k = 0; k < WIDTH * HEIGHT; ++k) rgba[k * 4 + 3] = (uint8_t)(255 - k % 13);
+                plain = flif_import_image_RGBA(WIDTH, HEIGHT, rgba, WIDTH * 4);
+            }
+            for(k = 0; plain && k < 2; ++k)
+            {
+                e = flif_create_encoder();
+                if(!e) break;
+                flif_encoder_set_ycocg(e, 0);
+                flif_encoder_set_channel_compact(e, 0);
+                flif_encoder_set_auto_color_buckets(e, 0);
+                flif_encoder_set_palette_size(e, 0);
+                flif_encoder_add_image(e, k ? view : plain);
+                if(!flif_encoder_encode_memory(e, &plain_blobs[k], &plain_sizes[k])) plain_sizes[k] = 0;
+                flif_destroy_encoder(e);
+                e = 0;
+            }
+            if(plain) flif_destroy_image(plain);
+            if(view && (!plain_sizes[0] || plain_sizes[0] != plain_sizes[1] || memcmp(plain_blobs[0], plain_blobs[1], plain_sizes[0])))
+            {
+                printf("Error: encoding an unchanged view gives a different blob\n");
+                result = 1;
+            }
+            flif_free_memory(plain_blobs[0]);
+            flif_free_memory(plain_blobs[1]);
+
+            if(view) flif_destroy_image(view);
+            flif_free_memory(view_blob);
+            free(rgba);
+        }
+
+        // the whole-row conversions of images in plane buffers have to give the same rows as the per-pixel
+        // conversions of views, also for widths that are not a multiple of the vector width
+        {
+            enum { W = 37, H = 3 };
+            uint8_t rgba[W * 4 * H];
+            uint16_t rgba16[W * 4], row16[W * 4];
+            uint32_t i, y;
+            for(i = 0; i < sizeof(rgba); ++i) rgba[i] = (uint8_t)(i * 7 + (i >> 5));
+            for(i = 0; i < W * 4; ++i) rgba16[i] = (uint16_t)(i * 1777 + 3);
+            FLIF_IMAGE* plain = flif_create_image(W, H);
+            FLIF_IMAGE* view = flif_import_image_view(W, H, rgba, W * 4, FLIF_PIXEL_RGBA8);
+            FLIF_IMAGE* hdr = flif_create_image_HDR(W, H);
+            if(!plain || !view || !hdr)
+            {
+                printf("Error: creating images for the row conversions failed\n");
+                result = 1;
+            }
+            else
+            {
+                for(y = 0; y < H; ++y) flif_image_write_row_RGBA8(plain, y, rgba + y * W * 4, W * 4);
+                flif_image_write_row_RGBA16(hdr, 1, rgba16, sizeof(rgba16));
+                flif_image_read_row_RGBA16(hdr, 1, row16, sizeof(row16));
+                if(compare_images(plain, view) || memcmp(rgba16, row16, sizeof(row16)))
+                {
+                    printf("Error: row conversions differ\n");
+                    result = 1;
+                }
+            }
+            if(plain) flif_destroy_image(plain);
+            if(view) flif_destroy_image(view);
+            if(hdr) flif_destroy_image(hdr);
+        }
+
+        // same again, with the rANS entropy coder
+        void* rans_blob = 0;
+        size_t rans_blob_size = 0;
+        e = flif_create_encoder();
+        if(e)
+        {
+            flif_encoder_set_rans(e, 1);
+
+            flif_encoder_add_image(e, im);
+            if(!flif_encoder_encode_memory(e, &rans_blob, &rans_blob_size))
+            {
+                printf("Error: encoding rANS blob failed\n");
+                result = 1;
+            }
+            flif_destroy_encoder(e);
+            e = 0;
+        }
+        d = flif_create_decoder();
+        if(d)
+        {
+            if(!flif_decoder_decode_memory(d, rans_blob, rans_blob_size))
+            {
+                printf("Error: decoding rANS blob failed\n");
+                result = 1;
+            }
+
+            FLIF_IMAGE* decoded = flif_decoder_get_image(d, 0);
+            if(decoded == 0)
+            {
+                printf("Error: No decoded image found\n");
+                result = 1;
+            }
+            else if(compare_images(im, decoded) != 0)
+            {
+                result = 1;
+            }
+
+            flif_destroy_decoder(d);
+            d = 0;
+        }
+        if(rans_blob)
+        {
+            flif_free_memory(rans_blob);
+            rans_blob = 0;
+        }
+
+        // same again, with MANIAC trees learned from the image beforehand
+        void* forest_blob = 0;
+        size_t forest_blob_size = 0;
+        FLIF_FOREST* forest = flif_create_forest();
+        e = flif_create_encoder();
+        if(e && forest)
+        {
+            if(flif_encoder_set_forest(e, forest))
+            {
+                printf("Error: an untrained forest was accepted\n");
+                result = 1;
+            }
+            flif_encoder_add_image(e, im);
+            if(!flif_encoder_train_forest(e, forest))
+            {
+                printf("Error: training forest failed\n");
+                result = 1;
+            }
+            flif_destroy_encoder(e);
+            e = 0;
+        }
+        e = flif_create_encoder();
+        if(e && forest)
+        {
+            if(!flif_encoder_set_forest(e, forest))
+            {
+                printf("Error: setting the trained forest failed\n");
+                result = 1;
+            }
+
+            flif_encoder_add_image(e, im);
+            if(!flif_encoder_encode_memory(e, &forest_blob, &forest_blob_size))
+            {
+                printf("Error: encoding blob with forest failed\n");
+                result = 1;
+            }
+            flif_destroy_encoder(e);
+            e = 0;
+        }
+        flif_destroy_forest(forest);
+        forest = 0;
+        d = flif_create_decoder();
+        if(d)
+        {
+            if(!flif_decoder_decode_memory(d, forest_blob, forest_blob_size))
+            {
+                printf("Error: decoding blob encoded with forest failed\n");
+                result = 1;
+            }
+
+            FLIF_IMAGE* decoded = flif_decoder_get_image(d, 0);
+            if(decoded == 0)
+            {
+                printf("Error: No decoded image found\n");
+                result = 1;
+            }
+            else if(compare_images(im, decoded) != 0)
+            {
+                result = 1;
+            }
+
+            flif_destroy_decoder(d);
+            d = 0;
+        }
+        if(forest_blob)
+        {
+            flif_free_memory(forest_blob);
+            forest_blob = 0;
+        }
+
+        // encode and decode as independent tiles
+        e = flif_create_encoder();
+        if(e)
+        {
+            void* tiled_blob = 0;
+            size_t tiled_blob_size = 0;
+            flif_encoder_set_tile_size(e, 100);
+            flif_encoder_set_threads(e, 3);
+            flif_encoder_add_image(e, im);
+            if(!flif_encoder_encode_memory(e, &tiled_blob, &tiled_blob_size))
+            {
+                printf("Error: encoding tiled blob failed\n");
+                result = 1;
+            }
+            flif_destroy_encoder(e);
+            e = 0;
+
+            d = flif_create_decoder();
+            if(d && tiled_blob)
+            {
+                flif_decoder_set_threads(d, 2);
+                if(!flif_decoder_decode_memory(d, tiled_blob, tiled_blob_size))
+                {
+                    printf("Error: decoding tiled blob failed\n");
+                    result = 1;
+                }
+                else
+                {
+                    FLIF_IMAGE* decoded = flif_decoder_get_image(d, 0);
+                    if(decoded == 0 || compare_images(im, decoded) != 0)
+                    {
+                        printf("Error: tiled decoding differs\n");
+                        result = 1;
+                    }
+                }
+            }
+            if(d)
+            {
+                flif_destroy_decoder(d);
+                d = 0;
+            }
+            if(tiled_blob)
+                flif_free_memory(tiled_blob);
+        }
+
+        // encode and decode with a separate stream per plane
+        e = flif_create_encoder();
+        if(e)
+        {
+            void* planes_blob = 0;
+            size_t planes_blob_size = 0;
+            flif_encoder_set_interlaced(e, 0);
+            flif_encoder_set_plane_streams(e, 1);
+            flif_encoder_set_threads(e, 2);
+            flif_encoder_add_image(e, im);
+            if(!flif_encoder_encode_memory(e, &planes_blob, &planes_blob_size))
+            {
+                printf("Error: encoding blob with plane streams failed\n");
+                result = 1;
+            }
+            flif_destroy_encoder(e);
+            e = 0;
+
+            d = flif_create_decoder();
+            if(d && planes_blob)
+            {
+                flif_decoder_set_threads(d, 3);
+                if(!flif_decoder_decode_memory(d, planes_blob, planes_blob_size))
+                {
+                    printf("Error: decoding blob with plane streams failed\n");
+                    result = 1;
+                }
+                else
+                {
+                    FLIF_IMAGE* decoded = flif_decoder_get_image(d, 0);
+                    if(decoded == 0 || compare_images(im, decoded) != 0)
+                    {
+                        printf("Error: decoding with plane streams differs\n");
+                        result = 1;
+                    }
+                }
+            }
+            if(d)
+            {
+                flif_destroy_decoder(d);
+                d = 0;
+            }
+            if(planes_blob)
+                flif_free_memory(planes_blob);
+        }
+
+        // plane streams can't be interlaced, so asking for both must fail
+        e = flif_create_encoder();
+        if(e)
+        {
+            void* planes_blob = 0;
+            size_t planes_blob_size = 0;
+            flif_encoder_set_interlaced(e, 1);
+            flif_encoder_set_plane_streams(e, 1);
+            flif_encoder_add_image(e, im);
+            if(flif_encoder_encode_memory(e, &planes_blob, &planes_blob_size))
+            {
+                printf("Error: encoding an interlaced blob with plane streams succeeded\n");
+                result = 1;
+            }
+            flif_destroy_encoder(e);
+            e = 0;
+            if(planes_blob)
+                flif_free_memory(planes_blob);
+        }
+
+        // encode with a zoomlevel index, and decode only the part of the file that is needed for a 1:8 preview
+        e = flif_create_encoder();
+        if(e)
+        {
+            void* index_blob = 0;
+            size_t index_blob_size = 0;
+            flif_encoder_set_interlaced(e, 1);
+            flif_encoder_set_zoomlevel_index(e, 1);
+            flif_encoder_add_image(e, im);
+            if(!flif_encoder_encode_memory(e, &index_blob, &index_blob_size))
+            {
+                printf("Error: encoding blob with zoomlevel index failed\n");
+                result = 1;
+            }
+            flif_destroy_encoder(e);
+            e = 0;
+
+            FLIF_INFO* info = index_blob ? flif_read_info_from_memory(index_blob, index_blob_size) : 0;
+            size_t preview_size = info ? flif_info_get_bytes_for_scale(info, 8) : 0;
+            if(info == 0 || flif_info_num_zoomlevel_offsets(info) == 0 || flif_info_get_bytes_for_scale(info, 1) != index_blob_size
+               || preview_size == 0 || preview_size >= index_blob_size)
+            {
+                printf("Error: zoomlevel index is missing or wrong\n");
+                result = 1;
+            }
+            else
+            {
+                FLIF_DECODER* full = flif_create_decoder();
+                d = flif_create_decoder();
+                if(full && d)
+                {
+                    flif_decoder_set_scale(full, 8);
+                    flif_decoder_set_scale(d, 8);
+                    if(!flif_decoder_decode_memory(full, index_blob, index_blob_size) || !flif_decoder_decode_memory(d, index_blob, preview_size))
+                    {
+                        printf("Error: decoding blob with zoomlevel index failed\n");
+                        result = 1;
+                    }
+                    else if(compare_images(flif_decoder_get_image(full, 0), flif_decoder_get_image(d, 0)) != 0)
+                    {
+                        printf("Error: decoding the 1:8 part of the file differs\n");
+                        result = 1;
+                    }
+                }
+                if(full)
+                    flif_destroy_decoder(full);
+                if(d)
+                {
+                    flif_destroy_decoder(d);
+                    d = 0;
+                }
+            }
+            if(info)
+                flif_destroy_info(info);
+            if(index_blob)
+                flif_free_memory(index_blob);
+        }
+
+        // decode again with every buffer in a memory-mapped temporary file
+        if(flif_set_out_of_core(0, NULL))
+        {
+            d = flif_create_decoder();
+            if(d)
+            {
+                if(!flif_decoder_decode_memory(d, blob, blob_size))
+                {
+                    printf("Error: decoding out-of-core failed\n");
+                    result = 1;
+                }
+                else
+                {
+                    FLIF_IMAGE* decoded = flif_decoder_get_image(d, 0);
+                    if(decoded == 0 || compare_images(im, decoded) != 0)
+                    {
+                        printf("Error: out-of-core decoding differs\n");
+                        result = 1;
+                    }
+                }
+                flif_destroy_decoder(d);
+                d = 0;
+            }
+            flif_set_allocator(NULL);
+        }
+
         FLIF_INFO* info = flif_read_info_from_memory(blob, blob_size);
         if(info)
         {